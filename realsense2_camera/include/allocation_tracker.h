@@ -0,0 +1,70 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <atomic>
+#include <cstdint>
+
+namespace realsense2_camera
+{
+    // Counts the heap allocations of the frame, IMU and pose callbacks, to catch the ones that creep back into their
+    // steady state. Built with the TRACK_ALLOCATIONS cmake option only: the library then defines a counting operator
+    // new, and is linked with -Bsymbolic-functions so that its own calls are bound to it. That doesn't keep the
+    // exported operator new from interposing for other libraries, e.g. the ones loaded later with RTLD_GLOBAL, so
+    // their allocations in a scope may be counted as well. roscpp's serialization of the messages is excluded with
+    // Untracked. Otherwise the scopes compile to nothing and no diagnostics are reported. The allocations test
+    // (test/allocations.test) fails when the callbacks allocate after their warm-up.
+    class AllocationTracker
+    {
+    public:
+        enum Callback {FRAME, IMU, POSE, CALLBACKS_NUM};
+
+        // Counts the allocations of the calling thread during its lifetime as those of a callback.
+        class Scope
+        {
+        public:
+#ifdef TRACK_ALLOCATIONS
+            Scope(AllocationTracker& tracker, Callback callback);
+            ~Scope();
+
+        private:
+            AllocationTracker& _tracker;
+            Callback _callback;
+            uint64_t _start_allocations;
+#else
+            Scope(AllocationTracker&, Callback) {}
+#endif
+        };
+
+        // The allocations of the calling thread during its lifetime are not counted, e.g. the buffer roscpp
+        // serializes every message published into.
+        class Untracked
+        {
+        public:
+#ifdef TRACK_ALLOCATIONS
+            Untracked();
+            ~Untracked();
+#else
+            Untracked() {}
+#endif
+        };
+
+        AllocationTracker();
+
+        static bool isEnabled();
+        // A task of a diagnostic_updater::Updater. Warns about the allocations made after the warm-up.
+        void diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+    private:
+        struct Counters
+        {
+            std::atomic<uint64_t> calls;
+            std::atomic<uint64_t> allocations;              // Since the last diagnostics update.
+            std::atomic<uint64_t> steady_state_allocations; // After the warm-up, since startup.
+        };
+
+        Counters _counters[CALLBACKS_NUM];
+    };
+}
@@ -4,11 +4,32 @@
 #pragma once
 
 #include "../include/realsense_node_factory.h"
+#include "../include/worker_pool.h"
+#include "../include/device_metadata_cache.h"
+#include "../include/hardware_clock_model.h"
+#include "../include/cached_camera_info.h"
+#include "../include/rvl_codec.h"
+#include "../include/jpeg_encoder_pool.h"
+#include "../include/shm_ring.h"
+#include "../include/image_frame_view.h"
+#include "../include/raw_recorder.h"
+#include "../include/flight_recorder.h"
+#include "../include/stream_diagnostics.h"
+#include "../include/allocation_tracker.h"
+#include "../include/tracer.h"
+#include "../include/metrics_registry.h"
+#include "../include/metrics_endpoint.h"
+#include "../include/perf_counters.h"
+#include "../include/frameset_syncer.h"
 #include <ddynamic_reconfigure/ddynamic_reconfigure.h>
 
 #include <diagnostic_updater/diagnostic_updater.h>
-#include <diagnostic_updater/update_functions.h>
+#include <std_msgs/Empty.h>
+#include <std_srvs/Trigger.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <realsense2_camera/ShmFrame.h>
+#include <realsense2_camera/Metrics.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 #include <sensor_msgs/Imu.h>
@@ -24,50 +45,50 @@
 
 namespace realsense2_camera
 {
-    struct FrequencyDiagnostics
-    {
-      FrequencyDiagnostics(double expected_frequency, std::string name, std::string hardware_id) :
-        expected_frequency_(expected_frequency),
-        frequency_status_(diagnostic_updater::FrequencyStatusParam(&expected_frequency_, &expected_frequency_)),
-        diagnostic_updater_(ros::NodeHandle(), ros::NodeHandle("~"), ros::this_node::getName() + "_" + name)
-      {
-        ROS_INFO("Expected frequency for %s = %.5f", name.c_str(), expected_frequency_);
-        diagnostic_updater_.setHardwareID(hardware_id);
-        diagnostic_updater_.add(frequency_status_);
-      }
-
-      void tick()
-      {
-        frequency_status_.tick();
-      }
-
-      void update()
-      {
-        diagnostic_updater_.update();
-      }
-
-      double expected_frequency_;
-      diagnostic_updater::FrequencyStatus frequency_status_;
-      diagnostic_updater::Updater diagnostic_updater_;
-    };
-    typedef std::pair<image_transport::Publisher, std::shared_ptr<FrequencyDiagnostics>> ImagePublisherWithFrequencyDiagnostics;
+    typedef std::pair<image_transport::Publisher, std::shared_ptr<StreamDiagnostics>> ImagePublisherWithFrequencyDiagnostics;
 
     class TemperatureDiagnostics
     {
         public:
-            TemperatureDiagnostics(std::string name, std::string serial_no);
+            TemperatureDiagnostics() : _crnt_temp(0) {}
             void diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
 
             void update(double crnt_temperaure)
             {
                 _crnt_temp = crnt_temperaure;
-                _updater.update();
             }
+            double value() const { return _crnt_temp; }
+
+        private:
+            std::atomic<double> _crnt_temp;
+    };
+
+    // Compression ratio and speed of a compressed topic, accumulated between two diagnostics updates.
+    class CompressionDiagnostics
+    {
+        public:
+            CompressionDiagnostics() : _frames(0), _dropped_frames(0), _raw_bytes(0), _compressed_bytes(0), _encode_sec(0) {}
+            void add(size_t raw_bytes, size_t compressed_bytes, double encode_sec);
+            void addDropped();
+            void diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
 
         private:
-            double _crnt_temp;
-            diagnostic_updater::Updater _updater;
+            std::mutex _mutex;
+            unsigned int _frames;
+            unsigned int _dropped_frames;
+            uint64_t _raw_bytes;
+            uint64_t _compressed_bytes;
+            double _encode_sec;
+    };
 
+    // Groups of output topics. A processing stage runs only while a topic it feeds has subscribers.
+    enum TopicDemand
+    {
+        DEMAND_DEPTH   = 1 << 0,    // depth/image_rect_raw, colorized or not, and its compressed and shm topics.
+        DEMAND_ALIGNED = 1 << 1,    // aligned_depth_to_*/image_raw
+        DEMAND_POINTS  = 1 << 2,    // depth/color/points
+        DEMAND_IMAGES  = 1 << 3,    // All the other image topics.
+        DEMAND_ALL     = DEMAND_DEPTH | DEMAND_ALIGNED | DEMAND_POINTS | DEMAND_IMAGES
     };
 
     class NamedFilter
@@ -75,42 +96,109 @@ namespace realsense2_camera
         public:
             std::string _name;
             std::shared_ptr<rs2::filter> _filter;
+            unsigned int _demand;   // The TopicDemand groups that depend on this filter.
+            MetricsRegistry::Histogram* _duration;
+            PerfCounters::Stage* _perf;
 
         public:
-            NamedFilter(std::string name, std::shared_ptr<rs2::filter> filter):
-            _name(name), _filter(filter)
+            NamedFilter(std::string name, std::shared_ptr<rs2::filter> filter, unsigned int demand = DEMAND_ALL):
+            _name(name), _filter(filter), _demand(demand), _duration(nullptr), _perf(nullptr)
             {}
     };
 
-	class PipelineSyncer : public rs2::asynchronous_syncer
-	{
-	public: 
-		void operator()(rs2::frame f) const
-		{
-			invoke(std::move(f));
-		}
-	};
+    // Per stream state of the frame path, resolved once by setupStreamContexts() and addressed by index instead of
+    // through the per stream maps. The pointers point into the maps filled during setup and are only read afterwards.
+    // The rest is written only by the callback of its stream, so concurrent callbacks of different streams share nothing.
+    struct StreamContext
+    {
+        StreamContext() : is_valid(false), seq(0), encoding(nullptr), optical_frame_id(nullptr), camera_info(nullptr),
+                          info_publisher(nullptr), image_publisher(nullptr), imu_publisher(nullptr),
+                          compressed_publisher(nullptr), compression_diagnostics(nullptr), shm_publisher(nullptr),
+                          raw_image_publisher(nullptr), published_messages(nullptr), published_bytes(nullptr),
+                          publish_latency(nullptr) {}
+
+        bool is_valid;
+        stream_index_pair stream;
+        cv::Mat image;
+        cv::Mat depth_scaled_image;
+        int seq;
+        CachedCameraInfo cached_camera_info;
+        const std::string* encoding;
+        const std::string* optical_frame_id;
+        sensor_msgs::CameraInfo* camera_info;
+        const ros::Publisher* info_publisher;
+        const ImagePublisherWithFrequencyDiagnostics* image_publisher;
+        const ros::Publisher* imu_publisher;
+        const ros::Publisher* compressed_publisher;
+        CompressionDiagnostics* compression_diagnostics;
+        const ros::Publisher* shm_publisher;
+        std::string shm_segment;
+        std::shared_ptr<ShmRingWriter> shm_ring;    // Created on the first frame, when the frame size is known.
+        const ros::Publisher* raw_image_publisher;  // The raw topic of image_publisher, for publishing ImageFrameView.
+        MetricsRegistry::Counter* published_messages;
+        MetricsRegistry::Counter* published_bytes;
+        MetricsRegistry::Histogram* publish_latency;
+
+        // Reused for every frame, so that their strings keep their buffers.
+        ImageFrameView raw_image;
+        sensor_msgs::Imu imu_msg;
+        nav_msgs::Odometry odom_msg;
+        geometry_msgs::TransformStamped odom_transform;
+    };
+
+    // Sets the options of a sensor or filter and remembers every value it set. After a warm restart it is re-bound
+    // to the re-enumerated sensor and applies the remembered values again, so the reconfigure servers stay valid.
+    class OptionsHandle
+    {
+        public:
+            explicit OptionsHandle(rs2::options options) : _options(options) {}
+            void set_option(rs2_option option, float value);
+            rs2::options get() const;
+            void rebind(rs2::options options);
+
+        private:
+            mutable std::mutex                           _mutex;
+            rs2::options                                 _options;
+            std::vector<std::pair<rs2_option, float>>    _values;    // In the order they were last set.
+    };
 
     class SyncedImuPublisher
     {
         public:
-            SyncedImuPublisher() {_is_enabled=false;};
+            // While a frame stamped t is processed, the messages stamped t or later are held back, and published
+            // right after the frame. The ones stamped before t are published at once.
+            class Watermark
+            {
+                public:
+                    Watermark(SyncedImuPublisher& publisher, const ros::Time& stamp);
+                    ~Watermark();
+
+                private:
+                    SyncedImuPublisher& _publisher;
+                    ros::Time _stamp;
+                    bool _is_held;
+            };
+
+            SyncedImuPublisher() : _pending_size(0) {_is_enabled=false;};
             SyncedImuPublisher(ros::Publisher imu_publisher, std::size_t waiting_list_size=1000);
             ~SyncedImuPublisher();
-            void Pause();   // Pause sending messages. All messages from now on are saved in queue.
-            void Resume();  // Send all pending messages and allow sending future messages.
-            void Publish(sensor_msgs::Imu msg);     //either send or hold message.
+            void Publish(const sensor_msgs::Imu& msg);     //either send or hold message.
             uint32_t getNumSubscribers() { return _publisher.getNumSubscribers();};
             void Enable(bool is_enabled) {_is_enabled=is_enabled;};
         
         private:
-            void PublishPendingMessages();
+            bool Hold(const ros::Time& stamp);
+            void Release(const ros::Time& stamp);
+            // Called with _mutex locked. The stamp of the earliest frame being processed, or TIME_MAX if none is.
+            ros::Time LowestWatermark() const;
+            void PublishPendingMessages(const ros::Time& watermark);
 
         private:
             std::mutex                    _mutex;
             ros::Publisher                _publisher;
-            bool                          _pause_mode;
-            std::queue<sensor_msgs::Imu>  _pending_messages;
+            std::vector<ros::Time>        _watermarks;         // Of the frames being processed, on any thread.
+            std::vector<sensor_msgs::Imu> _pending_messages;   // Kept when sent, only the first _pending_size are pending.
+            std::size_t                   _pending_size;
             std::size_t                     _waiting_list_size;
             bool                          _is_enabled;
     };
@@ -121,13 +209,22 @@ namespace realsense2_camera
         BaseRealSenseNode(ros::NodeHandle& nodeHandle,
                           ros::NodeHandle& privateNodeHandle,
                           rs2::device dev,
-                          const std::string& serial_no);
+                          const std::string& serial_no,
+                          std::shared_ptr<WorkerPool> worker_pool = nullptr);
 
         virtual void toggleSensors(bool enabled) override;
+        virtual void pauseSensors(bool paused) override;
+        virtual bool setRecording(bool enabled, std::string& message) override;
         virtual void publishTopics() override;
         virtual void registerDynamicReconfigCb(ros::NodeHandle& nh) override;
+        virtual bool warmRestart(rs2::device dev) override;
         virtual ~BaseRealSenseNode();
 
+        // Called once, from the frames thread, when the first image frame reaches its publisher. Set it before publishTopics().
+        void setFirstFrameCallback(std::function<void()> callback) { _first_frame_callback = callback; }
+        // Called from the sensor callbacks before anything else. A frame it returns false for is dropped. Set it before publishTopics().
+        void setFrameFilter(std::function<bool(const rs2::frame&)> filter) { _frame_filter = filter; }
+
     public:
         enum imu_sync_method{NONE, COPY, LINEAR_INTERPOLATION};
 
@@ -166,6 +263,8 @@ namespace realsense2_camera
 
         virtual void calcAndPublishStaticTransform(const stream_index_pair& stream, const rs2::stream_profile& base_profile);
         rs2::stream_profile getAProfile(const stream_index_pair& stream);
+        rs2_intrinsics getIntrinsics(const rs2::video_stream_profile& profile);
+        rs2_extrinsics getExtrinsics(const rs2::stream_profile& from, const rs2::stream_profile& to);
         tf::Quaternion rotationMatrixToQuaternion(const float rotation[9]) const;
         void publish_static_tf(const ros::Time& t,
                                const float3& trans,
@@ -195,9 +294,28 @@ namespace realsense2_camera
         void setupDevice();
         void setupErrorCallback();
         void setupPublishers();
+        void setupFlightRecorder();
+        bool dumpFlightRecorder(std::string& message);
+        bool dumpFlightRecorderCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+        void flightRecorderTriggerCallback(const std_msgs::Empty::ConstPtr& msg);
+        void setupTracing();
+        bool enableTracingCallback(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
+        bool dumpTraceCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+        void setupStreamMetrics(StreamContext& context, const std::string& stream_name);
+        void setupMetrics();
+        void publishMetrics();
         void enable_devices();
         void setupFilters();
         void setupStreams();
+        void startSyncer();
+        void startSensors();
+        void stopSensors();
+        unsigned int updateTopicDemand();
+        bool hasSubscribers();
+        void updateLazyStreaming();
+        void loadJsonFile();
+        void rebindDevice(rs2::device dev);
+        rs2::sensor getSensor(const std::string& module_base_name);
         bool setBaseTime(double frame_time, rs2_timestamp_domain time_domain);
         double frameSystemTimeSec(rs2::frame frame);
         cv::Mat& fix_depth_scale(const cv::Mat& from_image, cv::Mat& to_image);
@@ -212,29 +330,52 @@ namespace realsense2_camera
         Extrinsics rsExtrinsicsToMsg(const rs2_extrinsics& extrinsics, const std::string& frame_id) const;
 
         IMUInfo getImuInfo(const stream_index_pair& stream_index);
-        void publishFrame(rs2::frame f, const ros::Time& t,
-                          const stream_index_pair& stream,
-                          std::map<stream_index_pair, cv::Mat>& images,
-                          const std::map<stream_index_pair, ros::Publisher>& info_publishers,
-                          const std::map<stream_index_pair, ImagePublisherWithFrequencyDiagnostics>& image_publishers,
-                          std::map<stream_index_pair, int>& seq,
-                          std::map<stream_index_pair, sensor_msgs::CameraInfo>& camera_info,
-                          const std::map<rs2_stream, std::string>& encoding,
-                          bool copy_data_from_frame = true);
+        void setupStreamContexts();
+        StreamContext& getStreamContext(const stream_index_pair& stream);
+        StreamContext& getDepthAlignedStreamContext(const stream_index_pair& stream);
+        void publishFrame(rs2::frame f, const ros::Time& t, StreamContext& context, bool copy_data_from_frame = true);
+        void setupRvlEncoder();
+        void postRvl(rs2::frame frame, const cv::Mat& image, const ros::Time& t, StreamContext& context);
+        void publishRvl(const cv::Mat& image, const ros::Time& t, int seq, StreamContext& context);
+        void setupJpegEncoders();
+        void publishShm(const cv::Mat& image, const ros::Time& t, StreamContext& context);
+        // The color frames are JPEG encoded on several strands at once, but published in the order they came in.
+        // Every frame posted takes a slot in _jpeg_slots, which is done once its task ran or was dropped.
+        struct JpegSlot
+        {
+            sensor_msgs::CompressedImagePtr msg;    // Null if the frame wasn't encoded.
+            bool is_done;
+        };
+        // Held by the encoding task. Marks the slot done when the task is destroyed, whether it ran or not.
+        class JpegTicket
+        {
+            public:
+                JpegTicket(BaseRealSenseNode& node, StreamContext& context);
+                ~JpegTicket();
+                std::shared_ptr<JpegSlot> slot;
+            private:
+                BaseRealSenseNode& _node;
+                StreamContext& _context;
+        };
+        void postJpeg(rs2::video_frame frame, const ros::Time& t, StreamContext& context);
+        void encodeJpeg(rs2::video_frame frame, const ros::Time& t, int seq, JpegSlot& slot, StreamContext& context);
+        void finishJpeg(const std::shared_ptr<JpegSlot>& slot, StreamContext& context);
         bool getEnabledProfile(const stream_index_pair& stream_index, rs2::stream_profile& profile);
 
         void publishAlignedDepthToOthers(rs2::frameset frames, const ros::Time& t);
         sensor_msgs::Imu CreateUnitedMessage(const CimuData accel_data, const CimuData gyro_data);
 
-        void FillImuData_Copy(const CimuData imu_data, std::deque<sensor_msgs::Imu>& imu_msgs);
+        void FillImuData_Copy(const CimuData imu_data, std::vector<sensor_msgs::Imu>& imu_msgs);
         void ImuMessage_AddDefaultValues(sensor_msgs::Imu& imu_msg);
-        void FillImuData_LinearInterpolation(const CimuData imu_data, std::deque<sensor_msgs::Imu>& imu_msgs);
+        void FillImuData_LinearInterpolation(const CimuData imu_data, std::vector<sensor_msgs::Imu>& imu_msgs);
         void imu_callback(rs2::frame frame);
         void imu_callback_sync(rs2::frame frame, imu_sync_method sync_method=imu_sync_method::COPY);
         void pose_callback(rs2::frame frame);
         void multiple_message_callback(rs2::frame frame, imu_sync_method sync_method);
         void frame_callback(rs2::frame frame);
+        std::function<void(rs2::frame)> processOnWorkerPool(std::function<void(rs2::frame)> callback);
         void registerDynamicOption(ros::NodeHandle& nh, rs2::options sensor, std::string& module_name);
+        std::vector<OptionMetadata> getOptionsMetadata(rs2::options sensor, const std::string& module_name);
         void registerHDRoptions();
         void set_sensor_parameter_to_ros(const std::string& module_name, rs2::options sensor, rs2_option option);
         void monitor_update_functions();
@@ -245,12 +386,21 @@ namespace realsense2_camera
         rs2_stream rs2_string_to_stream(std::string str);
         void startMonitoring();
         void publish_temperature();
-        void publish_frequency_update();
+        void clockDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+        void recorderDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
 
         rs2::device _dev;
         std::map<stream_index_pair, rs2::sensor> _sensors;
         std::map<std::string, std::function<void(rs2::frame)>> _sensors_callback;
         std::vector<std::shared_ptr<ddynamic_reconfigure::DDynamicReconfigure>> _ddynrec;
+        std::mutex _ddynrec_mutex;
+        std::map<std::string, std::shared_ptr<OptionsHandle>> _options_handles;
+        std::mutex _sensors_mutex;
+        std::mutex _restart_mutex;
+        std::atomic<bool> _is_restart_pending;  // From the notification that starts a restart thread to its end.
+        std::mutex _restart_thread_mutex;       // Guards _restart_t. Not _restart_mutex, which warmRestart() takes.
+        std::shared_ptr<std::thread> _restart_t;
+        std::chrono::steady_clock::time_point _last_restart_time;
 
         std::string _json_file_path;
         std::string _serial_no;
@@ -273,7 +423,7 @@ namespace realsense2_camera
         std::map<rs2_stream, std::string> _stream_name;
         bool _publish_tf;
         double _tf_publish_rate;
-        tf2_ros::StaticTransformBroadcaster _static_tf_broadcaster;
+        std::shared_ptr<tf2_ros::StaticTransformBroadcaster> _static_tf_broadcaster;
         tf2_ros::TransformBroadcaster _dynamic_tf_broadcaster;
         std::vector<geometry_msgs::TransformStamped> _static_tf_msgs;
         std::shared_ptr<std::thread> _tf_t, _update_functions_t;
@@ -283,34 +433,92 @@ namespace realsense2_camera
         std::shared_ptr<SyncedImuPublisher> _synced_imu_publisher;
         std::map<rs2_stream, int> _image_format;
         std::map<stream_index_pair, ros::Publisher> _info_publisher;
+        std::map<stream_index_pair, ros::Publisher> _compressed_publisher;
+        std::map<stream_index_pair, ros::Publisher> _shm_publisher;
+        std::map<stream_index_pair, ros::Publisher> _depth_aligned_shm_publisher;
+        std::map<stream_index_pair, ros::Publisher> _raw_image_publisher;
+        std::map<stream_index_pair, ros::Publisher> _depth_aligned_raw_image_publisher;
+        std::map<stream_index_pair, std::shared_ptr<CompressionDiagnostics>> _compression_diagnostics;
         std::map<stream_index_pair, cv::Mat> _image;
         std::map<rs2_stream, std::string> _encoding;
 
-        std::map<stream_index_pair, int> _seq;
         std::map<rs2_stream, int> _unit_step_size;
         std::map<stream_index_pair, sensor_msgs::CameraInfo> _camera_info;
         std::atomic_bool _is_initialized_time_base;
-        double _camera_time_base;
+        std::atomic_bool _is_first_frame_published;
+        std::atomic_bool _is_paused;
+        bool _is_streaming;
+        std::function<void()> _first_frame_callback;
+        std::function<bool(const rs2::frame&)> _frame_filter;
+        HardwareClockModel _clock_model;
+        std::shared_ptr<diagnostic_updater::Updater> _diagnostics_updater;
         std::map<stream_index_pair, std::vector<rs2::stream_profile>> _enabled_profiles;
 
         ros::Publisher _pointcloud_publisher;
-        ros::Time _ros_time_base;
         bool _sync_frames;
+        FramesetSyncer::Settings _sync_settings;   // 0 tolerance or deadline: derived from the frame rates.
         bool _pointcloud;
         bool _publish_odom_tf;
         imu_sync_method _imu_sync_method;
+        // The buffers of imu_callback_sync, reused from sample to sample.
+        std::vector<CimuData> _imu_history;
+        std::vector<CimuData> _imu_gyros_data;
+        std::vector<sensor_msgs::Imu> _united_imu_msgs;
+        sensor_msgs::Imu _synced_imu_msg;
+        AllocationTracker _allocation_tracker;
         std::string _filters_str;
         stream_index_pair _pointcloud_texture;
-        PipelineSyncer _syncer;
         std::vector<NamedFilter> _filters;
         std::shared_ptr<rs2::filter> _colorizer, _pointcloud_filter;
         std::vector<rs2::sensor> _dev_sensors;
+        std::shared_ptr<WorkerPool> _worker_pool;
+        std::shared_ptr<WorkerPool> _jpeg_worker_pool;     // Only without _worker_pool. Declared before the strands, which it must outlive.
+        std::shared_ptr<WorkerPool> _rvl_worker_pool;      // Likewise.
+        bool _use_metadata_cache;
+        bool _parallel_startup;
+        bool _lazy_streaming;
+        bool _enable_depth_rvl;
+        bool _enable_color_jpeg;
+        int _color_jpeg_quality;
+        double _color_jpeg_scale;
+        bool _enable_shm;
+        int _shm_slots;
+        bool _serialize_from_frame;
+        std::string _record_dir;
+        std::shared_ptr<RawRecorder> _raw_recorder;
+        std::shared_ptr<FlightRecorder> _flight_recorder;
+        ros::ServiceServer _dump_flight_recorder_srv;
+        ros::Subscriber _flight_recorder_trigger_sub;
+        ros::ServiceServer _enable_tracing_srv;
+        ros::ServiceServer _dump_trace_srv;
+        double _metrics_rate;
+        int _metrics_port;
+        MetricsRegistry _metrics;
+        ros::Publisher _metrics_publisher;
+        std::shared_ptr<std::thread> _metrics_t;
+        std::shared_ptr<MetricsEndpoint> _metrics_endpoint;     // Declared after _metrics, which it reads.
+        PerfCounters _perf_counters;
+        PerfCounters::Stage* _clip_depth_perf;
+        PerfCounters::Stage* _fix_depth_scale_perf;
+        PerfCounters::Stage* _pointcloud_perf;
+        FramesetSyncer _syncer;     // Declared after _metrics, which it registers to.
+        std::shared_ptr<Strand> _rvl_strand;
+        std::shared_ptr<JpegEncoderPool> _jpeg_encoder_pool;
+        std::vector<std::shared_ptr<Strand>> _jpeg_strands;
+        std::mutex _jpeg_slots_mutex;
+        std::deque<std::shared_ptr<JpegSlot>> _jpeg_slots;     // In the order the frames were posted.
+        std::atomic<size_t> _next_jpeg_strand;
+        std::atomic<unsigned int> _topic_demand;    // The TopicDemand groups, updated by the monitoring thread.
+        bool _is_lazy_stopped;
+        std::string _metadata_cache_dir;
+        std::shared_ptr<DeviceMetadataCache> _metadata_cache;
+        std::vector<std::shared_ptr<Strand>> _strands;
 
         std::map<stream_index_pair, cv::Mat> _depth_aligned_image;
-        std::map<stream_index_pair, cv::Mat> _depth_scaled_image;
         std::map<rs2_stream, std::string> _depth_aligned_encoding;
         std::map<stream_index_pair, sensor_msgs::CameraInfo> _depth_aligned_camera_info;
-        std::map<stream_index_pair, int> _depth_aligned_seq;
+        std::vector<StreamContext> _stream_contexts;
+        std::vector<StreamContext> _depth_aligned_stream_contexts;
         std::map<stream_index_pair, ros::Publisher> _depth_aligned_info_publisher;
         std::map<stream_index_pair, ImagePublisherWithFrequencyDiagnostics> _depth_aligned_image_publishers;
         std::map<stream_index_pair, ros::Publisher> _depth_to_other_extrinsics_publishers;
@@ -323,7 +531,7 @@ namespace realsense2_camera
         std::vector< OptionTemperatureDiag > _temperature_nodes;
         std::shared_ptr<std::thread> _monitoring_t;
         std::vector<std::function<void()> > _update_functions_v;
-        mutable std::condition_variable _cv_monitoring, _cv_tf, _update_functions_cv;
+        mutable std::condition_variable _cv_monitoring, _cv_tf, _update_functions_cv, _cv_metrics;
 
         stream_index_pair _base_stream;
         const std::string _namespace;
@@ -0,0 +1,85 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <ros/ros.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <cstring>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // A CameraInfo message that is serialized only when the calibration changes. For every frame, only the header
+    // seq and stamp are patched into the serialized bytes, which lead the message. Publishers advertised as
+    // sensor_msgs::CameraInfo accept it as is.
+    class CachedCameraInfo
+    {
+    public:
+        CachedCameraInfo() : _is_valid(false) {}
+
+        void invalidate() { _is_valid = false; }
+
+        void update(const sensor_msgs::CameraInfo& camera_info, uint32_t seq, const ros::Time& stamp)
+        {
+            if (!_is_valid)
+            {
+                _buffer.resize(ros::serialization::serializationLength(camera_info));
+                ros::serialization::OStream stream(_buffer.data(), _buffer.size());
+                ros::serialization::serialize(stream, camera_info);
+                _is_valid = true;
+            }
+            // std_msgs/Header starts with uint32 seq, then time stamp as uint32 sec and uint32 nsec.
+            uint32_t header[3] = {seq, stamp.sec, stamp.nsec};
+            std::memcpy(_buffer.data(), header, sizeof(header));
+        }
+
+        const std::vector<uint8_t>& data() const { return _buffer; }
+
+    private:
+        bool _is_valid;
+        std::vector<uint8_t> _buffer;
+    };
+}
+
+namespace ros
+{
+    namespace message_traits
+    {
+        template<> struct IsMessage<realsense2_camera::CachedCameraInfo> : TrueType {};
+
+        template<> struct MD5Sum<realsense2_camera::CachedCameraInfo>
+        {
+            static const char* value() { return MD5Sum<sensor_msgs::CameraInfo>::value(); }
+            static const char* value(const realsense2_camera::CachedCameraInfo&) { return value(); }
+        };
+
+        template<> struct DataType<realsense2_camera::CachedCameraInfo>
+        {
+            static const char* value() { return DataType<sensor_msgs::CameraInfo>::value(); }
+            static const char* value(const realsense2_camera::CachedCameraInfo&) { return value(); }
+        };
+
+        template<> struct Definition<realsense2_camera::CachedCameraInfo>
+        {
+            static const char* value() { return Definition<sensor_msgs::CameraInfo>::value(); }
+            static const char* value(const realsense2_camera::CachedCameraInfo&) { return value(); }
+        };
+    }
+
+    namespace serialization
+    {
+        template<> struct Serializer<realsense2_camera::CachedCameraInfo>
+        {
+            template<typename Stream> inline static void write(Stream& stream, const realsense2_camera::CachedCameraInfo& m)
+            {
+                std::memcpy(stream.advance(m.data().size()), m.data().data(), m.data().size());
+            }
+
+            inline static uint32_t serializedLength(const realsense2_camera::CachedCameraInfo& m)
+            {
+                return m.data().size();
+            }
+        };
+    }
+}
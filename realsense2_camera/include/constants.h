@@ -66,6 +66,29 @@ namespace realsense2_camera
     const bool ENABLE_IMU     = true;
     const bool HOLD_BACK_IMU_FOR_FRAMES = false;
     const bool PUBLISH_ODOM_TF = true;
+    const bool USE_METADATA_CACHE = false;
+    const bool PARALLEL_STARTUP = true;
+    const bool WARM_RESTART = true;
+    const bool PLAYBACK_REAL_TIME = true;
+    const bool LAZY_STREAMING = false;
+    const bool ENABLE_DEPTH_RVL = false;
+    const bool ENABLE_COLOR_JPEG = false;
+    const int COLOR_JPEG_QUALITY = 80;
+    const double COLOR_JPEG_SCALE = 1.0;
+    const int COLOR_JPEG_ENCODERS = 2;
+    const bool ENABLE_SHM = false;
+    const int SHM_SLOTS = 8;
+    const bool SERIALIZE_FROM_FRAME = false;
+    const int RECORD_SEGMENT_SIZE_MB = 1024;
+    const int RECORD_MAX_BACKLOG = 8;
+    const int FLIGHT_RECORDER_SIZE_MB = 0;
+    const double FLIGHT_RECORDER_SECONDS = 10.0;
+    const bool TRACING = false;
+    const double METRICS_RATE = 1.0;
+    const int METRICS_PORT = 0;
+    const bool PERF_COUNTERS = false;
+    const double SYNC_TOLERANCE_MS = 0.0;
+    const double SYNC_DEADLINE_MS = 0.0;
 
 
     const std::string DEFAULT_BASE_FRAME_ID            = "camera_link";
@@ -93,6 +116,7 @@ namespace realsense2_camera
 
     const std::string DEFAULT_UNITE_IMU_METHOD         = "";
     const std::string DEFAULT_FILTERS                  = "";
+    const std::string DEFAULT_SYNC_PREFERRED_STREAM    = "";
     const std::string DEFAULT_TOPIC_ODOM_IN            = "";
 
     const float ROS_DEPTH_SCALE = 0.001;
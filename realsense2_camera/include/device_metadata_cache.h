@@ -0,0 +1,63 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <librealsense2/rs.hpp>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // Everything registerDynamicOption needs to know about an option, except its current value.
+    struct OptionMetadata
+    {
+        rs2_option option;
+        bool is_checkbox;
+        rs2::option_range range;
+        std::string description;
+        std::map<std::string, int> enum_dict;
+    };
+
+    // On-disk copy of the device metadata that takes many USB round trips to read: the options of every sensor
+    // and filter, and the intrinsics and extrinsics of the stream profiles.
+    // A cache file belongs to one serial number, firmware version, librealsense version and calibration. The
+    // calibration is told by a fingerprint of the intrinsics of one profile per sensor and the extrinsics between
+    // them, read live, so a device recalibrated in the field (on-chip or tare calibration) doesn't get the cached
+    // ones. A file that doesn't match all four is ignored and rewritten. Entries that are missing from the file are read from the device
+    // and added on save().
+    class DeviceMetadataCache
+    {
+    public:
+        DeviceMetadataCache(const std::string& cache_dir, rs2::device dev);
+
+        bool isValid() const { return _is_valid; }
+
+        bool getOptions(const std::string& module_name, std::vector<OptionMetadata>& options) const;
+        void setOptions(const std::string& module_name, const std::vector<OptionMetadata>& options);
+        bool getIntrinsics(const rs2::video_stream_profile& profile, rs2_intrinsics& intrinsics) const;
+        void setIntrinsics(const rs2::video_stream_profile& profile, const rs2_intrinsics& intrinsics);
+        bool getExtrinsics(const rs2::stream_profile& from, const rs2::stream_profile& to, rs2_extrinsics& extrinsics) const;
+        void setExtrinsics(const rs2::stream_profile& from, const rs2::stream_profile& to, const rs2_extrinsics& extrinsics);
+
+        void save();
+
+        static std::string defaultCacheDir();
+
+    private:
+        void load();
+        static std::string profileKey(const rs2::stream_profile& profile);
+        static std::string calibrationFingerprint(rs2::device dev);
+
+        std::string _file_path;
+        std::string _header;
+        bool _is_valid;
+        bool _is_dirty;
+        mutable std::mutex _mutex;
+        std::map<std::string, std::vector<OptionMetadata>> _options;
+        std::map<std::string, rs2_intrinsics> _intrinsics;
+        std::map<std::string, rs2_extrinsics> _extrinsics;
+    };
+}
@@ -0,0 +1,62 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include "../include/raw_recorder.h"
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace realsense2_camera
+{
+    // Keeps the frames of the last seconds in memory, to be written to disk when something goes wrong. The frames
+    // are copied on arrival into a ring buffer allocated once, so holding them neither allocates nor keeps
+    // librealsense from reusing its buffers. The oldest frames make room for the new ones. The frames held are listed
+    // in a circular array allocated once as well, with room for as many of the smallest records as the ring holds.
+    class FlightRecorder
+    {
+    public:
+        // size: bytes of the ring buffer. seconds: frames older than this are dropped.
+        FlightRecorder(size_t size, double seconds);
+
+        // Called from the sensor callbacks.
+        void record(const rs2::frame& frame);
+
+        // Writes the frames held into directory, as a single segment of RawRecorder. Returns the number of frames
+        // written. Throws std::runtime_error. The frames are written straight from the ring while the sensors go on:
+        // until the dump is done, the new frames that would overwrite the ones being written are dropped.
+        size_t dump(const std::string& directory);
+
+    private:
+        struct Entry
+        {
+            size_t offset;
+            size_t size;
+            int64_t arrival_time_ns;
+        };
+
+        void dropOlderThan(int64_t time_ns);
+        Entry& entry(size_t index) { return _entries[(_first_entry + index) % _entries_capacity]; }
+        void popEntry();
+        bool isPinned(size_t offset, size_t size) const;
+
+        const size_t _size;
+        const int64_t _duration_ns;
+        std::unique_ptr<uint8_t[]> _buffer;     // Not initialized: the pages are committed as the ring first fills.
+        const size_t _entries_capacity;
+        std::unique_ptr<Entry[]> _entries;      // Likewise.
+
+        std::mutex _mutex;
+        size_t _first_entry;                    // The oldest.
+        size_t _entries_count;
+        size_t _write_offset;
+        uint64_t _frames_dropped;               // Too large for the ring.
+        bool _is_dumping;
+        size_t _pinned_begin;                   // The bytes being dumped, wrapping around the end of the ring.
+        size_t _pinned_end;
+        uint64_t _frames_dropped_dumping;
+
+        std::mutex _dump_mutex;                 // One dump at a time.
+    };
+}
@@ -0,0 +1,87 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include "metrics_registry.h"
+#include <librealsense2/rs.hpp>
+#include <constants.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // Matches the frames of the image streams into framesets by timestamp, in place of rs2::asynchronous_syncer, whose
+    // framesets wait for the slowest sensor. A frameset is emitted as soon as it holds a frame of every stream, and at
+    // the latest at its deadline with the frames that arrived by then, so a sensor that hiccups delays the others by
+    // the deadline at most. The framesets are emitted in timestamp order: a complete frameset first emits the older
+    // ones, which can't complete anymore as the frames of each stream arrive in order.
+    class FramesetSyncer
+    {
+    public:
+        struct Settings
+        {
+            double tolerance_ms;            // Frames this close to the first frame of a frameset join it.
+            double deadline_ms;             // From the arrival of the first frame of a frameset.
+            rs2_stream preferred_stream;    // Partial framesets without a frame of this stream are dropped. RS2_STREAM_ANY: none.
+        };
+
+        explicit FramesetSyncer(MetricsRegistry& metrics);
+        ~FramesetSyncer();
+
+        // streams: the streams of a complete frameset. callback: called with every frameset, in order, from one thread
+        // at a time: the sensor thread that completed it or the deadline thread. The syncer isn't locked meanwhile, so
+        // the other sensors go on adding their frames.
+        void start(const Settings& settings, const std::vector<stream_index_pair>& streams, std::function<void(rs2::frame)> callback);
+        void stop();
+        // A frame, or a frameset of frames, from a sensor callback.
+        void operator()(rs2::frame frame);
+
+        // A task of a diagnostic_updater::Updater. The framesets since the last update.
+        void diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+    private:
+        struct Frameset
+        {
+            double timestamp;                                   // Of its first frame, in ms.
+            std::chrono::steady_clock::time_point arrival;      // Of its first frame.
+            std::vector<rs2::frame> frames;                     // One per stream, in the order of _streams. Empty if missing.
+            size_t frames_num;
+        };
+
+        void add(const rs2::frame& frame);
+        // Emits the pending framesets up to the given one, included, into _ready.
+        void emitUpTo(size_t index);
+        void emit(Frameset& frameset);
+        // Hands the emitted framesets over, without _mutex locked.
+        void dispatch();
+        void expireDeadlines();
+
+        Settings _settings;
+        std::vector<stream_index_pair> _streams;
+        rs2::processing_block _composer;
+        std::vector<rs2::frame> _composed;                      // The frames of the frameset _composer is composing.
+
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        std::deque<Frameset> _pending;                          // In timestamp order.
+        std::deque<std::vector<rs2::frame>> _ready;             // Emitted, to be dispatched in this order.
+        bool _is_dispatching;
+        double _last_emitted_timestamp;
+        bool _is_running;
+        std::thread _deadline_t;
+
+        MetricsRegistry::Counter& _complete;
+        MetricsRegistry::Counter& _partial;
+        MetricsRegistry::Counter& _dropped;
+        MetricsRegistry::Counter& _late_frames;
+        MetricsRegistry::Histogram& _wait;
+        uint64_t _last_complete, _last_partial, _last_dropped, _last_late_frames;  // At the last diagnostics update.
+    };
+}
@@ -0,0 +1,68 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+
+namespace realsense2_camera
+{
+    // Maps the device hardware clock to host time. Every sample pairs a hardware timestamp with the host time the
+    // frame arrived at. Arrival is always late by a varying USB and scheduling latency, so the model fits a line
+    // through the lower envelope of the samples: the earliest arrival in every bucket of the window. The line gives
+    // the offset and the skew (crystal drift) between the clocks.
+    // The line only ever drops as the envelope learns lower points, so the mapping applied to the timestamps follows
+    // it down at a bounded rate instead of stepping, which keeps the host times of every stream increasing.
+    // A hardware timestamp that jumps backwards or away from the host clock is taken as a clock wrap or reset and
+    // restarts the estimation.
+    class HardwareClockModel
+    {
+    public:
+        struct Status
+        {
+            bool is_valid;
+            double offset_sec;          // Host time minus hardware time, at the last sample.
+            double skew_ppm;            // How much faster the host clock runs than the hardware clock.
+            double residual_ms;         // RMS distance of the envelope points from the fitted line.
+            double latency_ms;          // Arrival time minus the estimated time, at the last sample.
+            unsigned int num_resets;
+        };
+
+        HardwareClockModel(double bucket_sec = 0.5, size_t window_buckets = 60);
+
+        // Adds a sample and returns the host time of hw_time_ms.
+        double toHostTime(double hw_time_ms, double arrival_sec);
+        void reset();
+        Status getStatus() const;
+
+    private:
+        struct Point
+        {
+            double hw_sec;      // Relative to _hw_origin_sec.
+            double delta_sec;   // Arrival minus hardware time.
+        };
+
+        void restart(double hw_sec, double arrival_sec);
+        void fit();
+        double estimate(double hw_sec) const;
+
+        const double _bucket_sec;
+        const size_t _window_buckets;
+
+        mutable std::mutex _mutex;
+        bool _is_started;
+        double _hw_origin_sec;
+        double _last_hw_sec;
+        double _last_arrival_sec;
+        double _bucket_start_sec;
+        std::deque<Point> _envelope;    // The minimum of every bucket. The last one is still open.
+        double _offset_sec;             // delta = _offset_sec + _skew * hw_sec
+        double _skew;
+        double _residual_sec;
+        double _applied_delta_sec;      // The offset the host times are computed with. Slews down to the line.
+        double _applied_hw_sec;         // Where it was last moved.
+        double _last_latency_sec;
+        unsigned int _num_resets;
+    };
+}
@@ -0,0 +1,83 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <cstring>
+#include <string>
+
+namespace realsense2_camera
+{
+    // A sensor_msgs::Image whose pixels are not owned but point into the frame buffer. It serializes into exactly the
+    // bytes of the equivalent sensor_msgs::Image, copying the pixels once, straight into the outgoing buffer.
+    // Publishers advertised as sensor_msgs::Image accept it as is. Publish it by reference: the pixels must stay
+    // valid until publish() returns, and in-process subscribers get a deserialized copy, not the view itself.
+    struct ImageFrameView
+    {
+        ImageFrameView() : height(0), width(0), is_bigendian(0), step(0), data(nullptr) {}
+
+        std_msgs::Header header;
+        uint32_t height;
+        uint32_t width;
+        std::string encoding;
+        uint8_t is_bigendian;
+        uint32_t step;
+        const uint8_t* data;    // height * step bytes.
+    };
+}
+
+namespace ros
+{
+    namespace message_traits
+    {
+        template<> struct IsMessage<realsense2_camera::ImageFrameView> : TrueType {};
+
+        template<> struct MD5Sum<realsense2_camera::ImageFrameView>
+        {
+            static const char* value() { return MD5Sum<sensor_msgs::Image>::value(); }
+            static const char* value(const realsense2_camera::ImageFrameView&) { return value(); }
+        };
+
+        template<> struct DataType<realsense2_camera::ImageFrameView>
+        {
+            static const char* value() { return DataType<sensor_msgs::Image>::value(); }
+            static const char* value(const realsense2_camera::ImageFrameView&) { return value(); }
+        };
+
+        template<> struct Definition<realsense2_camera::ImageFrameView>
+        {
+            static const char* value() { return Definition<sensor_msgs::Image>::value(); }
+            static const char* value(const realsense2_camera::ImageFrameView&) { return value(); }
+        };
+    }
+
+    namespace serialization
+    {
+        // Field by field as in sensor_msgs/Image. The pixels go out as a uint8[] of height * step bytes.
+        template<> struct Serializer<realsense2_camera::ImageFrameView>
+        {
+            template<typename Stream> inline static void write(Stream& stream, const realsense2_camera::ImageFrameView& m)
+            {
+                stream.next(m.header);
+                stream.next(m.height);
+                stream.next(m.width);
+                stream.next(m.encoding);
+                stream.next(m.is_bigendian);
+                stream.next(m.step);
+                uint32_t size(m.height * m.step);
+                stream.next(size);
+                if (size > 0)
+                {
+                    std::memcpy(stream.advance(size), m.data, size);
+                }
+            }
+
+            inline static uint32_t serializedLength(const realsense2_camera::ImageFrameView& m)
+            {
+                return serializationLength(m.header) + 4 + 4 + serializationLength(m.encoding) + 1 + 4 + 4 + m.height * m.step;
+            }
+        };
+    }
+}
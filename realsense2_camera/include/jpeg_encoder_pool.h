@@ -0,0 +1,44 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // Encodes 8 bit color images to JPEG, optionally at a lower resolution. Every encoding borrows one of a fixed
+    // set of contexts, which keep their scaling and color conversion buffers between frames, so encodings running
+    // concurrently on different threads share nothing and allocate nothing but the output.
+    class JpegEncoderPool
+    {
+    public:
+        JpegEncoderPool(size_t contexts_num, int quality, double scale);
+
+        // Encodes width x height packed RGB (or BGR) pixels with rows stride bytes apart, without copying them first.
+        // Returns false if all contexts are busy or the encoding failed.
+        bool encode(const uint8_t* data, int width, int height, size_t stride, bool is_bgr, std::vector<uint8_t>& output);
+
+        int quality() const { return _params[1]; }
+        double scale() const { return _scale; }
+
+    private:
+        struct Context
+        {
+            cv::Mat scaled;
+            cv::Mat bgr;
+        };
+
+        std::unique_ptr<Context> acquire();
+        void release(std::unique_ptr<Context> context);
+
+        const std::vector<int> _params;
+        const double _scale;
+        std::mutex _mutex;
+        std::vector<std::unique_ptr<Context>> _free_contexts;
+    };
+}
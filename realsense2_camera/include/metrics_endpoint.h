@@ -0,0 +1,31 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace realsense2_camera
+{
+    // A minimal HTTP server on the loopback interface, for a Prometheus scraper on the same host (or an agent that
+    // forwards to it). Every request is answered with the text of body(), whatever its path.
+    class MetricsEndpoint
+    {
+    public:
+        // Throws std::runtime_error if the port can't be listened on.
+        MetricsEndpoint(int port, std::function<std::string()> body);
+        ~MetricsEndpoint();
+
+    private:
+        void serve();
+        void respond(int connection);
+
+        std::function<std::string()> _body;
+        int _socket;
+        std::atomic<bool> _is_alive;
+        std::thread _t;
+    };
+}
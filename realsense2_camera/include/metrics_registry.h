@@ -0,0 +1,105 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // Counters, gauges and histograms of a node, for dashboards. The modules register their metrics once and then
+    // update them with atomic operations only, from any thread. The registry is read at a fixed rate, into the
+    // metrics topic and the Prometheus text endpoint. Names and labels follow the Prometheus conventions, e.g.
+    // name "realsense_published_messages_total" with labels "stream=\"depth\"".
+    class MetricsRegistry
+    {
+    public:
+        class Counter
+        {
+        public:
+            Counter() : _value(0) {}
+            void add(uint64_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+            uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+        private:
+            std::atomic<uint64_t> _value;
+        };
+
+        class Gauge
+        {
+        public:
+            Gauge() : _value(0) {}
+            void set(double value) { _value.store(value, std::memory_order_relaxed); }
+            double value() const { return _value.load(std::memory_order_relaxed); }
+
+        private:
+            std::atomic<double> _value;
+        };
+
+        class Histogram
+        {
+        public:
+            // bounds: the upper bounds of the buckets, ascending. A last bucket takes the values above them.
+            explicit Histogram(const std::vector<double>& bounds);
+            void observe(double value);
+
+            const std::vector<double>& bounds() const { return _bounds; }
+            uint64_t bucketCount(size_t bucket) const { return _buckets[bucket].load(std::memory_order_relaxed); }
+            uint64_t count() const;
+            double sum() const { return _sum.load(std::memory_order_relaxed); }
+
+        private:
+            const std::vector<double> _bounds;
+            std::unique_ptr<std::atomic<uint64_t>[]> _buckets;     // bounds().size() + 1.
+            std::atomic<double> _sum;
+        };
+
+        // A sample of a collector: labels and value.
+        typedef std::vector<std::pair<std::string, double>> Samples;
+
+        enum Type {COUNTER, GAUGE, HISTOGRAM};
+
+        // The metrics live as long as the registry. Registering a name and labels twice returns the same metric.
+        Counter& counter(const std::string& name, const std::string& labels, const std::string& help);
+        Gauge& gauge(const std::string& name, const std::string& labels, const std::string& help);
+        Histogram& histogram(const std::string& name, const std::string& labels, const std::string& help,
+                             const std::vector<double>& bounds);
+        // For the values kept elsewhere anyway: collect is called on every read of the registry, and fills the
+        // samples of the metric, e.g. one per thread.
+        void collector(const std::string& name, Type type, const std::string& help, std::function<void(Samples&)> collect);
+
+        // Every series, e.g. realsense_published_messages_total{stream="depth"}, with its value. A histogram goes as
+        // its _count and _sum.
+        void sample(std::vector<std::string>& names, std::vector<double>& values);
+        // The Prometheus text exposition format.
+        std::string exposition();
+
+        // Buckets of 1 ms to about 2 s, for durations in seconds.
+        static std::vector<double> durationBounds();
+
+    private:
+        struct Entry
+        {
+            std::string name;
+            std::string labels;
+            std::string help;
+            Type type;
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Gauge> gauge;
+            std::unique_ptr<Histogram> histogram;
+            std::function<void(Samples&)> collect;
+        };
+
+        Entry* find(const std::string& name, const std::string& labels);
+        Entry& add(const std::string& name, const std::string& labels, const std::string& help, Type type);
+
+        std::mutex _mutex;
+        std::vector<std::unique_ptr<Entry>> _entries;   // In the order registered.
+    };
+}
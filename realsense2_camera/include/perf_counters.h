@@ -0,0 +1,69 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include "metrics_registry.h"
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // The hardware performance counters of the CPU around the stages of the pipeline: cycles, instructions, cache
+    // misses and branch misses, to tell which stages are bound by memory or by branches. Each thread opens its own
+    // counters with perf_event_open on the first stage it runs, and reads them at the start and end of every stage.
+    // Only the calling thread is counted, not the OpenMP threads a stage spreads over. Where the counters can't be
+    // opened (perf_event_paranoid, a VM without a PMU), the stages aren't counted and run as they would without.
+    class PerfCounters
+    {
+    public:
+        enum Event {CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, EVENTS_NUM};
+
+        // The counts of a stage, summed over its runs on all threads, as realsense_perf_*_total{stage="..."}.
+        class Stage
+        {
+        public:
+            Stage(MetricsRegistry& metrics, const std::string& name);
+            void add(const uint64_t (&counts)[EVENTS_NUM]);
+            void diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+        private:
+            std::string _name;
+            MetricsRegistry::Counter& _runs;
+            MetricsRegistry::Counter* _events[EVENTS_NUM];
+            uint64_t _last_runs;                    // At the last diagnostics update.
+            uint64_t _last_events[EVENTS_NUM];
+        };
+
+        // Counts the calling thread during its lifetime as a run of the stage. Does nothing for a null stage.
+        class Scope
+        {
+        public:
+            explicit Scope(Stage* stage);
+            ~Scope();
+
+        private:
+            Stage* _stage;
+            uint64_t _start[EVENTS_NUM];
+            uint64_t _start_time_enabled;
+            uint64_t _start_time_running;
+        };
+
+        explicit PerfCounters(MetricsRegistry& metrics);
+
+        void setEnabled(bool enabled) { _is_enabled = enabled; }
+        bool isEnabled() const { return _is_enabled; }
+        // Registers a stage at setup. Returns null while disabled, so that the scopes of the stage do nothing.
+        Stage* stage(const std::string& name);
+        // A task of a diagnostic_updater::Updater. IPC and misses per 1000 instructions of every stage since the last update.
+        void diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+    private:
+        MetricsRegistry& _metrics;
+        bool _is_enabled;
+        std::vector<std::unique_ptr<Stage>> _stages;
+    };
+}
@@ -0,0 +1,80 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <librealsense2/rs.hpp>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace realsense2_camera
+{
+    // Paces the frames of a file played back by librealsense. The sensor callbacks pass every frame through admit()
+    // before processing it. While paused, admit() holds the frames back, and step() lets them through one at a time,
+    // the earliest first. Out of real time, librealsense reads the file only as fast as the callbacks return, so no
+    // frame is skipped and the playback runs as fast as the frames are processed.
+    //
+    // Seeks run on a thread of the controller, as librealsense can't seek from its own callbacks. At the end of the
+    // file librealsense stops the sensors: a seek, or the loop range, starts them again through the restart callback.
+    class PlaybackController
+    {
+    public:
+        struct Status
+        {
+            double position_sec;
+            double duration_sec;
+            bool is_paused;
+            bool is_finished;           // The end of the file was reached.
+            uint64_t frames;            // Admitted since the start.
+            double loop_start_sec;
+            double loop_end_sec;        // 0 if not looping.
+        };
+
+        PlaybackController(rs2::device device, bool real_time, std::function<void()> restart);
+        ~PlaybackController();
+        // Stops holding frames back for good, so the sensors can be stopped.
+        void shutdown();
+
+        // Called from the sensor callbacks. Blocks while paused. Returns false if the frame must be dropped.
+        bool admit(const rs2::frame& frame);
+
+        void setPaused(bool paused);
+        // Lets one frame through while paused. False if not paused.
+        bool step();
+        // Seconds from the start of the file. Returns when the playback is at the new position. Throws std::out_of_range.
+        void seek(double position_sec);
+        // Plays [start_sec, end_sec) over and over. end_sec 0 stops looping. Throws std::out_of_range.
+        void setLoop(double start_sec, double end_sec);
+
+        Status getStatus();
+
+    private:
+        void onStatusChanged(rs2_playback_status status);
+        void requestSeek(uint64_t position_ns);
+        void seekLoop();
+
+        rs2::playback _playback;
+        const uint64_t _duration_ns;
+        std::function<void()> _restart;
+
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        bool _is_paused;
+        unsigned int _steps;
+        std::multiset<double> _waiting;     // Timestamps of the frames held back.
+        bool _is_discarding;                // While seeking.
+        bool _is_finished;
+        uint64_t _frames;
+        uint64_t _loop_start_ns;
+        uint64_t _loop_end_ns;
+
+        bool _is_seek_pending;
+        uint64_t _seek_position_ns;
+        bool _is_alive;
+        std::condition_variable _seek_cv;
+        std::thread _seek_t;
+    };
+}
@@ -0,0 +1,146 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <librealsense2/rs.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace realsense2_camera
+{
+    // Records the frames of the sensors as they arrive, before any processing, into a directory of segment files.
+    // The sensor callbacks only queue the frames. A writer thread of its own copies every frame with its metadata
+    // into a preallocated, memory-mapped segment and appends an entry to the segment's index. A frame that finds the
+    // queue full is dropped and counted, rather than holding up the sensor.
+    //
+    // Files, all little endian:
+    //   segment_NNNNN.raw: records, each a RawRecordHeader, metadata_count RawRecordMetadata and data_size bytes of
+    //                      frame data, padded to RAW_RECORD_ALIGNMENT. Truncated to its records when closed.
+    //   segment_NNNNN.idx: one RawIndexEntry per record of the segment, in the same order.
+    const uint32_t RAW_RECORD_MAGIC = 0x46525352;    // "RSRF"
+    const size_t RAW_RECORD_ALIGNMENT = 8;
+
+#pragma pack(push, 1)
+    struct RawRecordHeader
+    {
+        uint32_t magic;
+        uint16_t stream;            // rs2_stream
+        uint8_t stream_index;
+        uint8_t format;             // rs2_format
+        uint16_t width;             // 0 for motion and pose frames.
+        uint16_t height;
+        uint32_t stride;            // Bytes per row, 0 for motion and pose frames.
+        uint32_t data_size;
+        uint32_t metadata_count;
+        uint32_t timestamp_domain;  // rs2_timestamp_domain
+        uint64_t frame_number;
+        double timestamp_ms;        // Frame timestamp, in timestamp_domain.
+        int64_t arrival_time_ns;    // System clock when the frame arrived.
+    };
+
+    struct RawRecordMetadata
+    {
+        uint32_t key;               // rs2_frame_metadata_value
+        int64_t value;
+    };
+
+    struct RawIndexEntry
+    {
+        uint64_t offset;            // Of the record in the segment.
+        uint32_t record_size;
+        uint16_t stream;
+        uint8_t stream_index;
+        uint8_t reserved;
+        uint64_t frame_number;
+        double timestamp_ms;
+        int64_t arrival_time_ns;
+    };
+#pragma pack(pop)
+
+    // Fills the header and metadata of the record of frame. metadata must have room for RS2_FRAME_METADATA_COUNT
+    // entries. Returns the size of the record.
+    size_t describeRawRecord(const rs2::frame& frame, int64_t arrival_time_ns, RawRecordHeader& header, RawRecordMetadata* metadata);
+    // Writes the record described by header and metadata to destination, which must have room for it.
+    void copyRawRecord(const rs2::frame& frame, const RawRecordHeader& header, const RawRecordMetadata* metadata, uint8_t* destination);
+    RawIndexEntry makeRawIndexEntry(const RawRecordHeader& header, uint64_t offset, uint32_t record_size);
+    // Creates directory and its parents. Throws std::runtime_error.
+    void createRecordingDirectory(const std::string& directory);
+
+    class RawRecorder
+    {
+    public:
+        struct Status
+        {
+            bool is_recording;
+            std::string directory;
+            double write_mb_per_sec;    // Since the previous getStatus().
+            size_t backlog_frames;
+            size_t backlog_bytes;
+            uint64_t frames_written;
+            uint64_t frames_dropped;
+            uint64_t bytes_written;
+            unsigned int segments;
+        };
+
+        RawRecorder(size_t segment_size, size_t max_backlog_frames);
+        ~RawRecorder();
+
+        // Creates directory and starts writing into it. Throws std::runtime_error on failure.
+        void start(const std::string& directory);
+        // Writes what is queued and closes the files.
+        void stop();
+        bool isRecording() const { return _is_recording; }
+
+        // Called from the sensor callbacks.
+        void record(const rs2::frame& frame);
+
+        Status getStatus();
+
+    private:
+        struct QueuedFrame
+        {
+            rs2::frame frame;
+            int64_t arrival_time_ns;
+        };
+
+        void writerLoop();
+        void write(const QueuedFrame& queued);
+        void openSegment();
+        void closeSegment();
+
+        const size_t _segment_size;
+        const size_t _max_backlog_frames;
+
+        std::mutex _control_mutex;    // Serializes start() and stop().
+        std::atomic_bool _is_recording;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        std::deque<QueuedFrame> _queue;
+        size_t _backlog_bytes;
+        bool _stop_writer;
+        std::thread _writer_t;
+
+        // Owned by the writer thread while recording.
+        std::string _directory;
+        unsigned int _segment_number;
+        int _segment_fd;
+        uint8_t* _segment;
+        size_t _segment_used;
+        size_t _segment_synced;
+        std::ofstream _index;
+
+        std::atomic<uint64_t> _frames_written;
+        std::atomic<uint64_t> _frames_dropped;
+        std::atomic<uint64_t> _bytes_written;
+        std::atomic<unsigned int> _segments;
+        uint64_t _last_status_bytes;
+        std::chrono::steady_clock::time_point _last_status_time;
+    };
+}
@@ -0,0 +1,89 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include "../include/realsense_node_factory.h"
+#include "../include/worker_pool.h"
+#include <condition_variable>
+#include <mutex>
+
+namespace realsense2_camera
+{
+    // Runs several cameras in one nodelet: a single context enumerates all devices and every camera node
+    // processes its frames on one shared worker pool, instead of each camera bringing its own threads.
+    class RealSenseMultiDeviceManager : public nodelet::Nodelet
+    {
+    public:
+        RealSenseMultiDeviceManager();
+        virtual ~RealSenseMultiDeviceManager();
+
+    private:
+        // The name and the node handles are set once by onInit(). The rest is guarded by _cameras_mutex.
+        struct Camera
+        {
+            std::string name;
+            ros::NodeHandle nh;
+            ros::NodeHandle pnh;
+            std::string serial_no;
+            std::string usb_port_id;
+            std::string device_type;
+            std::string synthetic_device;
+            bool initial_reset;
+            rs2::device device;
+            std::string device_serial_no;
+            std::shared_ptr<SyntheticDevice> synthetic;
+            std::shared_ptr<InterfaceRealSenseNode> node;
+            bool is_starting;           // A device is claimed and its node is being built, without the lock.
+            bool is_resetting;          // The device is claimed while it is reset, without the lock.
+            uint64_t generation;        // Counts the stops, so that a start knows whether it was overtaken.
+            ros::ServiceServer toggle_sensor_srv;
+            ros::ServiceServer pause_sensor_srv;
+            ros::ServiceServer record_srv;
+            ros::ServiceServer reset_srv;
+        };
+
+        // What startCamera() needs of a camera, copied under _cameras_mutex.
+        struct CameraStart
+        {
+            std::shared_ptr<Camera> camera;
+            rs2::device device;
+            std::string serial_no;
+            std::shared_ptr<SyntheticDevice> synthetic;
+            uint64_t generation;
+        };
+
+        // What stopCamera() took out of a camera, to be destroyed once _cameras_mutex is unlocked: destroying a node
+        // stops its sensors and joins its threads. The node goes before the synthetic device that feeds it.
+        struct StoppedCamera
+        {
+            std::shared_ptr<SyntheticDevice> synthetic;
+            std::shared_ptr<InterfaceRealSenseNode> node;
+        };
+
+        virtual void onInit() override;
+        void setDefaultFrameIds(Camera& camera);
+        void discoveryLoop();
+        std::vector<CameraStart> attachDevices();
+        bool isDeviceTaken(const std::string& serial_no) const;
+        bool matchDevice(const Camera& camera, rs2::device dev) const;
+        CameraStart claimDevice(const std::shared_ptr<Camera>& camera, rs2::device dev);
+        std::shared_ptr<InterfaceRealSenseNode> startCamera(const CameraStart& start);
+        StoppedCamera stopCamera(Camera& camera);
+        std::shared_ptr<InterfaceRealSenseNode> getNode(Camera* camera);
+        void change_device_callback(rs2::event_information& info);
+        bool toggle_sensor_callback(Camera* camera, std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
+        bool pause_sensor_callback(Camera* camera, std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
+        bool record_callback(Camera* camera, std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
+        bool handleReset(Camera* camera, std_srvs::Empty::Request& request, std_srvs::Empty::Response& response);
+
+        rs2::context _ctx;
+        std::shared_ptr<WorkerPool> _worker_pool;
+        std::vector<std::shared_ptr<Camera>> _cameras;
+        std::mutex _cameras_mutex;
+        std::condition_variable _cv;
+        bool _rescan;
+        bool _is_alive;
+        std::thread _discovery_thread;
+    };
+}//end namespace
@@ -21,7 +21,13 @@
 #include <eigen3/Eigen/Geometry>
 #include <fstream>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <std_srvs/Empty.h>
+#include <std_srvs/Trigger.h>
+#include <realsense2_camera/PlaybackSeek.h>
+#include <realsense2_camera/PlaybackLoop.h>
 
 namespace realsense2_camera
 {
@@ -50,39 +56,73 @@ namespace realsense2_camera
     public:
         virtual void publishTopics() = 0;
         virtual void toggleSensors(bool enabled) = 0;
+        virtual void pauseSensors(bool paused) = 0;       // Keeps the sensors streaming but drops their frames on arrival.
+        virtual bool setRecording(bool enabled, std::string& message) = 0;    // Starts or stops the raw recorder.
         virtual void registerDynamicReconfigCb(ros::NodeHandle& nh) = 0;
+        virtual bool warmRestart(rs2::device dev) = 0;    // Re-opens the sensors, on dev if it was re-enumerated. False if not supported.
         virtual ~InterfaceRealSenseNode() = default;
     };
 
+    class SyntheticDevice;
+    class PlaybackController;
+
     class RealSenseNodeFactory : public nodelet::Nodelet
     {
     public:
         RealSenseNodeFactory();
         virtual ~RealSenseNodeFactory();
 
+        static std::string parse_usb_port(std::string line);
+        static void tryGetLogSeverity(rs2_log_severity& severity);
+
     private:
         void closeDevice();
         void StartDevice();
         void change_device_callback(rs2::event_information& info);
         void getDevice(rs2::device_list list);
+        void setDevice(const rs2::device& dev);
         virtual void onInit() override;
         void initialize(const ros::WallTimerEvent &ignored);
-        void tryGetLogSeverity(rs2_log_severity& severity) const;
+        void queryDevicesLoop();
+        void stopQueryThread();
+        void onFirstFrame();
         void reset();
         bool handleReset(std_srvs::Empty::Request& request, std_srvs::Empty::Response& response);
-        static std::string parse_usb_port(std::string line);
         bool toggle_sensor_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res);
+        bool pause_sensor_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res);
+        bool record_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res);
+        void advertisePlaybackServices(ros::NodeHandle& nh);
+        bool playback_pause_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res);
+        bool playback_step_callback(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res);
+        bool playback_seek_callback(PlaybackSeek::Request &req, PlaybackSeek::Response &res);
+        bool playback_loop_callback(PlaybackLoop::Request &req, PlaybackLoop::Response &res);
 
+        std::shared_ptr<PlaybackController> _playback_controller;    // Declared before the device, whose status callback it is.
+        // Written with _query_mutex locked, and read with it from the devices changed callback. The other threads
+        // read it without: only one of them writes it at a time, the query thread being stopped before reset().
         rs2::device _device;
+        std::shared_ptr<SyntheticDevice> _synthetic_device;
         std::shared_ptr<InterfaceRealSenseNode> _realSenseNode;
         rs2::context _ctx;
         std::string _serial_no;
         std::string _usb_port_id;
         std::string _device_type;
         bool _initial_reset;
+        bool _warm_restart;
         std::thread _query_thread;
         bool _is_alive;
+        std::mutex _query_mutex;
+        std::condition_variable _query_cv;
+        bool _devices_changed;
+        rs2::device _reset_device;
+        std::chrono::steady_clock::time_point _attach_start_time;
         ros::ServiceServer toggle_sensor_srv;
+        ros::ServiceServer pause_sensor_srv;
+        ros::ServiceServer record_srv;
+        ros::ServiceServer playback_pause_srv;
+        ros::ServiceServer playback_step_srv;
+        ros::ServiceServer playback_seek_srv;
+        ros::ServiceServer playback_loop_srv;
         ros::WallTimer _init_timer;
         ros::ServiceServer _reset_srv;
 
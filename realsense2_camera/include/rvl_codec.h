@@ -0,0 +1,26 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace realsense2_camera
+{
+    // Lossless codec for 16 bit depth images: RVL, "Fast Lossless Depth Image Compression" (A. D. Wilson, 2017).
+    // Runs of zero (invalid) pixels and runs of valid pixels alternate. Valid pixels are stored as zigzag coded
+    // deltas from the previous valid pixel. All numbers are written as variable length nibble sequences, packed in
+    // 32 bit words. The output is the same as the rvl format of compressed_depth_image_transport.
+    namespace rvl
+    {
+        // Upper bound of the encoded size, for allocating the output buffer.
+        size_t maxEncodedSize(size_t num_pixels);
+
+        // Returns the number of bytes written to output.
+        size_t encode(const uint16_t* input, size_t num_pixels, uint8_t* output);
+
+        // Throws std::runtime_error if input is truncated or doesn't hold exactly num_pixels pixels.
+        void decode(const uint8_t* input, size_t input_size, uint16_t* output, size_t num_pixels);
+    }
+}
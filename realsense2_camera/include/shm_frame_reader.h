@@ -0,0 +1,53 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include "../include/shm_ring.h"
+#include <ros/ros.h>
+#include <realsense2_camera/ShmFrame.h>
+#include <memory>
+#include <stdexcept>
+
+namespace realsense2_camera
+{
+    // Resolves the ShmFrame messages of one topic to their pixels, in place. Use it in a plain ros::Subscriber
+    // callback to read the frames without any copy:
+    //
+    //   const uint8_t* pixels = reader.data(*msg);
+    //   if (pixels) { ...read msg->size bytes... if (!reader.isValid(*msg)) { ...overwritten meanwhile, discard... } }
+    //
+    // The ring is re-mapped when the camera node restarts and its segment name changes.
+    class ShmFrameReader
+    {
+    public:
+        // Returns nullptr if the frame was overwritten already or the segment can't be mapped.
+        const uint8_t* data(const ShmFrame& frame)
+        {
+            if (!_ring || _ring->name() != frame.segment)
+            {
+                _ring.reset();
+                try
+                {
+                    _ring.reset(new ShmRingReader(frame.segment));
+                }
+                catch (const std::runtime_error& e)
+                {
+                    ROS_WARN_STREAM_THROTTLE(5, e.what());
+                    return nullptr;
+                }
+            }
+            uint32_t size(0);
+            const uint8_t* data(_ring->data(frame.slot, frame.sequence, size));
+            return (data && size >= frame.size) ? data : nullptr;
+        }
+
+        bool isValid(const ShmFrame& frame) const
+        {
+            return _ring && _ring->name() == frame.segment && _ring->isValid(frame.slot, frame.sequence);
+        }
+
+    private:
+        std::unique_ptr<ShmRingReader> _ring;
+    };
+}
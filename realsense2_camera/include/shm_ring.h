@@ -0,0 +1,98 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace realsense2_camera
+{
+    // A ring of fixed size slots in a POSIX shared memory object, written by a single process and read in place by
+    // any number of processes on the same host. Nothing is locked: every slot carries a sequence number that is odd
+    // while the slot is written and even once it holds a frame, like a seqlock. A reader checks the number before and
+    // after it uses the slot and discards what it read if the writer came around to the slot in between.
+    //
+    // Segment layout: ShmRingHeader, then slot_count times a ShmSlotHeader followed by slot_size payload bytes, every
+    // part aligned to SHM_RING_ALIGNMENT.
+
+    const uint32_t SHM_RING_MAGIC = 0x52535348;    // "HSSR"
+    const uint32_t SHM_RING_VERSION = 1;
+    const size_t SHM_RING_ALIGNMENT = 64;
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The shared memory ring needs lock free 64 bit atomics");
+
+    struct ShmRingHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t slot_size;
+        std::atomic<uint64_t> write_count;
+    };
+
+    struct ShmSlotHeader
+    {
+        std::atomic<uint64_t> sequence;
+        uint32_t size;
+    };
+
+    class ShmRingWriter
+    {
+    public:
+        // Creates the segment, replacing a stale one of the same name. Throws std::runtime_error on failure.
+        ShmRingWriter(const std::string& name, uint32_t slot_count, size_t slot_size);
+        ~ShmRingWriter();   // Unlinks the segment. Readers that still map it keep their mapping.
+
+        // Unlinks the segments named <prefix><pid>_<anything> whose process is gone, the ones a crashed writer left
+        // behind. Returns how many were unlinked.
+        static size_t unlinkStale(const std::string& prefix);
+
+        // Copies size bytes into the next slot and returns where it went: the slot and its new sequence number.
+        // Returns false if size doesn't fit in a slot.
+        bool write(const void* data, size_t size, uint32_t& slot, uint64_t& sequence);
+
+        const std::string& name() const { return _name; }
+        size_t slotSize() const { return _slot_size; }
+
+    private:
+        ShmRingWriter(const ShmRingWriter&) = delete;
+        ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+        std::string _name;
+        uint32_t _slot_count;
+        size_t _slot_size;
+        size_t _segment_size;
+        uint8_t* _segment;
+        uint64_t _write_count;
+    };
+
+    class ShmRingReader
+    {
+    public:
+        // Maps an existing segment read only. Throws std::runtime_error on failure.
+        explicit ShmRingReader(const std::string& name);
+        ~ShmRingReader();
+
+        // Returns the payload of slot if it still holds sequence, otherwise nullptr. The payload is read in place:
+        // call isValid() after using it to know whether it was overwritten meanwhile.
+        const uint8_t* data(uint32_t slot, uint64_t sequence, uint32_t& size) const;
+        bool isValid(uint32_t slot, uint64_t sequence) const;
+
+        const std::string& name() const { return _name; }
+
+    private:
+        ShmRingReader(const ShmRingReader&) = delete;
+        ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+        const ShmSlotHeader* slotHeader(uint32_t slot) const;
+
+        std::string _name;
+        uint32_t _slot_count;
+        size_t _slot_size;
+        size_t _segment_size;
+        uint8_t* _segment;
+    };
+}
@@ -0,0 +1,27 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include "../include/shm_frame_reader.h"
+#include <image_transport/simple_subscriber_plugin.h>
+#include <sensor_msgs/Image.h>
+
+namespace realsense2_camera
+{
+    // image_transport "shm" subscriber: subscribes to <base topic>/shm and copies every frame once, from the shared
+    // memory ring straight into the sensor_msgs::Image handed to the callback. Subscribers that can work on the
+    // pixels in place should use ShmFrameReader instead.
+    class ShmSubscriberPlugin : public image_transport::SimpleSubscriberPlugin<ShmFrame>
+    {
+    public:
+        virtual ~ShmSubscriberPlugin() {}
+        virtual std::string getTransportName() const { return "shm"; }
+
+    protected:
+        virtual void internalCallback(const ShmFrameConstPtr& message, const Callback& user_cb);
+
+    private:
+        ShmFrameReader _reader;
+    };
+}
@@ -0,0 +1,47 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace realsense2_camera
+{
+    // Rate, jitter and latency of the frames published on a stream, between two diagnostics updates. tick() only
+    // adds to atomic counters, so the frame callbacks never wait for the diagnostics. Latencies go into a histogram
+    // of logarithmic buckets, 19% wide, from which the percentiles are read.
+    class StreamDiagnostics
+    {
+    public:
+        StreamDiagnostics(const std::string& name, double expected_frequency);
+
+        // Called for every frame published. latency_sec: from the frame timestamp to its publishing.
+        void tick(double latency_sec);
+        // A task of a diagnostic_updater::Updater. Reports and starts over.
+        void diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+        const std::string& name() const { return _name; }
+
+    private:
+        static const int LATENCY_BUCKETS = 64;
+
+        static int latencyBucket(int64_t latency_us);
+        static double latencyBucketLimitMs(int bucket);
+
+        const std::string _name;
+        const double _expected_frequency;
+
+        std::atomic<uint32_t> _frames;
+        std::atomic<int64_t> _last_tick_ns;
+        std::atomic<uint32_t> _intervals;
+        std::atomic<uint64_t> _interval_sum_us;
+        std::atomic<uint64_t> _interval_square_sum_us;
+        std::atomic<uint32_t> _latency_histogram[LATENCY_BUCKETS];
+        std::atomic<int64_t> _max_latency_us;
+
+        std::chrono::steady_clock::time_point _last_report_time;   // Used by diagnostics() only.
+    };
+}
@@ -0,0 +1,75 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <ros/ros.h>
+#include <librealsense2/rs.hpp>
+#include <librealsense2/hpp/rs_internal.hpp>
+#include <constants.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // Emulates the sensor layout of a real device (d435i, l515 or t265) on top of rs2::software_device.
+    // Frames are generated by one thread per sensor and only for the profiles the node opened, so the
+    // device goes through exactly the same BaseRealSenseNode path as real hardware does.
+    class SyntheticDevice
+    {
+    public:
+        SyntheticDevice(const std::string& layout, const std::string& serial_no, ros::NodeHandle& privateNodeHandle);
+        ~SyntheticDevice();
+
+        rs2::device getDevice() const { return _dev; }
+        std::string getSerialNumber() const { return _serial_no; }
+
+        static bool isSupportedLayout(const std::string& layout);
+
+    private:
+        struct SyntheticStream
+        {
+            rs2::stream_profile profile;
+            stream_index_pair   sip;
+            rs2_format          format;
+            int                 bpp;
+            int                 fps;
+            rs2_intrinsics      intrinsics;
+            float               position_x;     // Offset of the imager from the base stream origin [m].
+            double              next_time_ms;
+        };
+
+        struct SyntheticSensor
+        {
+            SyntheticSensor(rs2::software_sensor software_sensor) : sensor(software_sensor) {}
+
+            rs2::software_sensor         sensor;
+            std::vector<SyntheticStream> streams;
+        };
+
+        SyntheticSensor& addSensor(const std::string& name);
+        void addVideoStream(SyntheticSensor& sensor, const stream_index_pair& sip, rs2_format format,
+                            int width, int height, int fps, float hfov_deg, rs2_distortion model, float position_x);
+        void addMotionStream(SyntheticSensor& sensor, const stream_index_pair& sip, int fps);
+        void addPoseStream(SyntheticSensor& sensor, int fps);
+        void readStreamParams(const stream_index_pair& sip, int& width, int& height, int& fps) const;
+        void registerExtrinsics();
+
+        void generatorLoop(SyntheticSensor& sensor);
+        void generateFrame(SyntheticSensor& sensor, const SyntheticStream& stream, double time_ms);
+
+        ros::NodeHandle& _pnh;
+        std::string _layout;
+        std::string _serial_no;
+        rs2::software_device _dev;
+        std::vector<std::shared_ptr<SyntheticSensor>> _sensors;
+        std::vector<std::thread> _generator_threads;
+        std::atomic<bool> _is_alive;
+        std::chrono::steady_clock::time_point _start_time;
+        int _next_uid;
+    };
+}
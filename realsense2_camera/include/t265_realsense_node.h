@@ -11,8 +11,8 @@ namespace realsense2_camera
                           ros::NodeHandle& privateNodeHandle,
                           rs2::device dev,
                           const std::string& serial_no);
-            virtual void toggleSensors(bool enabled) override;
             virtual void publishTopics() override;
+            virtual bool warmRestart(rs2::device dev) override;
 
         protected:
             void calcAndPublishStaticTransform(const stream_index_pair& stream, const rs2::stream_profile& base_profile) override;
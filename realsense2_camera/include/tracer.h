@@ -0,0 +1,78 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <librealsense2/rs.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace realsense2_camera
+{
+    // Spans of the frame pipeline, of every thread of the process, for finding out what each was doing when the
+    // latency spiked. Each thread appends to a ring buffer of its own, without locks, and the oldest spans make
+    // room for the new ones. The rings are written out in the Chrome trace format, for chrome://tracing or Perfetto.
+    class Tracer
+    {
+    public:
+        static void setEnabled(bool enabled);
+        static bool isEnabled() { return _is_enabled.load(std::memory_order_relaxed); }
+
+        // name: copied, up to 31 characters. stream: a string literal or rs2_stream_to_string(), or nullptr.
+        static void record(const char* name, const char* stream, unsigned long long frame_number, int64_t start_ns, int64_t end_ns);
+
+        // Writes the spans held into path as Chrome trace JSON. Returns the number of spans written. Throws
+        // std::runtime_error.
+        static size_t dump(const std::string& path);
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        static std::atomic<bool> _is_enabled;
+    };
+
+    // Records the span of its lifetime, if tracing was enabled when it was created. Otherwise it only costs the
+    // check of the flag.
+    class TraceSpan
+    {
+    public:
+        explicit TraceSpan(const char* name, const char* stream = nullptr, unsigned long long frame_number = 0) :
+            _name(Tracer::isEnabled() ? name : nullptr),
+            _stream(stream),
+            _frame_number(frame_number),
+            _start_ns(_name ? Tracer::now() : 0)
+        {
+        }
+
+        // Tagged with the stream and number of frame.
+        TraceSpan(const char* name, const rs2::frame& frame) :
+            TraceSpan(name)
+        {
+            if (_name)
+            {
+                _stream = frame.is<rs2::frameset>() ? "Frameset" : rs2_stream_to_string(frame.get_profile().stream_type());
+                _frame_number = frame.get_frame_number();
+            }
+        }
+
+        ~TraceSpan()
+        {
+            if (_name)
+                Tracer::record(_name, _stream, _frame_number, _start_ns, Tracer::now());
+        }
+
+    private:
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        const char* _name;
+        const char* _stream;
+        unsigned long long _frame_number;
+        int64_t _start_ns;
+    };
+}
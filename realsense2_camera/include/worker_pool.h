@@ -0,0 +1,75 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace realsense2_camera
+{
+    // Fixed number of threads, each with its own task queue. Idle threads steal from the back of the others' queues.
+    // The pool itself doesn't limit the number of queued tasks - producers post through a Strand, which does.
+    class WorkerPool
+    {
+    public:
+        WorkerPool(size_t threads_num, size_t strand_queue_size);
+        ~WorkerPool();
+
+        void post(std::function<void()> task);
+        size_t size() const { return _threads.size(); }
+        size_t strandQueueSize() const { return _strand_queue_size; }
+        size_t pendingTasks() const { return _pending_tasks; }
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void run(size_t index);
+        bool popTask(size_t index, std::function<void()>& task);
+
+        std::vector<std::unique_ptr<Worker>> _workers;
+        std::vector<std::thread> _threads;
+        size_t _strand_queue_size;
+        std::atomic<size_t> _pending_tasks;
+        std::atomic<size_t> _next_worker;
+        std::atomic<bool> _is_alive;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+    };
+
+    // Runs the tasks posted to it one at a time and in order, on any thread of a WorkerPool.
+    // When the queue is full the oldest pending task is dropped, so a slow consumer always gets the newest frames.
+    // The pool must outlive the strand.
+    class Strand : public std::enable_shared_from_this<Strand>
+    {
+    public:
+        explicit Strand(WorkerPool& pool);
+
+        bool post(std::function<void()> task);     // Returns false if a pending task was dropped to make room.
+        void shutdown();                            // Drops pending tasks and waits for the running one.
+        uint64_t droppedCount() const { return _dropped; }
+
+    private:
+        void runNext();
+
+        WorkerPool& _pool;
+        size_t _max_pending;
+        std::mutex _mutex;
+        std::condition_variable _cv_idle;
+        std::deque<std::function<void()>> _pending;
+        bool _is_scheduled;
+        bool _is_running;
+        bool _is_shutdown;
+        std::atomic<uint64_t> _dropped;
+    };
+}
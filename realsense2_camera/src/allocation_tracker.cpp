@@ -0,0 +1,135 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/allocation_tracker.h"
+#include <cstdlib>
+#include <new>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // The first calls of a callback allocate its reusable buffers and messages.
+    const uint64_t WARM_UP_CALLS = 100;
+    const char* CALLBACK_NAMES[AllocationTracker::CALLBACKS_NUM] = {"Frame", "IMU", "Pose"};
+
+#ifdef TRACK_ALLOCATIONS
+    // Trivially initialized, so operator new can count before the static initialization of the thread.
+    thread_local uint64_t thread_allocations(0);
+    thread_local int untracked_depth(0);
+#endif
+}
+
+#ifdef TRACK_ALLOCATIONS
+// The library is linked with -Bsymbolic-functions, so its own calls are bound to these. Being exported, they may also
+// replace operator new and delete of the libraries that resolve them after this one.
+void* operator new(std::size_t size)
+{
+    if (0 == untracked_depth)
+        thread_allocations++;
+    void* p(std::malloc(size ? size : 1));
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    if (0 == untracked_depth)
+        thread_allocations++;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+AllocationTracker::Scope::Scope(AllocationTracker& tracker, Callback callback) :
+    _tracker(tracker),
+    _callback(callback),
+    _start_allocations(thread_allocations)
+{
+}
+
+AllocationTracker::Scope::~Scope()
+{
+    uint64_t allocations(thread_allocations - _start_allocations);
+    Counters& counters(_tracker._counters[_callback]);
+    counters.allocations += allocations;
+    if (counters.calls++ >= WARM_UP_CALLS)
+        counters.steady_state_allocations += allocations;
+}
+
+AllocationTracker::Untracked::Untracked()
+{
+    untracked_depth++;
+}
+
+AllocationTracker::Untracked::~Untracked()
+{
+    untracked_depth--;
+}
+#endif
+
+AllocationTracker::AllocationTracker()
+{
+    for (auto& counters : _counters)
+    {
+        counters.calls = 0;
+        counters.allocations = 0;
+        counters.steady_state_allocations = 0;
+    }
+}
+
+bool AllocationTracker::isEnabled()
+{
+#ifdef TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationTracker::diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    bool is_steady_state_allocating(false);
+    for (int callback = 0; callback < CALLBACKS_NUM; callback++)
+    {
+        Counters& counters(_counters[callback]);
+        uint64_t steady_state_allocations(counters.steady_state_allocations);
+        is_steady_state_allocating |= (0 != steady_state_allocations);
+        status.add(std::string(CALLBACK_NAMES[callback]) + " calls", counters.calls.load());
+        status.add(std::string(CALLBACK_NAMES[callback]) + " allocations in window", counters.allocations.exchange(0));
+        status.add(std::string(CALLBACK_NAMES[callback]) + " steady state allocations", steady_state_allocations);
+    }
+    if (is_steady_state_allocating)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "The callbacks allocate in steady state.");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "No allocations in steady state");
+}
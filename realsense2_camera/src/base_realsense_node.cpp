@@ -3,7 +3,13 @@
 #include <boost/algorithm/string.hpp>
 #include <algorithm>
 #include <cctype>
+#include <ctime>
+#include <dirent.h>
+#include <fstream>
+#include <future>
+#include <limits>
 #include <mutex>
+#include <unistd.h>
 
 #include <dynamic_reconfigure/IntParameter.h>
 #include <dynamic_reconfigure/Reconfigure.h>
@@ -19,57 +25,124 @@ using namespace ddynamic_reconfigure;
 #define ALIGNED_DEPTH_TO_FRAME_ID(sip) (static_cast<std::ostringstream&&>(std::ostringstream() << "camera_aligned_depth_to_" << STREAM_NAME(sip) << "_frame")).str()
 
 SyncedImuPublisher::SyncedImuPublisher(ros::Publisher imu_publisher, std::size_t waiting_list_size):
-            _publisher(imu_publisher), _pause_mode(false),
+            _publisher(imu_publisher),
+            _pending_size(0),
             _waiting_list_size(waiting_list_size)
             {}
 
 SyncedImuPublisher::~SyncedImuPublisher()
 {
-    PublishPendingMessages();
+    PublishPendingMessages(ros::TIME_MAX);
 }
 
-void SyncedImuPublisher::Publish(sensor_msgs::Imu imu_msg)
+SyncedImuPublisher::Watermark::Watermark(SyncedImuPublisher& publisher, const ros::Time& stamp) :
+    _publisher(publisher),
+    _stamp(stamp),
+    _is_held(publisher.Hold(stamp))
+{
+}
+
+SyncedImuPublisher::Watermark::~Watermark()
+{
+    if (_is_held)
+        _publisher.Release(_stamp);
+}
+
+ros::Time SyncedImuPublisher::LowestWatermark() const
+{
+    return _watermarks.empty() ? ros::TIME_MAX : *std::min_element(_watermarks.begin(), _watermarks.end());
+}
+
+void SyncedImuPublisher::Publish(const sensor_msgs::Imu& imu_msg)
 {
     std::lock_guard<std::mutex> lock_guard(_mutex);
-    if (_pause_mode)
+    // Behind the pending messages, which are stamped earlier, even if the watermark went down meanwhile.
+    if (_pending_size > 0 || imu_msg.header.stamp >= LowestWatermark())
     {
-        if (_pending_messages.size() >= _waiting_list_size)
+        if (_pending_size >= _waiting_list_size)
         {
-            throw std::runtime_error("SyncedImuPublisher inner list reached maximum size of " + std::to_string(_pending_messages.size()));
+            throw std::runtime_error("SyncedImuPublisher inner list reached maximum size of " + std::to_string(_pending_size));
         }
-        _pending_messages.push(imu_msg);
+        // Assigned over a message sent before, the frame_id reuses its buffer.
+        if (_pending_size < _pending_messages.size())
+            _pending_messages[_pending_size] = imu_msg;
+        else
+            _pending_messages.push_back(imu_msg);
+        _pending_size++;
     }
     else
     {
+        AllocationTracker::Untracked untracked;
         _publisher.publish(imu_msg);
         // ROS_INFO_STREAM("iid1:" << imu_msg.header.seq << ", time: " << std::setprecision (20) << imu_msg.header.stamp.toSec());
     }
     return;
 }
 
-void SyncedImuPublisher::Pause()
+bool SyncedImuPublisher::Hold(const ros::Time& stamp)
 {
-    if (!_is_enabled) return;
+    if (!_is_enabled) return false;
     std::lock_guard<std::mutex> lock_guard(_mutex);
-    _pause_mode = true;
+    _watermarks.push_back(stamp);
+    return true;
 }
 
-void SyncedImuPublisher::Resume()
+void SyncedImuPublisher::Release(const ros::Time& stamp)
 {
+    TraceSpan span("SyncedImuPublisher::Release");
     std::lock_guard<std::mutex> lock_guard(_mutex);
-    PublishPendingMessages();
-    _pause_mode = false;
+    auto watermark = std::find(_watermarks.begin(), _watermarks.end(), stamp);
+    if (watermark != _watermarks.end())
+    {
+        *watermark = _watermarks.back();
+        _watermarks.pop_back();
+    }
+    PublishPendingMessages(LowestWatermark());
 }
 
-void SyncedImuPublisher::PublishPendingMessages()
+// Called with _mutex locked. Publishes the pending messages stamped before the watermark, in the order they came.
+void SyncedImuPublisher::PublishPendingMessages(const ros::Time& watermark)
 {
-    // ROS_INFO_STREAM("publish imu: " << _pending_messages.size());
-    while (!_pending_messages.empty())
+    AllocationTracker::Untracked untracked;
+    std::size_t published(0);
+    for (; published < _pending_size && _pending_messages[published].header.stamp < watermark; published++)
     {
-        const sensor_msgs::Imu &imu_msg = _pending_messages.front();
-        _publisher.publish(imu_msg);
-        // ROS_INFO_STREAM("iid2:" << imu_msg.header.seq << ", time: " << std::setprecision (20) << imu_msg.header.stamp.toSec());
-        _pending_messages.pop();
+        _publisher.publish(_pending_messages[published]);
+    }
+    // The messages still held move to the front. Rotated rather than moved, so that every element keeps its buffers.
+    std::rotate(_pending_messages.begin(), _pending_messages.begin() + published, _pending_messages.begin() + _pending_size);
+    _pending_size -= published;
+}
+
+void OptionsHandle::set_option(rs2_option option, float value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _options.set_option(option, value);
+    _values.erase(std::remove_if(_values.begin(), _values.end(), [option](const std::pair<rs2_option, float>& v){ return v.first == option; }),
+                  _values.end());
+    _values.push_back({option, value});
+}
+
+rs2::options OptionsHandle::get() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _options;
+}
+
+void OptionsHandle::rebind(rs2::options options)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _options = options;
+    for (auto& value : _values)
+    {
+        try
+        {
+            _options.set_option(value.first, value.second);
+        }
+        catch(const std::exception& e)
+        {
+            ROS_WARN_STREAM("Failed to restore option " << rs2_option_to_string(value.first) << ": " << e.what());
+        }
     }
 }
 
@@ -80,14 +153,127 @@ std::string BaseRealSenseNode::getNamespaceStr()
     return ns;
 }
 
+namespace
+{
+    // One broadcaster per process: /tf_static is latched, so the broadcasters of nodes sharing a process
+    // (nodelets in one manager) would overwrite each other's transforms for late subscribers.
+    std::shared_ptr<tf2_ros::StaticTransformBroadcaster> getStaticTransformBroadcaster()
+    {
+        static std::mutex mutex;
+        static std::weak_ptr<tf2_ros::StaticTransformBroadcaster> instance;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<tf2_ros::StaticTransformBroadcaster> broadcaster(instance.lock());
+        if (!broadcaster)
+        {
+            broadcaster = std::make_shared<tf2_ros::StaticTransformBroadcaster>();
+            instance = broadcaster;
+        }
+        return broadcaster;
+    }
+
+    std::mutex static_tf_mutex;
+
+    // Streams have at most 3 indices (infra1/infra2, fisheye1/fisheye2).
+    const size_t STREAM_INDEX_COUNT = 3;
+
+    size_t streamSlot(const stream_index_pair& stream)
+    {
+        return stream.first * STREAM_INDEX_COUNT + stream.second;
+    }
+
+    // <record_dir>/<name>_<local time>, e.g. ~/.ros/realsense2_camera/recordings/012345678901_20210301_120000.
+    std::string recordingDirectory(const std::string& record_dir, const std::string& name)
+    {
+        std::time_t now(std::time(nullptr));
+        char start_time[32];
+        std::strftime(start_time, sizeof(start_time), "%Y%m%d_%H%M%S", std::localtime(&now));
+        return record_dir + "/" + name + "_" + start_time;
+    }
+
+    void countPublished(StreamContext& context, size_t bytes)
+    {
+        if (!context.published_messages)
+            return;
+        context.published_messages->add();
+        context.published_bytes->add(bytes);
+    }
+
+    // The CPU time of every thread of the process, from /proc/self/task/<tid>/stat.
+    void collectThreadCpu(MetricsRegistry::Samples& samples)
+    {
+        static const double CLOCK_TICKS_PER_SEC(sysconf(_SC_CLK_TCK));
+        DIR* tasks(opendir("/proc/self/task"));
+        if (!tasks)
+            return;
+        while (dirent* task = readdir(tasks))
+        {
+            if ('.' == task->d_name[0])
+                continue;
+            std::ifstream stat_file(std::string("/proc/self/task/") + task->d_name + "/stat");
+            std::string stat;
+            std::getline(stat_file, stat);
+            // pid (comm) state ppid ... utime stime, the 14th and 15th fields. comm may hold spaces and parentheses.
+            size_t comm_begin(stat.find('(')), comm_end(stat.rfind(')'));
+            if (comm_begin == std::string::npos || comm_end == std::string::npos || comm_end < comm_begin)
+                continue;
+            std::istringstream fields(stat.substr(comm_end + 2));
+            std::string field;
+            unsigned long long utime(0), stime(0);
+            for (int field_number = 3; field_number < 14; field_number++)
+                fields >> field;
+            if (!(fields >> utime >> stime))
+                continue;
+            std::string comm(stat.substr(comm_begin + 1, comm_end - comm_begin - 1));
+            comm.erase(std::remove_if(comm.begin(), comm.end(), [](char c){ return c == '"' || c == '\\'; }), comm.end());
+            samples.push_back({"tid=\"" + std::string(task->d_name) + "\",thread=\"" + comm + "\"", (utime + stime) / CLOCK_TICKS_PER_SEC});
+        }
+        closedir(tasks);
+    }
+
+    // Shared memory objects of a topic start with e.g. /realsense2_camera_camera_depth_image_rect_raw_shm_, followed
+    // by the process id and the frame size. The process id tells the rings of a restarted node apart from the stale
+    // ones still mapped by the readers, and the ones a crashed node left behind from the ones of a live node.
+    std::string shmSegmentPrefix(const std::string& topic)
+    {
+        std::string name("realsense2_camera" + topic + "_");
+        std::replace(name.begin(), name.end(), '/', '_');
+        return "/" + name;
+    }
+
+    std::string shmSegmentName(const std::string& topic)
+    {
+        std::string prefix(shmSegmentPrefix(topic));
+        size_t count(ShmRingWriter::unlinkStale(prefix));
+        if (count > 0)
+            ROS_INFO_STREAM("Removed " << count << " shared memory segments of " << topic << " left by exited processes.");
+        return prefix + std::to_string(getpid());
+    }
+}
+
 BaseRealSenseNode::BaseRealSenseNode(ros::NodeHandle& nodeHandle,
                                      ros::NodeHandle& privateNodeHandle,
                                      rs2::device dev,
-                                     const std::string& serial_no) :
+                                     const std::string& serial_no,
+                                     std::shared_ptr<WorkerPool> worker_pool) :
     _is_running(true), _base_frame_id(""),  _node_handle(nodeHandle),
-    _pnh(privateNodeHandle), _dev(dev), _json_file_path(""),
+    _pnh(privateNodeHandle), _dev(dev),
+    _is_restart_pending(false),
+    _json_file_path(""),
     _serial_no(serial_no),
+    _static_tf_broadcaster(getStaticTransformBroadcaster()),
     _is_initialized_time_base(false),
+    _is_first_frame_published(false),
+    _is_paused(false),
+    _is_streaming(false),
+    _worker_pool(worker_pool),
+    _perf_counters(_metrics),
+    _clip_depth_perf(nullptr),
+    _fix_depth_scale_perf(nullptr),
+    _pointcloud_perf(nullptr),
+    _syncer(_metrics),
+    _next_jpeg_strand(0),
+    _topic_demand(DEMAND_ALL),
+    _is_lazy_stopped(false),
     _namespace(getNamespaceStr())
 {
     // Types for depth stream
@@ -149,70 +335,222 @@ BaseRealSenseNode::~BaseRealSenseNode()
     {
         _monitoring_t->join();
     }
-
-    std::set<std::string> module_names;
-    for (const std::pair<stream_index_pair, std::vector<rs2::stream_profile>>& profile : _enabled_profiles)
     {
-        try
-        {
-            std::string module_name = _sensors[profile.first].get_info(RS2_CAMERA_INFO_NAME);
-            std::pair< std::set<std::string>::iterator, bool> res = module_names.insert(module_name);
-            if (res.second)
-            {
-                _sensors[profile.first].stop();
-                _sensors[profile.first].close();
-            }
-        }
-        catch (const rs2::error& e)
+        std::lock_guard<std::mutex> thread_lock(_restart_thread_mutex);
+        if (_restart_t && _restart_t->joinable())
         {
-            ROS_ERROR_STREAM("Exception: " << e.what());
+            _restart_t->join();
         }
     }
+    _cv_metrics.notify_one();
+    if (_metrics_t && _metrics_t->joinable())
+    {
+        _metrics_t->join();
+    }
+    _metrics_endpoint.reset();
+
+    stopSensors();
+    _syncer.stop();
+    if (_raw_recorder)
+    {
+        _raw_recorder->stop();
+    }
+
+    for (auto& strand : _strands)
+    {
+        strand->shutdown();
+    }
 }
 
 void BaseRealSenseNode::toggleSensors(bool enabled)
 {
+  std::lock_guard<std::mutex> lock(_restart_mutex);
+  _is_lazy_stopped = false;
   if(enabled)
   {
-    std::map<std::string, std::vector<rs2::stream_profile> > profiles;
-    std::map<std::string, rs2::sensor> active_sensors;
-    for (const std::pair<stream_index_pair, std::vector<rs2::stream_profile>>& profile : _enabled_profiles)
+    _is_paused = false;
+    if (!_is_streaming)
+      startSensors();
+  }
+  else if (_is_streaming)
+  {
+    stopSensors();
+  }
+}
+
+void BaseRealSenseNode::pauseSensors(bool paused)
+{
+  // The sensors keep streaming, so resuming is immediate. Use toggleSensors() to release the USB bandwidth and power.
+  _is_paused = paused;
+}
+
+bool BaseRealSenseNode::setRecording(bool enabled, std::string& message)
+{
+  if (!enabled)
+  {
+    _raw_recorder->stop();
+    return true;
+  }
+  std::string directory(recordingDirectory(_record_dir, _serial_no));
+  try
+  {
+    _raw_recorder->start(directory);
+  }
+  catch(const std::runtime_error& ex)
+  {
+    ROS_ERROR_STREAM("Failed to start recording: " << ex.what());
+    message = ex.what();
+    return false;
+  }
+  message = directory;
+  return true;
+}
+
+void BaseRealSenseNode::setupFlightRecorder()
+{
+    if (!_flight_recorder)
+        return;
+    _dump_flight_recorder_srv = _node_handle.advertiseService("dump_flight_recorder", &BaseRealSenseNode::dumpFlightRecorderCallback, this);
+    _flight_recorder_trigger_sub = _node_handle.subscribe("flight_recorder/trigger", 1, &BaseRealSenseNode::flightRecorderTriggerCallback, this);
+}
+
+void BaseRealSenseNode::setupTracing()
+{
+    _enable_tracing_srv = _node_handle.advertiseService("enable_tracing", &BaseRealSenseNode::enableTracingCallback, this);
+    _dump_trace_srv = _node_handle.advertiseService("dump_trace", &BaseRealSenseNode::dumpTraceCallback, this);
+}
+
+bool BaseRealSenseNode::enableTracingCallback(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res)
+{
+    // The tracer is shared by all the nodes of the process.
+    Tracer::setEnabled(req.data);
+    res.success = true;
+    return true;
+}
+
+bool BaseRealSenseNode::dumpTraceCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
+{
+    std::string path(recordingDirectory(_record_dir, "trace_" + _serial_no) + ".json");
+    try
     {
-        std::string module_name = _sensors[profile.first].get_info(RS2_CAMERA_INFO_NAME);
-        ROS_INFO_STREAM("insert " << rs2_stream_to_string(profile.second.begin()->stream_type())
-          << " to " << module_name);
-        profiles[module_name].insert(profiles[module_name].begin(),
-                                        profile.second.begin(),
-                                        profile.second.end());
-        active_sensors[module_name] = _sensors[profile.first];
+        createRecordingDirectory(_record_dir);
+        size_t spans(Tracer::dump(path));
+        ROS_INFO_STREAM("Dumped " << spans << " trace spans into " << path);
+    }
+    catch(const std::runtime_error& ex)
+    {
+        ROS_ERROR_STREAM("Failed to dump the trace: " << ex.what());
+        res.success = false;
+        res.message = ex.what();
+        return true;
     }
+    res.success = true;
+    res.message = path;
+    return true;
+}
 
-    for (const std::pair<std::string, std::vector<rs2::stream_profile> >& sensor_profile : profiles)
+bool BaseRealSenseNode::dumpFlightRecorder(std::string& message)
+{
+    std::string directory(recordingDirectory(_record_dir, "flight_" + _serial_no));
+    try
     {
-        std::string module_name = sensor_profile.first;
-        rs2::sensor sensor = active_sensors[module_name];
-        sensor.open(sensor_profile.second);
-        sensor.start(_sensors_callback[module_name]);
-        if (sensor.is<rs2::depth_sensor>())
-        {
-            _depth_scale_meters = sensor.as<rs2::depth_sensor>().get_depth_scale();
-        }
+        size_t frames(_flight_recorder->dump(directory));
+        ROS_INFO_STREAM("Dumped the flight recorder, " << frames << " frames, into " << directory);
     }
-  }
-  else
-  {
-    std::set<std::string> module_names;
-    for (const std::pair<stream_index_pair, std::vector<rs2::stream_profile>>& profile : _enabled_profiles)
+    catch(const std::runtime_error& ex)
     {
-        std::string module_name = _sensors[profile.first].get_info(RS2_CAMERA_INFO_NAME);
-        std::pair< std::set<std::string>::iterator, bool> res = module_names.insert(module_name);
-        if (res.second)
+        ROS_ERROR_STREAM("Failed to dump the flight recorder: " << ex.what());
+        message = ex.what();
+        return false;
+    }
+    message = directory;
+    return true;
+}
+
+bool BaseRealSenseNode::dumpFlightRecorderCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
+{
+    res.success = dumpFlightRecorder(res.message);
+    return true;
+}
+
+void BaseRealSenseNode::flightRecorderTriggerCallback(const std_msgs::Empty::ConstPtr& msg)
+{
+    std::string message;
+    dumpFlightRecorder(message);
+}
+
+// Counting the subscribers takes a lookup per publisher, so the frame threads read the demand the monitoring thread
+// stores once a second rather than computing it per frameset.
+unsigned int BaseRealSenseNode::updateTopicDemand()
+{
+    auto has_subscribers = [](const ImagePublisherWithFrequencyDiagnostics& image_publisher, const ros::Publisher& info_publisher)
+    {
+        return 0 != image_publisher.first.getNumSubscribers() || 0 != info_publisher.getNumSubscribers();
+    };
+    // The compressed and shm topics are optional.
+    auto has_optional_subscribers = [](const std::map<stream_index_pair, ros::Publisher>& publishers, const stream_index_pair& stream)
+    {
+        auto publisher = publishers.find(stream);
+        return publisher != publishers.end() && 0 != publisher->second.getNumSubscribers();
+    };
+    unsigned int demand(0);
+    for (auto& image_publisher : _image_publishers)
+    {
+        const stream_index_pair& stream(image_publisher.first);
+        if (has_subscribers(image_publisher.second, _info_publisher[stream]) ||
+            has_optional_subscribers(_compressed_publisher, stream) ||
+            has_optional_subscribers(_shm_publisher, stream))
+            demand |= (stream == DEPTH ? DEMAND_DEPTH : DEMAND_IMAGES);
+    }
+    for (auto& image_publisher : _depth_aligned_image_publishers)
+    {
+        const stream_index_pair& stream(image_publisher.first);
+        if (has_subscribers(image_publisher.second, _depth_aligned_info_publisher[stream]) ||
+            has_optional_subscribers(_depth_aligned_shm_publisher, stream))
+            demand |= DEMAND_ALIGNED;
+    }
+    if (_pointcloud && 0 != _pointcloud_publisher.getNumSubscribers())
+        demand |= DEMAND_POINTS;
+    _topic_demand = demand;
+    return demand;
+}
+
+bool BaseRealSenseNode::hasSubscribers()
+{
+    // The odometry TF is always published, so the pose stream counts as listened to.
+    if (0 != updateTopicDemand() || 0 != _synced_imu_publisher->getNumSubscribers() || (_enable[POSE] && _publish_odom_tf))
+        return true;
+    for (auto& imu_publisher : _imu_publishers)
+    {
+        if (0 != imu_publisher.second.getNumSubscribers())
+            return true;
+    }
+    return false;
+}
+
+void BaseRealSenseNode::updateLazyStreaming()
+{
+    bool has_subscribers(hasSubscribers());
+    std::lock_guard<std::mutex> lock(_restart_mutex);
+    try
+    {
+        if (!has_subscribers && _is_streaming)
         {
-            _sensors[profile.first].stop();
-            _sensors[profile.first].close();
+            ROS_INFO_STREAM("No subscribers left. Stopping the sensors.");
+            stopSensors();
+            _is_lazy_stopped = true;
+        }
+        else if (has_subscribers && _is_lazy_stopped)
+        {
+            ROS_INFO_STREAM("Topics subscribed. Starting the sensors.");
+            _is_lazy_stopped = false;
+            startSensors();
         }
     }
-  }
+    catch(const std::exception& ex)
+    {
+        ROS_ERROR_STREAM("Failed to toggle the sensors on demand: " << ex.what());
+    }
 }
 
 void BaseRealSenseNode::setupErrorCallback()
@@ -221,17 +559,46 @@ void BaseRealSenseNode::setupErrorCallback()
     {
         s.set_notifications_callback([&](const rs2::notification& n)
         {
-            std::vector<std::string> error_strings({"RT IC2 Config error",
-                                                    "Left IC2 Config error"});
+            static const char* error_strings[] = {"RT IC2 Config error",
+                                                  "Left IC2 Config error"};
+            const std::string description(n.get_description());
             if (n.get_severity() >= RS2_LOG_SEVERITY_ERROR)
             {
-                ROS_WARN_STREAM("Hardware Notification:" << n.get_description() << "," << n.get_timestamp() << "," << n.get_severity() << "," << n.get_category());
+                ROS_WARN_STREAM("Hardware Notification:" << description << "," << n.get_timestamp() << "," << n.get_severity() << "," << n.get_category());
             }
-            if (error_strings.end() != find_if(error_strings.begin(), error_strings.end(), [&n] (std::string err) 
-                                        {return (n.get_description().find(err) != std::string::npos); }))
+            if (std::end(error_strings) != std::find_if(std::begin(error_strings), std::end(error_strings), [&description] (const char* err)
+                                        {return (description.find(err) != std::string::npos); }))
             {
-                ROS_ERROR_STREAM("Performing Hardware Reset.");
-                _dev.hardware_reset();
+                std::unique_lock<std::mutex> lock(_restart_mutex, std::try_to_lock);
+                if (!lock.owns_lock())
+                    return;     // A restart is already in progress.
+                // First try to restart the sensors. If the error comes back right after that, reset the hardware.
+                // The factory then re-attaches the node to the re-enumerated device.
+                if (std::chrono::steady_clock::now() - _last_restart_time < std::chrono::seconds(5))
+                {
+                    ROS_ERROR_STREAM("Performing Hardware Reset.");
+                    _dev.hardware_reset();
+                    return;
+                }
+                // The other sensors may report the error at the same time. Only one of them starts the restart.
+                if (_is_restart_pending.exchange(true))
+                    return;
+                lock.unlock();
+                // Sensors can't be stopped from their own notification thread. The previous restart thread has
+                // ended, or is about to.
+                std::lock_guard<std::mutex> thread_lock(_restart_thread_mutex);
+                if (_restart_t && _restart_t->joinable())
+                    _restart_t->join();
+                ROS_ERROR_STREAM("Performing warm restart.");
+                _restart_t = std::make_shared<std::thread>([this]()
+                {
+                    if (!warmRestart(_dev))
+                    {
+                        ROS_ERROR_STREAM("Warm restart failed. Performing Hardware Reset.");
+                        _dev.hardware_reset();
+                    }
+                    _is_restart_pending = false;
+                });
             }
         });
     }
@@ -239,20 +606,56 @@ void BaseRealSenseNode::setupErrorCallback()
 
 void BaseRealSenseNode::publishTopics()
 {
+    std::stringstream timing;
+    auto start_time = std::chrono::steady_clock::now();
+    auto phase_start_time = start_time;
+    auto end_phase = [&](const char* phase_name)
+    {
+        auto now = std::chrono::steady_clock::now();
+        timing << " " << phase_name << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(now - phase_start_time).count() << ",";
+        phase_start_time = now;
+    };
+
     getParameters();
+    if (_use_metadata_cache)
+    {
+        _metadata_cache = std::make_shared<DeviceMetadataCache>(_metadata_cache_dir, _dev);
+    }
+    end_phase("getParameters");
     setupDevice();
+    end_phase("setupDevice");
     setupFilters();
     registerHDRoptions();
-    registerDynamicReconfigCb(_node_handle);
+    end_phase("setupFilters");
+    // Reading and setting the options doesn't touch the state used to select the profiles and advertise the topics.
+    auto dynamic_reconfig_result = std::async(_parallel_startup ? std::launch::async : std::launch::deferred,
+                                              [this](){ registerDynamicReconfigCb(_node_handle); });
     setupErrorCallback();
     enable_devices();
     setupPublishers();
+    setupFlightRecorder();
+    setupTracing();
+    setupStreamContexts();
+    end_phase("setupPublishers");
+    // Options must be applied before streaming starts.
+    dynamic_reconfig_result.get();
+    end_phase("registerDynamicReconfigCb");
     setupStreams();
+    end_phase("setupStreams");
     SetBaseStream();
     registerAutoExposureROIOptions(_node_handle);
     publishStaticTransforms();
     publishIntrinsics();
+    end_phase("publishStaticTransforms");
     startMonitoring();
+    setupMetrics();
+    if (_metadata_cache)
+    {
+        _metadata_cache->save();
+    }
+    end_phase("startMonitoring");
+    ROS_INFO_STREAM("Startup timing [ms]:" << timing.str() << " total: "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
     ROS_INFO_STREAM("RealSense Node Is Up!");
 }
 
@@ -301,12 +704,6 @@ bool is_enum_option(rs2::options sensor, rs2_option option)
     return false;
 }
 
-bool is_int_option(rs2::options sensor, rs2_option option)
-{
-    rs2::option_range op_range = sensor.get_option_range(option);
-    return (op_range.step == 1.0);
-}
-
 std::map<std::string, int> get_enum_method(rs2::options sensor, rs2_option option)
 {
     std::map<std::string, int> dict; // An enum to set size
@@ -365,6 +762,144 @@ std::string create_graph_resource_name(const std::string &original_name)
   return fixed_name;
 }
 
+bool BaseRealSenseNode::warmRestart(rs2::device dev)
+{
+    std::lock_guard<std::mutex> lock(_restart_mutex);
+    auto start_time = std::chrono::steady_clock::now();
+    _last_restart_time = start_time;
+    try
+    {
+        // The re-enumerated device starts its hardware clock over.
+        _is_initialized_time_base = false;
+        // Sensors that were stopped through the enable service stay stopped.
+        bool was_streaming(_is_streaming);
+        stopSensors();
+        if (dev.get() != _dev.get())
+        {
+            rebindDevice(dev);
+        }
+        _is_first_frame_published = false;
+        if (was_streaming)
+            startSensors();
+    }
+    catch(const std::exception& ex)
+    {
+        ROS_ERROR_STREAM("Warm restart failed: " << ex.what());
+        return false;
+    }
+    ROS_INFO_STREAM("Warm restart done in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count() << " ms.");
+    return true;
+}
+
+void BaseRealSenseNode::stopSensors()
+{
+    _is_streaming = false;
+    std::set<std::string> module_names;
+    for (const std::pair<stream_index_pair, std::vector<rs2::stream_profile>>& profile : _enabled_profiles)
+    {
+        try
+        {
+            std::string module_name = _sensors[profile.first].get_info(RS2_CAMERA_INFO_NAME);
+            std::pair< std::set<std::string>::iterator, bool> res = module_names.insert(module_name);
+            if (res.second)
+            {
+                _sensors[profile.first].stop();
+                _sensors[profile.first].close();
+            }
+        }
+        catch (const rs2::error& e)
+        {
+            ROS_WARN_STREAM("Exception: " << e.what());
+        }
+    }
+}
+
+void BaseRealSenseNode::rebindDevice(rs2::device dev)
+{
+    std::string serial_no(dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
+    if (serial_no != _serial_no)
+        throw std::runtime_error("Device " + serial_no + " is not the device this node was set up for (" + _serial_no + ").");
+
+    // Match the sensors and the enabled profiles by name and configuration. Publishers, calibration and TFs stay as they are.
+    std::vector<rs2::sensor> dev_sensors = dev.query_sensors();
+    auto find_sensor = [&dev_sensors](const std::string& name)
+    {
+        auto it = std::find_if(dev_sensors.begin(), dev_sensors.end(), [&name](const rs2::sensor& sensor)
+                               { return name == sensor.get_info(RS2_CAMERA_INFO_NAME); });
+        if (it == dev_sensors.end())
+            throw std::runtime_error("Sensor " + name + " is missing from the re-enumerated device.");
+        return *it;
+    };
+    std::map<stream_index_pair, rs2::sensor> sensors;
+    for (auto& sensor : _sensors)
+    {
+        sensors[sensor.first] = find_sensor(sensor.second.get_info(RS2_CAMERA_INFO_NAME));
+    }
+    std::map<stream_index_pair, std::vector<rs2::stream_profile>> enabled_profiles;
+    for (auto& profiles : _enabled_profiles)
+    {
+        auto sensor_profiles = sensors[profiles.first].get_stream_profiles();
+        for (auto& profile : profiles.second)
+        {
+            auto it = std::find_if(sensor_profiles.begin(), sensor_profiles.end(), [&profile](const rs2::stream_profile& candidate)
+            {
+                if (candidate.stream_type() != profile.stream_type() || candidate.stream_index() != profile.stream_index() ||
+                    candidate.format() != profile.format() || candidate.fps() != profile.fps())
+                    return false;
+                if (!profile.is<rs2::video_stream_profile>())
+                    return true;
+                auto video_profile = profile.as<rs2::video_stream_profile>();
+                auto video_candidate = candidate.as<rs2::video_stream_profile>();
+                return video_candidate.width() == video_profile.width() && video_candidate.height() == video_profile.height();
+            });
+            if (it == sensor_profiles.end())
+                throw std::runtime_error("Profile of stream " + STREAM_NAME(profiles.first) + " is missing from the re-enumerated device.");
+            enabled_profiles[profiles.first].push_back(*it);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_sensors_mutex);
+        _dev = dev;
+        _dev_sensors = dev_sensors;
+        _sensors = sensors;
+        _enabled_profiles = enabled_profiles;
+    }
+
+    // The reset device is back to its defaults. Apply the JSON file and the options set so far again.
+    loadJsonFile();
+    for (auto& sensor : _dev_sensors)
+    {
+        auto handle = _options_handles.find(create_graph_resource_name(sensor.get_info(RS2_CAMERA_INFO_NAME)));
+        if (handle != _options_handles.end())
+            handle->second->rebind(sensor);
+    }
+    for (auto& auto_exposure_roi : _auto_exposure_roi)
+    {
+        rs2::sensor sensor = getSensor(auto_exposure_roi.first);
+        for (auto& profile : _enabled_profiles)
+        {
+            if (_sensors[profile.first].get_info(RS2_CAMERA_INFO_NAME) != auto_exposure_roi.first)
+                continue;
+            rs2_stream stream_type = profile.first.first;
+            _video_functions_stack[stream_type].push_back([this, sensor](){set_sensor_auto_exposure_roi(sensor);});
+            _is_first_frame[stream_type] = true;
+            break;
+        }
+    }
+    setupErrorCallback();
+}
+
+rs2::sensor BaseRealSenseNode::getSensor(const std::string& module_base_name)
+{
+    std::lock_guard<std::mutex> lock(_sensors_mutex);
+    auto it = std::find_if(_dev_sensors.begin(), _dev_sensors.end(), [&module_base_name](const rs2::sensor& sensor)
+                           { return module_base_name == sensor.get_info(RS2_CAMERA_INFO_NAME); });
+    if (it == _dev_sensors.end())
+        throw std::runtime_error("Unknown sensor: " + module_base_name);
+    return *it;
+}
+
 void BaseRealSenseNode::set_auto_exposure_roi(const std::string option_name, rs2::sensor sensor, int new_value)
 {
     rs2::region_of_interest& auto_exposure_roi(_auto_exposure_roi[sensor.get_info(RS2_CAMERA_INFO_NAME)]);
@@ -405,8 +940,10 @@ void BaseRealSenseNode::readAndSetDynamicParam(ros::NodeHandle& nh1, std::shared
     if (*option_value < min_val) *option_value = min_val;
     if (*option_value > max_val) *option_value = max_val;
     
+    // Look the sensor up on every change, it is replaced by a warm restart.
+    std::string module_base_name(sensor.get_info(RS2_CAMERA_INFO_NAME));
     ddynrec->registerVariable<int>(
-        option_name, *option_value, [this, sensor, option_name](int new_value){set_auto_exposure_roi(option_name, sensor, new_value);},
+        option_name, *option_value, [this, module_base_name, option_name](int new_value){set_auto_exposure_roi(option_name, getSensor(module_base_name), new_value);},
         "auto-exposure " + option_name + " coordinate", min_val, max_val);
 }
 
@@ -443,37 +980,91 @@ void BaseRealSenseNode::registerAutoExposureROIOptions(ros::NodeHandle& nh)
     }
 }
 
-void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options sensor, std::string& module_name)
+std::vector<OptionMetadata> BaseRealSenseNode::getOptionsMetadata(rs2::options sensor, const std::string& module_name)
 {
-    ros::NodeHandle nh1(nh, module_name);
-    std::shared_ptr<ddynamic_reconfigure::DDynamicReconfigure> ddynrec = std::make_shared<ddynamic_reconfigure::DDynamicReconfigure>(nh1);
+    std::vector<OptionMetadata> options;
+    if (_metadata_cache && _metadata_cache->getOptions(module_name, options))
+        return options;
+
     for (auto i = 0; i < RS2_OPTION_COUNT; i++)
     {
         rs2_option option = static_cast<rs2_option>(i);
-        const std::string option_name(create_graph_resource_name(rs2_option_to_string(option)));
         try
         {
             if (!sensor.supports(option) || sensor.is_option_read_only(option))
             {
                 continue;
             }
-            if (is_checkbox(sensor, option))
+            OptionMetadata meta;
+            meta.option = option;
+            meta.range = sensor.get_option_range(option);
+            meta.is_checkbox = is_checkbox(sensor, option);
+            meta.description = sensor.get_option_description(option);
+            if (!meta.is_checkbox)
+                meta.enum_dict = get_enum_method(sensor, option);
+            options.push_back(meta);
+        }
+        catch(const std::exception& e)
+        {
+            ROS_WARN_STREAM("Failed to query option: " << rs2_option_to_string(option) << ": " << e.what());
+        }
+    }
+    if (_metadata_cache)
+        _metadata_cache->setOptions(module_name, options);
+    return options;
+}
+
+rs2_intrinsics BaseRealSenseNode::getIntrinsics(const rs2::video_stream_profile& profile)
+{
+    rs2_intrinsics intrinsics;
+    if (_metadata_cache && _metadata_cache->getIntrinsics(profile, intrinsics))
+        return intrinsics;
+    intrinsics = profile.get_intrinsics();
+    if (_metadata_cache)
+        _metadata_cache->setIntrinsics(profile, intrinsics);
+    return intrinsics;
+}
+
+rs2_extrinsics BaseRealSenseNode::getExtrinsics(const rs2::stream_profile& from, const rs2::stream_profile& to)
+{
+    rs2_extrinsics extrinsics;
+    if (_metadata_cache && _metadata_cache->getExtrinsics(from, to, extrinsics))
+        return extrinsics;
+    extrinsics = from.get_extrinsics_to(to);
+    if (_metadata_cache)
+        _metadata_cache->setExtrinsics(from, to, extrinsics);
+    return extrinsics;
+}
+
+void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options sensor, std::string& module_name)
+{
+    ros::NodeHandle nh1(nh, module_name);
+    std::shared_ptr<ddynamic_reconfigure::DDynamicReconfigure> ddynrec = std::make_shared<ddynamic_reconfigure::DDynamicReconfigure>(nh1);
+    std::shared_ptr<OptionsHandle> options_handle = std::make_shared<OptionsHandle>(sensor);
+    for (auto& meta : getOptionsMetadata(sensor, module_name))
+    {
+        rs2_option option = meta.option;
+        auto i = static_cast<int>(option);
+        const std::string option_name(create_graph_resource_name(rs2_option_to_string(option)));
+        try
+        {
+            if (meta.is_checkbox)
             {
                 auto option_value = bool(sensor.get_option(option));
                 if (nh1.param(option_name, option_value, option_value))
                 {
-                    sensor.set_option(option, option_value);
+                    options_handle->set_option(option, option_value);
                 }
                 ddynrec->registerVariable<bool>(
                 option_name, option_value,
-                [option, sensor](bool new_value) { sensor.set_option(option, new_value); },
-                sensor.get_option_description(option));
+                [option, options_handle](bool new_value) { options_handle->set_option(option, new_value); },
+                meta.description);
                 continue;
             }
-            const auto enum_dict = get_enum_method(sensor, option);
+            const auto& enum_dict = meta.enum_dict;
             if (enum_dict.empty())
             {
-                rs2::option_range op_range = sensor.get_option_range(option);
+                rs2::option_range op_range = meta.range;
                 const auto sensor_option_value = sensor.get_option(option);
                 auto option_value = sensor_option_value;
                 if (nh1.param(option_name, option_value, option_value))
@@ -487,7 +1078,7 @@ void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options
                     }
                     else
                     {
-                        sensor.set_option(option, option_value);
+                        options_handle->set_option(option, option_value);
                     }
                 }
                 if (option_value < op_range.min || op_range.max < option_value)
@@ -497,12 +1088,12 @@ void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options
                                             << ". Removing this parameter from dynamic reconfigure options.");
                     continue;
                 }
-                if (is_int_option(sensor, option))
+                if (op_range.step == 1.0)
                 {
                 ddynrec->registerVariable<int>(
                     option_name, int(option_value),
-                    [option, sensor](int new_value) { sensor.set_option(option, new_value); },
-                    sensor.get_option_description(option), int(op_range.min), int(op_range.max));
+                    [option, options_handle](int new_value) { options_handle->set_option(option, new_value); },
+                    meta.description, int(op_range.min), int(op_range.max));
                 }
                 else
                 {
@@ -510,7 +1101,7 @@ void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options
                     {
                         if (ROS_DEPTH_SCALE >= op_range.min && ROS_DEPTH_SCALE <= op_range.max)
                         {
-                            sensor.set_option(option, ROS_DEPTH_SCALE);
+                            options_handle->set_option(option, ROS_DEPTH_SCALE);
                             op_range.min = ROS_DEPTH_SCALE;
                             op_range.max = ROS_DEPTH_SCALE;
 
@@ -521,8 +1112,8 @@ void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options
                     {
                     ddynrec->registerVariable<double>(
                         option_name, option_value,
-                        [option, sensor](double new_value) { sensor.set_option(option, new_value); },
-                        sensor.get_option_description(option), double(op_range.min), double(op_range.max));
+                        [option, options_handle](double new_value) { options_handle->set_option(option, new_value); },
+                        meta.description, double(op_range.min), double(op_range.max));
                     }
                 }
             }
@@ -544,7 +1135,7 @@ void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options
                     }
                     else
                     {
-                        sensor.set_option(option, option_value);
+                        options_handle->set_option(option, option_value);
                     }
                 }
                 if (std::find_if(enum_dict.cbegin(), enum_dict.cend(),
@@ -561,23 +1152,23 @@ void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options
                 {
                     ddynrec->registerEnumVariable<int>(
                         option_name, option_value,
-                        [this, option, sensor, module_name](int new_value) 
+                        [this, option, options_handle, module_name](int new_value) 
                             { 
-                                sensor.set_option(option, new_value); 
-                                _update_functions_v.push_back([this, module_name, sensor]()
-                                    {set_sensor_parameter_to_ros(module_name, sensor, RS2_OPTION_EXPOSURE);});
-                                _update_functions_v.push_back([this, module_name, sensor]()
-                                    {set_sensor_parameter_to_ros(module_name, sensor, RS2_OPTION_GAIN);});
+                                options_handle->set_option(option, new_value); 
+                                _update_functions_v.push_back([this, module_name, options_handle]()
+                                    {set_sensor_parameter_to_ros(module_name, options_handle->get(), RS2_OPTION_EXPOSURE);});
+                                _update_functions_v.push_back([this, module_name, options_handle]()
+                                    {set_sensor_parameter_to_ros(module_name, options_handle->get(), RS2_OPTION_GAIN);});
                                 _update_functions_cv.notify_one();
                             },
-                        sensor.get_option_description(option), enum_dict);
+                        meta.description, enum_dict);
                 }
                 else
                 {
                     ddynrec->registerEnumVariable<int>(
                         option_name, option_value,
-                        [option, sensor](int new_value) { sensor.set_option(option, new_value); },
-                        sensor.get_option_description(option), enum_dict);
+                        [option, options_handle](int new_value) { options_handle->set_option(option, new_value); },
+                        meta.description, enum_dict);
                 }
             }
         }
@@ -592,18 +1183,30 @@ void BaseRealSenseNode::registerDynamicOption(ros::NodeHandle& nh, rs2::options
         
     }
     ddynrec->publishServicesTopics();
+    std::lock_guard<std::mutex> lock(_ddynrec_mutex);
     _ddynrec.push_back(ddynrec);
+    _options_handles[module_name] = options_handle;
 }
 
 void BaseRealSenseNode::registerDynamicReconfigCb(ros::NodeHandle& nh)
 {
     ROS_INFO("Setting Dynamic reconfig parameters.");
 
+    // The options of each module are read over its own USB interface. Query the modules concurrently.
+    std::vector<std::future<void>> results;
     for(rs2::sensor sensor : _dev_sensors)
     {
         std::string module_name = create_graph_resource_name(sensor.get_info(RS2_CAMERA_INFO_NAME));
         ROS_DEBUG_STREAM("module_name:" << module_name);
-        registerDynamicOption(nh, sensor, module_name);
+        results.push_back(std::async(_parallel_startup ? std::launch::async : std::launch::deferred,
+                                     [this, &nh, sensor, module_name]() mutable
+                                     {
+                                         registerDynamicOption(nh, sensor, module_name);
+                                     }));
+    }
+    for (auto& result : results)
+    {
+        result.get();
     }
 
     for (NamedFilter nfilter : _filters)
@@ -744,6 +1347,18 @@ void BaseRealSenseNode::getParameters()
     _pnh.param("enable_sync", _sync_frames, SYNC_FRAMES);
     if (_pointcloud || _align_depth || _filters_str.size() > 0)
         _sync_frames = true;
+    _pnh.param("sync_tolerance_ms", _sync_settings.tolerance_ms, SYNC_TOLERANCE_MS);
+    _pnh.param("sync_deadline_ms", _sync_settings.deadline_ms, SYNC_DEADLINE_MS);
+    std::string sync_preferred_stream;
+    _pnh.param("sync_preferred_stream", sync_preferred_stream, DEFAULT_SYNC_PREFERRED_STREAM);
+    _sync_settings.preferred_stream = RS2_STREAM_ANY;
+    for (const std::pair<rs2_stream, std::string>& stream_name : _stream_name)
+    {
+        if (stream_name.second == sync_preferred_stream)
+            _sync_settings.preferred_stream = stream_name.first;
+    }
+    if (!sync_preferred_stream.empty() && RS2_STREAM_ANY == _sync_settings.preferred_stream)
+        ROS_WARN_STREAM("Unknown sync_preferred_stream: " << sync_preferred_stream << ". No stream is preferred.");
 
     _pnh.param("json_file_path", _json_file_path, std::string(""));
 
@@ -814,35 +1429,81 @@ void BaseRealSenseNode::getParameters()
     _pnh.param("angular_velocity_cov", _angular_velocity_cov, static_cast<double>(0.01));
     _pnh.param("hold_back_imu_for_frames", _hold_back_imu_for_frames, HOLD_BACK_IMU_FOR_FRAMES);
     _pnh.param("publish_odom_tf", _publish_odom_tf, PUBLISH_ODOM_TF);
-}
-
-void BaseRealSenseNode::setupDevice()
-{
-    ROS_INFO("setupDevice...");
-    try{
-        if (!_json_file_path.empty())
+    _pnh.param("use_metadata_cache", _use_metadata_cache, USE_METADATA_CACHE);
+    _pnh.param("parallel_startup", _parallel_startup, PARALLEL_STARTUP);
+    _pnh.param("lazy_streaming", _lazy_streaming, LAZY_STREAMING);
+    _pnh.param("enable_depth_rvl", _enable_depth_rvl, ENABLE_DEPTH_RVL);
+    _pnh.param("enable_color_jpeg", _enable_color_jpeg, ENABLE_COLOR_JPEG);
+    _pnh.param("color_jpeg_quality", _color_jpeg_quality, COLOR_JPEG_QUALITY);
+    _pnh.param("color_jpeg_scale", _color_jpeg_scale, COLOR_JPEG_SCALE);
+    _pnh.param("enable_shm", _enable_shm, ENABLE_SHM);
+    _pnh.param("shm_slots", _shm_slots, SHM_SLOTS);
+    _pnh.param("serialize_from_frame", _serialize_from_frame, SERIALIZE_FROM_FRAME);
+    _pnh.param("record_dir", _record_dir, std::string(""));
+    if (_record_dir.empty())
+        _record_dir = DeviceMetadataCache::defaultCacheDir() + "/recordings";
+    int record_segment_size_mb, record_max_backlog;
+    _pnh.param("record_segment_size_mb", record_segment_size_mb, RECORD_SEGMENT_SIZE_MB);
+    _pnh.param("record_max_backlog", record_max_backlog, RECORD_MAX_BACKLOG);
+    _raw_recorder = std::make_shared<RawRecorder>(static_cast<size_t>(std::max(record_segment_size_mb, 1)) * 1024 * 1024,
+                                                  std::max(record_max_backlog, 1));
+    int flight_recorder_size_mb;
+    double flight_recorder_seconds;
+    _pnh.param("flight_recorder_size_mb", flight_recorder_size_mb, FLIGHT_RECORDER_SIZE_MB);
+    _pnh.param("flight_recorder_seconds", flight_recorder_seconds, FLIGHT_RECORDER_SECONDS);
+    if (flight_recorder_size_mb > 0)
+    {
+        _flight_recorder = std::make_shared<FlightRecorder>(static_cast<size_t>(flight_recorder_size_mb) * 1024 * 1024, flight_recorder_seconds);
+    }
+    _pnh.param("metrics_rate", _metrics_rate, METRICS_RATE);
+    _pnh.param("metrics_port", _metrics_port, METRICS_PORT);
+    bool perf_counters;
+    _pnh.param("perf_counters", perf_counters, PERF_COUNTERS);
+    _perf_counters.setEnabled(perf_counters);
+    _clip_depth_perf = _perf_counters.stage("clip_depth");
+    _fix_depth_scale_perf = _perf_counters.stage("fix_depth_scale");
+    _pointcloud_perf = _perf_counters.stage("publishPointCloud");
+    bool tracing;
+    _pnh.param("tracing", tracing, TRACING);
+    if (tracing)
+    {
+        Tracer::setEnabled(true);
+    }
+    _pnh.param("metadata_cache_dir", _metadata_cache_dir, std::string(""));
+}
+
+void BaseRealSenseNode::loadJsonFile()
+{
+    if (!_json_file_path.empty())
+    {
+        if (_dev.is<rs2::serializable_device>())
         {
-            if (_dev.is<rs2::serializable_device>())
+            std::stringstream ss;
+            std::ifstream in(_json_file_path);
+            if (in.is_open())
             {
-                std::stringstream ss;
-                std::ifstream in(_json_file_path);
-                if (in.is_open())
-                {
-                    ss << in.rdbuf();
-                    std::string json_file_content = ss.str();
+                ss << in.rdbuf();
+                std::string json_file_content = ss.str();
 
-                    auto adv = _dev.as<rs2::serializable_device>();
-                    adv.load_json(json_file_content);
-                    ROS_INFO_STREAM("JSON file is loaded! (" << _json_file_path << ")");
-                }
-                else
-                    ROS_WARN_STREAM("JSON file provided doesn't exist! (" << _json_file_path << ")");
+                auto adv = _dev.as<rs2::serializable_device>();
+                adv.load_json(json_file_content);
+                ROS_INFO_STREAM("JSON file is loaded! (" << _json_file_path << ")");
             }
             else
-                ROS_WARN("Device does not support advanced settings!");
+                ROS_WARN_STREAM("JSON file provided doesn't exist! (" << _json_file_path << ")");
         }
         else
-            ROS_INFO("JSON file is not provided");
+            ROS_WARN("Device does not support advanced settings!");
+    }
+    else
+        ROS_INFO("JSON file is not provided");
+}
+
+void BaseRealSenseNode::setupDevice()
+{
+    ROS_INFO("setupDevice...");
+    try{
+        loadJsonFile();
 
         ROS_INFO_STREAM("ROS Node Namespace: " << _namespace);
 
@@ -871,12 +1532,8 @@ void BaseRealSenseNode::setupDevice()
         std::function<void(rs2::frame)> frame_callback_function, imu_callback_function;
         if (_sync_frames)
         {
-            frame_callback_function = _syncer;
-
-            auto frame_callback_inner = [this](rs2::frame frame){
-                frame_callback(frame);
-            };
-            _syncer.start(frame_callback_inner);
+            // Started by setupStreams(), once the streams are selected.
+            frame_callback_function = [this](rs2::frame frame){_syncer(frame);};
         }
         else
         {
@@ -893,6 +1550,19 @@ void BaseRealSenseNode::setupDevice()
         }
         std::function<void(rs2::frame)> multiple_message_callback_function = [this](rs2::frame frame){multiple_message_callback(frame, _imu_sync_method);};
 
+        // Without syncer, every sensor gets its own strand, keeping the concurrency of the per sensor librealsense threads.
+        auto sensor_frame_callback = [&]()
+        {
+            return _sync_frames ? frame_callback_function : processOnWorkerPool(frame_callback_function);
+        };
+
+        auto sensor_has_stream = [](const rs2::sensor& sensor, rs2_stream stream_type)
+        {
+            auto profiles = sensor.get_stream_profiles();
+            return std::any_of(profiles.begin(), profiles.end(), [stream_type](const rs2::stream_profile& profile)
+                                                                 { return profile.stream_type() == stream_type; });
+        };
+
         ROS_INFO_STREAM("Device Sensors: ");
         for(auto&& sensor : _dev_sensors)
         {
@@ -908,15 +1578,15 @@ void BaseRealSenseNode::setupDevice()
             std::string module_name = sensor.get_info(RS2_CAMERA_INFO_NAME);
             if (sensor.is<rs2::depth_sensor>())
             {
-                _sensors_callback[module_name] = frame_callback_function;
+                _sensors_callback[module_name] = sensor_frame_callback();
             }
             else if (sensor.is<rs2::color_sensor>())
             {
-                _sensors_callback[module_name] = frame_callback_function;
+                _sensors_callback[module_name] = sensor_frame_callback();
             }
             else if (sensor.is<rs2::fisheye_sensor>())
             {
-                _sensors_callback[module_name] = frame_callback_function;
+                _sensors_callback[module_name] = sensor_frame_callback();
             }
             else if (sensor.is<rs2::motion_sensor>())
             {
@@ -926,6 +1596,20 @@ void BaseRealSenseNode::setupDevice()
             {
                 _sensors_callback[module_name] = multiple_message_callback_function;
             }
+            // Software sensors (synthetic device) don't expose the typed extensions. Classify them by their streams.
+            else if (sensor_has_stream(sensor, RS2_STREAM_POSE))
+            {
+                _sensors_callback[module_name] = multiple_message_callback_function;
+            }
+            else if (sensor_has_stream(sensor, RS2_STREAM_GYRO) || sensor_has_stream(sensor, RS2_STREAM_ACCEL))
+            {
+                _sensors_callback[module_name] = imu_callback_function;
+            }
+            else if (sensor_has_stream(sensor, RS2_STREAM_COLOR) || sensor_has_stream(sensor, RS2_STREAM_INFRARED) ||
+                     sensor_has_stream(sensor, RS2_STREAM_FISHEYE))
+            {
+                _sensors_callback[module_name] = sensor_frame_callback();
+            }
             else
             {
                 ROS_ERROR_STREAM("Module Name \"" << module_name << "\" isn't supported by LibRealSense! Terminating RealSense Node...");
@@ -976,9 +1660,33 @@ void BaseRealSenseNode::setupPublishers()
             image_raw << stream_name << "/image_" << ((rectified_image)?"rect_":"") << "raw";
             camera_info << stream_name << "/camera_info";
 
-            std::shared_ptr<FrequencyDiagnostics> frequency_diagnostics(new FrequencyDiagnostics(_fps[stream], stream_name, _serial_no));
+            std::shared_ptr<StreamDiagnostics> frequency_diagnostics(new StreamDiagnostics(stream_name, _fps[stream]));
             _image_publishers[stream] = {image_transport.advertise(image_raw.str(), 1), frequency_diagnostics};
             _info_publisher[stream] = _node_handle.advertise<sensor_msgs::CameraInfo>(camera_info.str(), 1);
+            if (_serialize_from_frame)
+            {
+                // Shares the topic with the raw publisher of image_transport.
+                _raw_image_publisher[stream] = _node_handle.advertise<sensor_msgs::Image>(image_raw.str(), 1);
+            }
+
+            if (_enable_shm)
+            {
+                _shm_publisher[stream] = _node_handle.advertise<ShmFrame>(image_raw.str() + "/shm", 1);
+            }
+
+            if (stream == DEPTH && _enable_depth_rvl)
+            {
+                _compressed_publisher[stream] = _node_handle.advertise<sensor_msgs::CompressedImage>(image_raw.str() + "/rvl", 1);
+                _compression_diagnostics[stream] = std::make_shared<CompressionDiagnostics>();
+                setupRvlEncoder();
+            }
+
+            if (stream == COLOR && _enable_color_jpeg)
+            {
+                _compressed_publisher[stream] = _node_handle.advertise<sensor_msgs::CompressedImage>(image_raw.str() + "/jpeg", 1);
+                _compression_diagnostics[stream] = std::make_shared<CompressionDiagnostics>();
+                setupJpegEncoders();
+            }
 
             if (_align_depth && stream == COLOR)
             {
@@ -987,9 +1695,17 @@ void BaseRealSenseNode::setupPublishers()
                 aligned_camera_info << "aligned_depth_to_" << stream_name << "/camera_info";
 
                 std::string aligned_stream_name = "aligned_depth_to_" + stream_name;
-                std::shared_ptr<FrequencyDiagnostics> frequency_diagnostics(new FrequencyDiagnostics(_fps[stream], aligned_stream_name, _serial_no));
+                std::shared_ptr<StreamDiagnostics> frequency_diagnostics(new StreamDiagnostics(aligned_stream_name, _fps[stream]));
                 _depth_aligned_image_publishers[stream] = {image_transport.advertise(aligned_image_raw.str(), 1), frequency_diagnostics};
                 _depth_aligned_info_publisher[stream] = _node_handle.advertise<sensor_msgs::CameraInfo>(aligned_camera_info.str(), 1);
+                if (_serialize_from_frame)
+                {
+                    _depth_aligned_raw_image_publisher[stream] = _node_handle.advertise<sensor_msgs::Image>(aligned_image_raw.str(), 1);
+                }
+                if (_enable_shm)
+                {
+                    _depth_aligned_shm_publisher[stream] = _node_handle.advertise<ShmFrame>(aligned_image_raw.str() + "/shm", 1);
+                }
             }
 
             if (stream == DEPTH && _pointcloud)
@@ -1049,6 +1765,91 @@ void BaseRealSenseNode::setupPublishers()
     }
 }
 
+void BaseRealSenseNode::setupStreamContexts()
+{
+    _stream_contexts.assign(RS2_STREAM_COUNT * STREAM_INDEX_COUNT, StreamContext());
+    _depth_aligned_stream_contexts.assign(RS2_STREAM_COUNT * STREAM_INDEX_COUNT, StreamContext());
+    for (auto& image_publisher : _image_publishers)
+    {
+        const stream_index_pair& stream(image_publisher.first);
+        StreamContext& context(getStreamContext(stream));
+        context.is_valid = true;
+        context.stream = stream;
+        context.image = _image[stream];
+        context.encoding = &_encoding[stream.first];
+        context.optical_frame_id = &_optical_frame_id[stream];
+        context.camera_info = &_camera_info[stream];
+        context.info_publisher = &_info_publisher[stream];
+        context.image_publisher = &image_publisher.second;
+        setupStreamMetrics(context, image_publisher.second.second->name());
+        if (_compressed_publisher.count(stream))
+        {
+            context.compressed_publisher = &_compressed_publisher[stream];
+            context.compression_diagnostics = _compression_diagnostics[stream].get();
+        }
+        if (_raw_image_publisher.count(stream))
+        {
+            context.raw_image_publisher = &_raw_image_publisher[stream];
+        }
+        if (_shm_publisher.count(stream))
+        {
+            context.shm_publisher = &_shm_publisher[stream];
+            context.shm_segment = shmSegmentName(context.shm_publisher->getTopic());
+        }
+    }
+    for (auto& image_publisher : _depth_aligned_image_publishers)
+    {
+        const stream_index_pair& stream(image_publisher.first);
+        StreamContext& context(getDepthAlignedStreamContext(stream));
+        context.is_valid = true;
+        context.stream = stream;
+        context.image = _depth_aligned_image[stream];
+        context.encoding = &_depth_aligned_encoding[stream.first];
+        context.optical_frame_id = &_optical_frame_id[stream];
+        context.camera_info = &_depth_aligned_camera_info[stream];
+        context.info_publisher = &_depth_aligned_info_publisher[stream];
+        context.image_publisher = &image_publisher.second;
+        setupStreamMetrics(context, image_publisher.second.second->name());
+        if (_depth_aligned_raw_image_publisher.count(stream))
+        {
+            context.raw_image_publisher = &_depth_aligned_raw_image_publisher[stream];
+        }
+        if (_depth_aligned_shm_publisher.count(stream))
+        {
+            context.shm_publisher = &_depth_aligned_shm_publisher[stream];
+            context.shm_segment = shmSegmentName(context.shm_publisher->getTopic());
+        }
+    }
+    for (auto& imu_publisher : _imu_publishers)
+    {
+        const stream_index_pair& stream(imu_publisher.first);
+        StreamContext& context(getStreamContext(stream));
+        context.stream = stream;
+        context.optical_frame_id = &_optical_frame_id[stream];
+        context.imu_publisher = &imu_publisher.second;
+        setupStreamMetrics(context, STREAM_NAME(stream));
+    }
+}
+
+void BaseRealSenseNode::setupStreamMetrics(StreamContext& context, const std::string& stream_name)
+{
+    std::string labels("stream=\"" + stream_name + "\"");
+    context.published_messages = &_metrics.counter("realsense_published_messages_total", labels, "Messages published by stream, on any of its topics.");
+    context.published_bytes = &_metrics.counter("realsense_published_bytes_total", labels, "Image or compressed data bytes published by stream.");
+    context.publish_latency = &_metrics.histogram("realsense_publish_latency_seconds", labels, "From the frame timestamp to its publishing.",
+                                                  MetricsRegistry::durationBounds());
+}
+
+StreamContext& BaseRealSenseNode::getStreamContext(const stream_index_pair& stream)
+{
+    return _stream_contexts.at(streamSlot(stream));
+}
+
+StreamContext& BaseRealSenseNode::getDepthAlignedStreamContext(const stream_index_pair& stream)
+{
+    return _depth_aligned_stream_contexts.at(streamSlot(stream));
+}
+
 void BaseRealSenseNode::enable_devices()
 {
     for (auto& elem : IMAGE_STREAMS)
@@ -1121,7 +1922,6 @@ void BaseRealSenseNode::enable_devices()
 		for (auto& profiles : _enabled_profiles)
 		{
 			_depth_aligned_image[profiles.first] = cv::Mat(_height[DEPTH], _width[DEPTH], _image_format[DEPTH.first], cv::Scalar(0, 0, 0));
-			_depth_scaled_image[profiles.first] = cv::Mat(_height[DEPTH], _width[DEPTH], _image_format[DEPTH.first], cv::Scalar(0, 0, 0));
 		}
 	}
 
@@ -1271,12 +2071,28 @@ void BaseRealSenseNode::setupFilters()
         _pointcloud_filter = std::make_shared<rs2::pointcloud>(_pointcloud_texture.first, _pointcloud_texture.second);
         _filters.push_back(NamedFilter("pointcloud", _pointcloud_filter));
     }
+    // Decimation and HDR also change the infrared frames. The other filters only feed the depth based topics.
+    for (NamedFilter& filter : _filters)
+    {
+        if (filter._name == "pointcloud")
+            filter._demand = DEMAND_POINTS;
+        else if (filter._name == "align_to_color")
+            filter._demand = DEMAND_ALIGNED | DEMAND_POINTS;
+        else if (filter._name == "colorizer")
+            filter._demand = (_align_depth ? DEMAND_ALIGNED : DEMAND_DEPTH) | DEMAND_POINTS;
+        else if (filter._name != "decimation" && filter._name != "hdr_merge" && filter._name != "sequence_id_filter")
+            filter._demand = DEMAND_DEPTH | DEMAND_ALIGNED | DEMAND_POINTS;
+        filter._duration = &_metrics.histogram("realsense_filter_duration_seconds", "filter=\"" + filter._name + "\"",
+                                               "Processing time of a frameset by a filter.", MetricsRegistry::durationBounds());
+        filter._perf = _perf_counters.stage(filter._name);
+    }
     ROS_INFO("num_filters: %d", static_cast<int>(_filters.size()));
 }
 
 cv::Mat& BaseRealSenseNode::fix_depth_scale(const cv::Mat& from_image, cv::Mat& to_image)
 {
     static const float meter_to_mm = 0.001f;
+    PerfCounters::Scope perf_scope(_fix_depth_scale_perf);
     if (fabs(_depth_scale_meters - meter_to_mm) < 1e-6)
     {
         to_image = from_image;
@@ -1316,6 +2132,7 @@ cv::Mat& BaseRealSenseNode::fix_depth_scale(const cv::Mat& from_image, cv::Mat&
 
 void BaseRealSenseNode::clip_depth(rs2::depth_frame depth_frame, float clipping_dist)
 {
+    PerfCounters::Scope perf_scope(_clip_depth_perf);
     uint16_t* p_depth_frame = reinterpret_cast<uint16_t*>(const_cast<void*>(depth_frame.get_data()));
     uint16_t clipping_value = static_cast<uint16_t>(clipping_dist / _depth_scale_meters);
 
@@ -1360,9 +2177,8 @@ template <typename T> T lerp(const T &a, const T &b, const double t) {
   return a * (1.0 - t) + b * t;
 }
 
-void BaseRealSenseNode::FillImuData_LinearInterpolation(const CimuData imu_data, std::deque<sensor_msgs::Imu>& imu_msgs)
+void BaseRealSenseNode::FillImuData_LinearInterpolation(const CimuData imu_data, std::vector<sensor_msgs::Imu>& imu_msgs)
 {
-    static std::deque<CimuData> _imu_history;
     _imu_history.push_back(imu_data);
     stream_index_pair type(imu_data.m_type);
     imu_msgs.clear();
@@ -1370,13 +2186,11 @@ void BaseRealSenseNode::FillImuData_LinearInterpolation(const CimuData imu_data,
     if ((type != ACCEL) || _imu_history.size() < 3)
         return;
     
-    std::deque<CimuData> gyros_data;
-    CimuData accel0, accel1, crnt_imu;
+    _imu_gyros_data.clear();
+    CimuData accel0, accel1;
 
-    while (_imu_history.size()) 
+    for (const CimuData& crnt_imu : _imu_history)
     {
-        crnt_imu = _imu_history.front();
-        _imu_history.pop_front();
         if (!accel0.is_set() && crnt_imu.m_type == ACCEL) 
         {
             accel0 = crnt_imu;
@@ -1386,26 +2200,27 @@ void BaseRealSenseNode::FillImuData_LinearInterpolation(const CimuData imu_data,
             accel1 = crnt_imu;
             const double dt = accel1.m_time - accel0.m_time;
 
-            while (gyros_data.size())
+            for (const CimuData& crnt_gyro : _imu_gyros_data)
             {
-                CimuData crnt_gyro = gyros_data.front();
-                gyros_data.pop_front();
                 const double alpha = (crnt_gyro.m_time - accel0.m_time) / dt;
                 CimuData crnt_accel(ACCEL, lerp(accel0.m_data, accel1.m_data, alpha), crnt_gyro.m_time);
                 imu_msgs.push_back(CreateUnitedMessage(crnt_accel, crnt_gyro));
             }
+            _imu_gyros_data.clear();
             accel0 = accel1;
         } 
         else if (accel0.is_set() && crnt_imu.m_time >= accel0.m_time && crnt_imu.m_type == GYRO)
         {
-            gyros_data.push_back(crnt_imu);
+            _imu_gyros_data.push_back(crnt_imu);
         }
     }
-    _imu_history.push_back(crnt_imu);
+    CimuData last_imu(_imu_history.back());
+    _imu_history.clear();
+    _imu_history.push_back(last_imu);
     return;
 }
 
-void BaseRealSenseNode::FillImuData_Copy(const CimuData imu_data, std::deque<sensor_msgs::Imu>& imu_msgs)
+void BaseRealSenseNode::FillImuData_Copy(const CimuData imu_data, std::vector<sensor_msgs::Imu>& imu_msgs)
 {
     stream_index_pair type(imu_data.m_type);
 
@@ -1440,6 +2255,8 @@ void BaseRealSenseNode::imu_callback_sync(rs2::frame frame, imu_sync_method sync
     static int seq = 0;
 
     m_mutex.lock();
+    AllocationTracker::Scope allocation_scope(_allocation_tracker, AllocationTracker::IMU);
+    TraceSpan span("imu_callback_sync", frame);
 
     auto stream = frame.get_profile().stream_type();
     auto stream_index = (stream == GYRO.first)?GYRO:ACCEL;
@@ -1458,25 +2275,28 @@ void BaseRealSenseNode::imu_callback_sync(rs2::frame frame, imu_sync_method sync
         auto crnt_reading = *(reinterpret_cast<const float3*>(frame.get_data()));
         Eigen::Vector3d v(crnt_reading.x, crnt_reading.y, crnt_reading.z);
         CimuData imu_data(stream_index, v, frameSystemTimeSec(frame));
-        std::deque<sensor_msgs::Imu> imu_msgs;
+        _united_imu_msgs.clear();
         switch (sync_method)
         {
             case NONE: //Cannot really be NONE. Just to avoid compilation warning.
             case COPY:
-                FillImuData_Copy(imu_data, imu_msgs);
+                FillImuData_Copy(imu_data, _united_imu_msgs);
                 break;
             case LINEAR_INTERPOLATION:
-                FillImuData_LinearInterpolation(imu_data, imu_msgs);
+                FillImuData_LinearInterpolation(imu_data, _united_imu_msgs);
                 break;
         }
-        while (imu_msgs.size())
+        for (const sensor_msgs::Imu& united_msg : _united_imu_msgs)
         {
-            sensor_msgs::Imu imu_msg = imu_msgs.front();
-            imu_msg.header.seq = seq;
+            // The united messages carry the readings only, the defaults and the frame_id are set in a reused message.
+            sensor_msgs::Imu& imu_msg(_synced_imu_msg);
             ImuMessage_AddDefaultValues(imu_msg);
+            imu_msg.header.seq = seq;
+            imu_msg.header.stamp = united_msg.header.stamp;
+            imu_msg.angular_velocity = united_msg.angular_velocity;
+            imu_msg.linear_acceleration = united_msg.linear_acceleration;
             _synced_imu_publisher->Publish(imu_msg);
             ROS_DEBUG("Publish united %s stream", rs2_stream_to_string(frame.get_profile().stream_type()));
-            imu_msgs.pop_front();
         }
     }
     m_mutex.unlock();
@@ -1484,6 +2304,8 @@ void BaseRealSenseNode::imu_callback_sync(rs2::frame frame, imu_sync_method sync
 
 void BaseRealSenseNode::imu_callback(rs2::frame frame)
 {
+    AllocationTracker::Scope allocation_scope(_allocation_tracker, AllocationTracker::IMU);
+    TraceSpan span("imu_callback", frame);
     auto stream = frame.get_profile().stream_type();
     double frame_time = frame.get_timestamp();
     bool placeholder_false(false);
@@ -1498,13 +2320,14 @@ void BaseRealSenseNode::imu_callback(rs2::frame frame)
                 rs2_timestamp_domain_to_string(frame.get_frame_timestamp_domain()));
 
     auto stream_index = (stream == GYRO.first)?GYRO:ACCEL;
-    if (0 != _imu_publishers[stream_index].getNumSubscribers())
+    StreamContext& context(getStreamContext(stream_index));
+    if (context.imu_publisher && 0 != context.imu_publisher->getNumSubscribers())
     {
         ros::Time t(frameSystemTimeSec(frame));
 
-        auto imu_msg = sensor_msgs::Imu();
+        sensor_msgs::Imu& imu_msg(context.imu_msg);
         ImuMessage_AddDefaultValues(imu_msg);
-        imu_msg.header.frame_id = _optical_frame_id[stream_index];
+        imu_msg.header.frame_id = *context.optical_frame_id;
 
         auto crnt_reading = *(reinterpret_cast<const float3*>(frame.get_data()));
         if (GYRO == stream_index)
@@ -1519,16 +2342,20 @@ void BaseRealSenseNode::imu_callback(rs2::frame frame)
             imu_msg.linear_acceleration.y = crnt_reading.y;
             imu_msg.linear_acceleration.z = crnt_reading.z;
         }
-        _seq[stream_index] += 1;
-        imu_msg.header.seq = _seq[stream_index];
+        context.seq += 1;
+        imu_msg.header.seq = context.seq;
         imu_msg.header.stamp = t;
-        _imu_publishers[stream_index].publish(imu_msg);
+        countPublished(context, 0);
+        AllocationTracker::Untracked untracked;
+        context.imu_publisher->publish(imu_msg);
         ROS_DEBUG("Publish %s stream", rs2_stream_to_string(frame.get_profile().stream_type()));
     }
 }
 
 void BaseRealSenseNode::pose_callback(rs2::frame frame)
 {
+    AllocationTracker::Scope allocation_scope(_allocation_tracker, AllocationTracker::POSE);
+    TraceSpan span("pose_callback", frame);
     double frame_time = frame.get_timestamp();
     bool placeholder_false(false);
     if (_is_initialized_time_base.compare_exchange_strong(placeholder_false, true) )
@@ -1541,6 +2368,7 @@ void BaseRealSenseNode::pose_callback(rs2::frame frame)
                 frame.get_profile().stream_index(),
                 rs2_timestamp_domain_to_string(frame.get_frame_timestamp_domain()));
     const auto& stream_index(POSE);
+    StreamContext& context(getStreamContext(stream_index));
     rs2_pose pose = frame.as<rs2::pose_frame>().get_pose_data();
     ros::Time t(frameSystemTimeSec(frame));
 
@@ -1554,7 +2382,7 @@ void BaseRealSenseNode::pose_callback(rs2::frame frame)
     pose_msg.pose.orientation.w = pose.rotation.w;
 
     static tf2_ros::TransformBroadcaster br;
-    geometry_msgs::TransformStamped msg;
+    geometry_msgs::TransformStamped& msg(context.odom_transform);
     msg.header.stamp = t;
     msg.header.frame_id = _odom_frame_id;
     msg.child_frame_id = _frame_id[POSE];
@@ -1568,7 +2396,7 @@ void BaseRealSenseNode::pose_callback(rs2::frame frame)
 
     if (_publish_odom_tf) br.sendTransform(msg);
 
-    if (0 != _imu_publishers[stream_index].getNumSubscribers())
+    if (context.imu_publisher && 0 != context.imu_publisher->getNumSubscribers())
     {
         double cov_pose(_linear_accel_cov * pow(10, 3-(int)pose.tracker_confidence));
         double cov_twist(_angular_velocity_cov * pow(10, 1-(int)pose.tracker_confidence));
@@ -1592,13 +2420,13 @@ void BaseRealSenseNode::pose_callback(rs2::frame frame)
         tf::vector3TFToMsg(tfv,om_msg.vector);
 	
 
-        nav_msgs::Odometry odom_msg;
-        _seq[stream_index] += 1;
+        nav_msgs::Odometry& odom_msg(context.odom_msg);
+        context.seq += 1;
 
         odom_msg.header.frame_id = _odom_frame_id;
         odom_msg.child_frame_id = _frame_id[POSE];
         odom_msg.header.stamp = t;
-        odom_msg.header.seq = _seq[stream_index];
+        odom_msg.header.seq = context.seq;
         odom_msg.pose.pose = pose_msg.pose;
         odom_msg.pose.covariance = {cov_pose, 0, 0, 0, 0, 0,
                                     0, cov_pose, 0, 0, 0, 0,
@@ -1614,15 +2442,18 @@ void BaseRealSenseNode::pose_callback(rs2::frame frame)
                                     0, 0, 0, cov_twist, 0, 0,
                                     0, 0, 0, 0, cov_twist, 0,
                                     0, 0, 0, 0, 0, cov_twist};
-        _imu_publishers[stream_index].publish(odom_msg);
+        countPublished(context, 0);
+        AllocationTracker::Untracked untracked;
+        context.imu_publisher->publish(odom_msg);
         ROS_DEBUG("Publish %s stream", rs2_stream_to_string(frame.get_profile().stream_type()));
     }
 }
 
 void BaseRealSenseNode::frame_callback(rs2::frame frame)
 {
-    _synced_imu_publisher->Pause();
-    
+    AllocationTracker::Scope allocation_scope(_allocation_tracker, AllocationTracker::FRAME);
+    TraceSpan span("frame_callback", frame);
+
     try{
         double frame_time = frame.get_timestamp();
 
@@ -1636,6 +2467,7 @@ void BaseRealSenseNode::frame_callback(rs2::frame frame)
         }
 
         ros::Time t(frameSystemTimeSec(frame));
+        SyncedImuPublisher::Watermark imu_watermark(*_synced_imu_publisher, t);
         if (frame.is<rs2::frameset>())
         {
             ROS_DEBUG("Frameset arrived.");
@@ -1653,10 +2485,13 @@ void BaseRealSenseNode::frame_callback(rs2::frame frame)
                             rs2_stream_to_string(stream_type), stream_index, rs2_format_to_string(stream_format), stream_unique_id, frame.get_frame_number(), frame_time, t.toNSec());
                 runFirstFrameInitialization(stream_type);
             }
+            // Skip the processing of the topics nobody listens to. The same snapshot decides what is published, so a
+            // topic subscribed meanwhile doesn't get a frame that skipped its processing.
+            unsigned int demand(_topic_demand.load(std::memory_order_relaxed));
             // Clip depth_frame for max range:
             rs2::depth_frame original_depth_frame = frameset.get_depth_frame();
             bool is_color_frame(frameset.get_color_frame());
-            if (original_depth_frame && _clipping_distance > 0)
+            if (original_depth_frame && _clipping_distance > 0 && (demand & (DEMAND_DEPTH | DEMAND_ALIGNED | DEMAND_POINTS)))
             {
                 clip_depth(original_depth_frame, _clipping_distance);
             }
@@ -1664,12 +2499,18 @@ void BaseRealSenseNode::frame_callback(rs2::frame frame)
             ROS_DEBUG("num_filters: %d", static_cast<int>(_filters.size()));
             for (std::vector<NamedFilter>::const_iterator filter_it = _filters.begin(); filter_it != _filters.end(); filter_it++)
             {
+                if (!(filter_it->_demand & demand))
+                    continue;
                 ROS_DEBUG("Applying filter: %s", filter_it->_name.c_str());
                 if ((filter_it->_name == "pointcloud") && (!original_depth_frame))
                     continue;
                 if ((filter_it->_name == "align_to_color") && (!is_color_frame))
                     continue;
+                TraceSpan filter_span(filter_it->_name.c_str(), frameset);
+                PerfCounters::Scope filter_perf_scope(filter_it->_perf);
+                auto filter_start_time = std::chrono::steady_clock::now();
                 frameset = filter_it->_filter->process(frameset);
+                filter_it->_duration->observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - filter_start_time).count());
             }
 
             ROS_DEBUG("List of frameset after applying filters: size: %d", static_cast<int>(frameset.size()));
@@ -1698,24 +2539,15 @@ void BaseRealSenseNode::frame_callback(rs2::frame frame)
                     sent_depth_frame = true;
                     if (_align_depth && is_color_frame)
                     {
-                        publishFrame(f, t, COLOR,
-                                    _depth_aligned_image,
-                                    _depth_aligned_info_publisher,
-                                    _depth_aligned_image_publishers, _depth_aligned_seq,
-                                    _depth_aligned_camera_info,
-                                    _depth_aligned_encoding);
+                        if (demand & DEMAND_ALIGNED)
+                            publishFrame(f, t, getDepthAlignedStreamContext(COLOR));
                         continue;
                     }
                 }
-                publishFrame(f, t,
-                                sip,
-                                _image,
-                                _info_publisher,
-                                _image_publishers, _seq,
-                                _camera_info,
-                                _encoding);
+                if (demand & (stream_type == RS2_STREAM_DEPTH ? DEMAND_DEPTH : DEMAND_IMAGES))
+                    publishFrame(f, t, getStreamContext(sip));
             }
-            if (original_depth_frame && _align_depth)
+            if (original_depth_frame && _align_depth && (demand & DEMAND_DEPTH))
             {
                 rs2::frame frame_to_send;
                 if (_colorizer)
@@ -1723,13 +2555,7 @@ void BaseRealSenseNode::frame_callback(rs2::frame frame)
                 else
                     frame_to_send = original_depth_frame;
                 
-                publishFrame(frame_to_send, t,
-                                DEPTH,
-                                _image,
-                                _info_publisher,
-                                _image_publishers, _seq,
-                                _camera_info,
-                                _encoding);
+                publishFrame(frame_to_send, t, getStreamContext(DEPTH));
             }
         }
         else if (frame.is<rs2::video_frame>())
@@ -1741,29 +2567,42 @@ void BaseRealSenseNode::frame_callback(rs2::frame frame)
             runFirstFrameInitialization(stream_type);
 
             stream_index_pair sip{stream_type,stream_index};
-            if (frame.is<rs2::depth_frame>())
+            unsigned int demand(_topic_demand.load(std::memory_order_relaxed));
+            if (!(demand & (frame.is<rs2::depth_frame>() ? DEMAND_DEPTH : DEMAND_IMAGES)))
+                return;
+            if (frame.is<rs2::depth_frame>() && _clipping_distance > 0)
             {
-                if (_clipping_distance > 0)
-                {
-                    clip_depth(frame, _clipping_distance);
-                }
+                clip_depth(frame, _clipping_distance);
             }
-            publishFrame(frame, t,
-                            sip,
-                            _image,
-                            _info_publisher,
-                            _image_publishers, _seq,
-                            _camera_info,
-                            _encoding);
+            publishFrame(frame, t, getStreamContext(sip));
         }
     }
     catch(const std::exception& ex)
     {
         ROS_ERROR_STREAM("An error has occurred during frame callback: " << ex.what());
     }
-    _synced_imu_publisher->Resume();
 }; // frame_callback
 
+std::function<void(rs2::frame)> BaseRealSenseNode::processOnWorkerPool(std::function<void(rs2::frame)> callback)
+{
+    // Without a worker pool, frames are processed on the librealsense thread that delivered them.
+    if (!_worker_pool)
+        return callback;
+
+    auto strand = std::make_shared<Strand>(*_worker_pool);
+    _strands.push_back(strand);
+    std::string serial_no(_serial_no);
+    MetricsRegistry::Counter* dropped(&_metrics.counter("realsense_dropped_frames_total", "reason=\"worker_pool\"", "Frames dropped before publishing."));
+    return [strand, callback, serial_no, dropped](rs2::frame frame)
+    {
+        if (!strand->post([callback, frame](){ callback(frame); }))
+        {
+            dropped->add();
+            ROS_WARN_STREAM_THROTTLE(5, "Device " << serial_no << ": frame processing falls behind, " << strand->droppedCount() << " frames were dropped so far.");
+        }
+    };
+}
+
 void BaseRealSenseNode::multiple_message_callback(rs2::frame frame, imu_sync_method sync_method)
 {
     auto stream = frame.get_profile().stream_type();
@@ -1787,9 +2626,8 @@ bool BaseRealSenseNode::setBaseTime(double frame_time, rs2_timestamp_domain time
     ROS_WARN_ONCE(time_domain == RS2_TIMESTAMP_DOMAIN_SYSTEM_TIME ? "Frame metadata isn't available! (frame_timestamp_domain = RS2_TIMESTAMP_DOMAIN_SYSTEM_TIME)" : "");
     if (time_domain == RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK)
     {
-        ROS_WARN("frame's time domain is HARDWARE_CLOCK. Timestamps may reset periodically.");
-        _ros_time_base = ros::Time::now();
-        _camera_time_base = frame_time;
+        ROS_INFO("frame's time domain is HARDWARE_CLOCK. Timestamps are mapped to ROS time by a drift compensated clock model.");
+        _clock_model.reset();
         return true;
     }
     return false;
@@ -1799,8 +2637,8 @@ double BaseRealSenseNode::frameSystemTimeSec(rs2::frame frame)
 {
     if (frame.get_frame_timestamp_domain() == RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK)
     {
-        double elapsed_camera_ms = (/*ms*/ frame.get_timestamp() - /*ms*/ _camera_time_base) / 1000.0;
-        return (_ros_time_base.toSec() + elapsed_camera_ms);
+        // Shared by all the streams of the device: they all run on the same hardware clock.
+        return _clock_model.toHostTime(/*ms*/ frame.get_timestamp(), ros::Time::now().toSec());
     }
     else
     {
@@ -1825,31 +2663,13 @@ void BaseRealSenseNode::setupStreams()
             }
         }
 
-        // Streaming IMAGES
-        std::map<std::string, std::vector<rs2::stream_profile> > profiles;
-        std::map<std::string, rs2::sensor> active_sensors;
-        for (const std::pair<stream_index_pair, std::vector<rs2::stream_profile>>& profile : _enabled_profiles)
+        if (_sync_frames)
         {
-            std::string module_name = _sensors[profile.first].get_info(RS2_CAMERA_INFO_NAME);
-            ROS_INFO_STREAM("insert " << rs2_stream_to_string(profile.second.begin()->stream_type())
-              << " to " << module_name);
-            profiles[module_name].insert(profiles[module_name].begin(),
-                                            profile.second.begin(),
-                                            profile.second.end());
-            active_sensors[module_name] = _sensors[profile.first];
+            startSyncer();
         }
 
-        for (const std::pair<std::string, std::vector<rs2::stream_profile> >& sensor_profile : profiles)
-        {
-            std::string module_name = sensor_profile.first;
-            rs2::sensor sensor = active_sensors[module_name];
-            sensor.open(sensor_profile.second);
-            sensor.start(_sensors_callback[module_name]);
-            if (sensor.is<rs2::depth_sensor>())
-            {
-                _depth_scale_meters = sensor.as<rs2::depth_sensor>().get_depth_scale();
-            }
-        }
+        // Streaming IMAGES
+        startSensors();
     }
     catch(const std::exception& ex)
     {
@@ -1863,11 +2683,95 @@ void BaseRealSenseNode::setupStreams()
     }
 }
 
+void BaseRealSenseNode::startSyncer()
+{
+    std::vector<stream_index_pair> streams;
+    int min_fps(std::numeric_limits<int>::max()), max_fps(0);
+    for (auto& stream : IMAGE_STREAMS)
+    {
+        if (_enabled_profiles.find(stream) == _enabled_profiles.end())
+            continue;
+        streams.push_back(stream);
+        min_fps = std::min(min_fps, _fps[stream]);
+        max_fps = std::max(max_fps, _fps[stream]);
+    }
+    if (streams.empty() || 0 == max_fps)
+        return;
+    // By default, frames are matched within half the shortest frame interval, and a frameset waits for one frame
+    // interval of the slowest stream at most.
+    FramesetSyncer::Settings settings(_sync_settings);
+    if (settings.tolerance_ms <= 0)
+        settings.tolerance_ms = 500.0 / max_fps;
+    if (settings.deadline_ms <= 0)
+        settings.deadline_ms = 1000.0 / min_fps;
+    ROS_INFO_STREAM("Sync tolerance: " << settings.tolerance_ms << " ms, deadline: " << settings.deadline_ms << " ms");
+    _syncer.start(settings, streams, processOnWorkerPool([this](rs2::frame frame){ frame_callback(frame); }));
+}
+
+void BaseRealSenseNode::startSensors()
+{
+    std::map<std::string, std::vector<rs2::stream_profile> > profiles;
+    std::map<std::string, rs2::sensor> active_sensors;
+    for (const std::pair<stream_index_pair, std::vector<rs2::stream_profile>>& profile : _enabled_profiles)
+    {
+        std::string module_name = _sensors[profile.first].get_info(RS2_CAMERA_INFO_NAME);
+        ROS_INFO_STREAM("insert " << rs2_stream_to_string(profile.second.begin()->stream_type())
+          << " to " << module_name);
+        profiles[module_name].insert(profiles[module_name].begin(),
+                                        profile.second.begin(),
+                                        profile.second.end());
+        active_sensors[module_name] = _sensors[profile.first];
+    }
+
+    // Every module is a separate USB interface with its own lock in librealsense, so they can be opened and started concurrently.
+    std::vector<std::future<void>> results;
+    for (const std::pair<std::string, std::vector<rs2::stream_profile> >& sensor_profile : profiles)
+    {
+        rs2::sensor sensor = active_sensors[sensor_profile.first];
+        std::vector<rs2::stream_profile> sensor_profiles(sensor_profile.second);
+        std::function<void(rs2::frame)> sensor_callback(_sensors_callback[sensor_profile.first]);
+        std::function<void(rs2::frame)> callback = [this, sensor_callback](rs2::frame frame)
+        {
+            if ((_frame_filter && !_frame_filter(frame)) || _is_paused)
+                return;
+            _raw_recorder->record(frame);
+            if (_flight_recorder)
+                _flight_recorder->record(frame);
+            sensor_callback(frame);
+        };
+        results.push_back(std::async(_parallel_startup ? std::launch::async : std::launch::deferred,
+                                     [sensor, sensor_profiles, callback]() mutable
+                                     {
+                                         sensor.open(sensor_profiles);
+                                         sensor.start(callback);
+                                     }));
+    }
+    // Let all the modules finish before reporting the first failure.
+    for (auto& result : results)
+    {
+        result.wait();
+    }
+    for (auto& result : results)
+    {
+        result.get();
+    }
+    _is_streaming = true;
+
+    for (auto& active_sensor : active_sensors)
+    {
+        if (active_sensor.second.is<rs2::depth_sensor>())
+        {
+            _depth_scale_meters = active_sensor.second.as<rs2::depth_sensor>().get_depth_scale();
+        }
+    }
+}
+
 void BaseRealSenseNode::updateStreamCalibData(const rs2::video_stream_profile& video_profile)
 {
     stream_index_pair stream_index{video_profile.stream_type(), video_profile.stream_index()};
-    auto intrinsic = video_profile.get_intrinsics();
+    auto intrinsic = getIntrinsics(video_profile);
     _stream_intrinsics[stream_index] = intrinsic;
+    getStreamContext(stream_index).cached_camera_info.invalidate();
     _camera_info[stream_index].width = intrinsic.width;
     _camera_info[stream_index].height = intrinsic.height;
     _camera_info[stream_index].header.frame_id = _optical_frame_id[stream_index];
@@ -1897,7 +2801,7 @@ void BaseRealSenseNode::updateStreamCalibData(const rs2::video_stream_profile& v
         stream_index_pair sip1{stream_index.first, 1};
         if (_enable[sip1])
         {
-            const auto& ex = getAProfile(stream_index).get_extrinsics_to(getAProfile(sip1));
+            const auto& ex = getExtrinsics(getAProfile(stream_index), getAProfile(sip1));
             _camera_info[stream_index].header.frame_id = _optical_frame_id[sip1];
             _camera_info[stream_index].P.at(3) = -intrinsic.fx * ex.translation[0] + 0.0; // Tx - avoid -0.0 values.
             _camera_info[stream_index].P.at(7) = -intrinsic.fy * ex.translation[1] + 0.0; // Ty - avoid -0.0 values.
@@ -1943,6 +2847,7 @@ void BaseRealSenseNode::updateStreamCalibData(const rs2::video_stream_profile& v
                 auto video_profile = profile.as<rs2::video_stream_profile>();
                 stream_index_pair stream_index{video_profile.stream_type(), video_profile.stream_index()};
                 _depth_aligned_camera_info[stream_index] = _camera_info[stream_index];
+                getDepthAlignedStreamContext(stream_index).cached_camera_info.invalidate();
             }
         }
     }
@@ -1992,7 +2897,7 @@ void BaseRealSenseNode::calcAndPublishStaticTransform(const stream_index_pair& s
     rs2_extrinsics ex;
     try
     {
-        ex = getAProfile(stream).get_extrinsics_to(base_profile);
+        ex = getExtrinsics(getAProfile(stream), base_profile);
     }
     catch (std::exception& e)
     {
@@ -2059,7 +2964,10 @@ void BaseRealSenseNode::publishStaticTransforms()
         if (_tf_publish_rate > 0)
             _tf_t = std::shared_ptr<std::thread>(new std::thread(boost::bind(&BaseRealSenseNode::publishDynamicTransforms, this)));
         else
-            _static_tf_broadcaster.sendTransform(_static_tf_msgs);
+        {
+            std::lock_guard<std::mutex> lock(static_tf_mutex);
+            _static_tf_broadcaster->sendTransform(_static_tf_msgs);
+        }
     }
 
     // Publish Extrinsics Topics:
@@ -2067,7 +2975,7 @@ void BaseRealSenseNode::publishStaticTransforms()
         _enable[FISHEYE])
     {
         static const char* frame_id = "depth_to_fisheye_extrinsics";
-        const auto& ex = base_profile.get_extrinsics_to(getAProfile(FISHEYE));
+        const auto& ex = getExtrinsics(base_profile, getAProfile(FISHEYE));
 
         _depth_to_other_extrinsics[FISHEYE] = ex;
         _depth_to_other_extrinsics_publishers[FISHEYE].publish(rsExtrinsicsToMsg(ex, frame_id));
@@ -2077,7 +2985,7 @@ void BaseRealSenseNode::publishStaticTransforms()
         _enable[COLOR])
     {
         static const char* frame_id = "depth_to_color_extrinsics";
-        const auto& ex = base_profile.get_extrinsics_to(getAProfile(COLOR));
+        const auto& ex = getExtrinsics(base_profile, getAProfile(COLOR));
         _depth_to_other_extrinsics[COLOR] = ex;
         _depth_to_other_extrinsics_publishers[COLOR].publish(rsExtrinsicsToMsg(ex, frame_id));
     }
@@ -2086,7 +2994,7 @@ void BaseRealSenseNode::publishStaticTransforms()
         _enable[INFRA1])
     {
         static const char* frame_id = "depth_to_infra1_extrinsics";
-        const auto& ex = base_profile.get_extrinsics_to(getAProfile(INFRA1));
+        const auto& ex = getExtrinsics(base_profile, getAProfile(INFRA1));
         _depth_to_other_extrinsics[INFRA1] = ex;
         _depth_to_other_extrinsics_publishers[INFRA1].publish(rsExtrinsicsToMsg(ex, frame_id));
     }
@@ -2095,7 +3003,7 @@ void BaseRealSenseNode::publishStaticTransforms()
         _enable[INFRA2])
     {
         static const char* frame_id = "depth_to_infra2_extrinsics";
-        const auto& ex = base_profile.get_extrinsics_to(getAProfile(INFRA2));
+        const auto& ex = getExtrinsics(base_profile, getAProfile(INFRA2));
         _depth_to_other_extrinsics[INFRA2] = ex;
         _depth_to_other_extrinsics_publishers[INFRA2].publish(rsExtrinsicsToMsg(ex, frame_id));
     }
@@ -2113,6 +3021,7 @@ void BaseRealSenseNode::publishDynamicTransforms()
     {
         _cv_tf.wait_for(lock, std::chrono::milliseconds((int)(1000.0/_tf_publish_rate)), [&]{return (!(_is_running));});
         {
+            TraceSpan span("publishDynamicTransforms");
             ros::Time t = ros::Time::now();
             for(auto& msg : _static_tf_msgs)
                 msg.header.stamp = t;
@@ -2151,6 +3060,8 @@ void BaseRealSenseNode::publishPointCloud(rs2::points pc, const ros::Time& t, co
 {
     if (0 == _pointcloud_publisher.getNumSubscribers())
         return;
+    TraceSpan span("publishPointCloud", pc);
+    PerfCounters::Scope perf_scope(_pointcloud_perf);
     ROS_INFO_STREAM_ONCE("publishing " << (_ordered_pc ? "" : "un") << "ordered pointcloud.");
 
     rs2_stream texture_source_id = static_cast<rs2_stream>(_pointcloud_filter->get_option(rs2_option::RS2_OPTION_STREAM_FILTER));
@@ -2160,11 +3071,10 @@ void BaseRealSenseNode::publishPointCloud(rs2::points pc, const ros::Time& t, co
     rs2::frameset::iterator texture_frame_itr = frameset.end();
     if (use_texture)
     {
-        std::set<rs2_format> available_formats{ rs2_format::RS2_FORMAT_RGB8, rs2_format::RS2_FORMAT_Y8 };
-        
-        texture_frame_itr = find_if(frameset.begin(), frameset.end(), [&texture_source_id, &available_formats] (rs2::frame f) 
-                                {return (rs2_stream(f.get_profile().stream_type()) == texture_source_id) &&
-                                            (available_formats.find(f.get_profile().format()) != available_formats.end()); });
+        texture_frame_itr = find_if(frameset.begin(), frameset.end(), [&texture_source_id] (rs2::frame f) 
+                                {rs2_format format(f.get_profile().format());
+                                 return (rs2_stream(f.get_profile().stream_type()) == texture_source_id) &&
+                                            (format == rs2_format::RS2_FORMAT_RGB8 || format == rs2_format::RS2_FORMAT_Y8); });
         if (texture_frame_itr == frameset.end())
         {
             warn_count++;
@@ -2202,7 +3112,7 @@ void BaseRealSenseNode::publishPointCloud(rs2::points pc, const ros::Time& t, co
         texture_height = texture_frame.get_height();
         num_colors = texture_frame.get_bytes_per_pixel();
         uint8_t* color_data = (uint8_t*)texture_frame.get_data();
-        std::string format_str;
+        const char* format_str;
         switch(texture_frame.get_profile().format())
         {
             case RS2_FORMAT_RGB8:
@@ -2214,7 +3124,7 @@ void BaseRealSenseNode::publishPointCloud(rs2::points pc, const ros::Time& t, co
             default:
                 throw std::runtime_error("Unhandled texture format passed in pointcloud " + std::to_string(texture_frame.get_profile().format()));
         }
-        _msg_pointcloud.point_step = addPointField(_msg_pointcloud, format_str.c_str(), 1, sensor_msgs::PointField::FLOAT32, _msg_pointcloud.point_step);
+        _msg_pointcloud.point_step = addPointField(_msg_pointcloud, format_str, 1, sensor_msgs::PointField::FLOAT32, _msg_pointcloud.point_step);
         _msg_pointcloud.row_step = _msg_pointcloud.width * _msg_pointcloud.point_step;
         _msg_pointcloud.data.resize(_msg_pointcloud.height * _msg_pointcloud.row_step);
 
@@ -2254,7 +3164,6 @@ void BaseRealSenseNode::publishPointCloud(rs2::points pc, const ros::Time& t, co
     }
     else
     {
-        std::string format_str = "intensity";
         _msg_pointcloud.row_step = _msg_pointcloud.width * _msg_pointcloud.point_step;
         _msg_pointcloud.data.resize(_msg_pointcloud.height * _msg_pointcloud.row_step);
 
@@ -2286,6 +3195,7 @@ void BaseRealSenseNode::publishPointCloud(rs2::points pc, const ros::Time& t, co
         _msg_pointcloud.is_dense = true;
         modifier.resize(valid_count);
     }
+    AllocationTracker::Untracked untracked;
     _pointcloud_publisher.publish(_msg_pointcloud);
 }
 
@@ -2343,17 +3253,14 @@ IMUInfo BaseRealSenseNode::getImuInfo(const stream_index_pair& stream_index)
     return info;
 }
 
-void BaseRealSenseNode::publishFrame(rs2::frame f, const ros::Time& t,
-                                     const stream_index_pair& stream,
-                                     std::map<stream_index_pair, cv::Mat>& images,
-                                     const std::map<stream_index_pair, ros::Publisher>& info_publishers,
-                                     const std::map<stream_index_pair, ImagePublisherWithFrequencyDiagnostics>& image_publishers,
-                                     std::map<stream_index_pair, int>& seq,
-                                     std::map<stream_index_pair, sensor_msgs::CameraInfo>& camera_info,
-                                     const std::map<rs2_stream, std::string>& encoding,
-                                     bool copy_data_from_frame)
+void BaseRealSenseNode::publishFrame(rs2::frame f, const ros::Time& t, StreamContext& context, bool copy_data_from_frame)
 {
     ROS_DEBUG("publishFrame(...)");
+    TraceSpan span("publishFrame", f);
+    if (!context.is_valid)
+    {
+        throw std::runtime_error(std::string("No publisher for stream ") + rs2_stream_to_string(f.get_profile().stream_type()));
+    }
     unsigned int width = 0;
     unsigned int height = 0;
     auto bpp = 1;
@@ -2363,55 +3270,299 @@ void BaseRealSenseNode::publishFrame(rs2::frame f, const ros::Time& t,
         width = image.get_width();
         height = image.get_height();
         bpp = image.get_bytes_per_pixel();
-    }
-    auto& image = images[stream];
-
-    if (copy_data_from_frame)
-    {
-        if (images[stream].size() != cv::Size(width, height))
+        // E.g. raw depth on the topic of the colorized depth: the pixels would be read past the end of the frame.
+        if (copy_data_from_frame && static_cast<size_t>(bpp) != context.image.elemSize())
         {
-            image.create(height, width, image.type());
+            ROS_WARN_STREAM_THROTTLE(5, "A " << rs2_format_to_string(f.get_profile().format()) << " frame doesn't match the "
+                                     << *context.encoding << " encoding of its topic. It was dropped.");
+            return;
         }
-        image.data = (uint8_t*)f.get_data();
     }
-    if (f.is<rs2::depth_frame>())
+    ++context.seq;
+    auto& info_publisher = *context.info_publisher;
+    auto& image_publisher = *context.image_publisher;
+
+    double latency_sec((ros::Time::now() - t).toSec());
+    image_publisher.second->tick(latency_sec);
+    context.publish_latency->observe(latency_sec);
+    if (!_is_first_frame_published && !_is_first_frame_published.exchange(true) && _first_frame_callback)
     {
-        image = fix_depth_scale(image, _depth_scaled_image[stream]);
+        _first_frame_callback();
     }
-
-    ++(seq[stream]);
-    auto& info_publisher = info_publishers.at(stream);
-    auto& image_publisher = image_publishers.at(stream);
-
-    image_publisher.second->tick();
+    bool is_compressed_subscribed(context.compressed_publisher && 0 != context.compressed_publisher->getNumSubscribers());
+    bool is_shm_subscribed(context.shm_publisher && 0 != context.shm_publisher->getNumSubscribers());
     if(0 != info_publisher.getNumSubscribers() ||
-       0 != image_publisher.first.getNumSubscribers())
+       0 != image_publisher.first.getNumSubscribers() ||
+       is_compressed_subscribed || is_shm_subscribed)
     {
-        auto& cam_info = camera_info.at(stream);
+        auto& image = context.image;
+        if (copy_data_from_frame)
+        {
+            if (image.size() != cv::Size(width, height))
+            {
+                image.create(height, width, image.type());
+            }
+            image.data = (uint8_t*)f.get_data();
+        }
+        if (f.is<rs2::depth_frame>())
+        {
+            image = fix_depth_scale(image, context.depth_scaled_image);
+        }
+
+        auto& cam_info = *context.camera_info;
         if (cam_info.width != width)
         {
             updateStreamCalibData(f.get_profile().as<rs2::video_stream_profile>());
         }
-        cam_info.header.stamp = t;
-        cam_info.header.seq = seq[stream];
-        info_publisher.publish(cam_info);
+        if (0 != info_publisher.getNumSubscribers())
+        {
+            context.cached_camera_info.update(cam_info, context.seq, t);
+            AllocationTracker::Untracked untracked;
+            info_publisher.publish(context.cached_camera_info);
+        }
+        if (is_shm_subscribed)
+        {
+            publishShm(image, t, context);
+        }
+        if (is_compressed_subscribed && f.is<rs2::depth_frame>())
+        {
+            postRvl(f, image, t, context);
+        }
+        else if (is_compressed_subscribed && context.stream == COLOR)
+        {
+            postJpeg(f.as<rs2::video_frame>(), t, context);
+        }
+        if (0 == image_publisher.first.getNumSubscribers())
+            return;
+
+        // When all the subscribers are on the raw topic, the pixels are serialized straight from the frame buffer
+        // instead of being copied into a sensor_msgs::Image first.
+        if (context.raw_image_publisher &&
+            context.raw_image_publisher->getNumSubscribers() == image_publisher.first.getNumSubscribers() &&
+            image.isContinuous() && image.total() * image.elemSize() >= static_cast<size_t>(height) * width * bpp)
+        {
+            ImageFrameView& view(context.raw_image);
+            view.header.frame_id = cam_info.header.frame_id;
+            view.header.stamp = t;
+            view.header.seq = context.seq;
+            view.height = height;
+            view.width = width;
+            view.encoding = *context.encoding;
+            view.is_bigendian = false;
+            view.step = width * bpp;
+            view.data = image.data;
+            countPublished(context, static_cast<size_t>(height) * view.step);
+            {
+                AllocationTracker::Untracked untracked;
+                context.raw_image_publisher->publish(view);
+            }
+            ROS_DEBUG("%s stream published", rs2_stream_to_string(f.get_profile().stream_type()));
+            return;
+        }
 
         sensor_msgs::ImagePtr img;
-        img = cv_bridge::CvImage(std_msgs::Header(), encoding.at(stream.first), image).toImageMsg();
+        img = cv_bridge::CvImage(std_msgs::Header(), *context.encoding, image).toImageMsg();
         img->width = width;
         img->height = height;
         img->is_bigendian = false;
         img->step = width * bpp;
         img->header.frame_id = cam_info.header.frame_id;
         img->header.stamp = t;
-        img->header.seq = seq[stream];
+        img->header.seq = context.seq;
 
+        countPublished(context, img->data.size());
         image_publisher.first.publish(img);
         // ROS_INFO_STREAM("fid: " << cam_info.header.seq << ", time: " << std::setprecision (20) << t.toSec());
         ROS_DEBUG("%s stream published", rs2_stream_to_string(f.get_profile().stream_type()));
     }
 }
 
+void BaseRealSenseNode::setupRvlEncoder()
+{
+    // Like the JPEG color, the depth is encoded on a strand of its own, so the encoding, a few milliseconds per VGA
+    // frame, doesn't hold up the depth image and the other topics published by the frame callback. The strand drops
+    // the older frames when the encoder falls behind.
+    if (!_worker_pool)
+    {
+        _rvl_worker_pool = std::make_shared<WorkerPool>(1, 1);
+    }
+    _rvl_strand = std::make_shared<Strand>(_worker_pool ? *_worker_pool : *_rvl_worker_pool);
+    _strands.push_back(_rvl_strand);
+}
+
+void BaseRealSenseNode::postRvl(rs2::frame frame, const cv::Mat& image, const ros::Time& t, StreamContext& context)
+{
+    // The colorized depth isn't 16 bit.
+    if (*context.encoding != sensor_msgs::image_encodings::TYPE_16UC1 || !image.isContinuous())
+        return;
+    // The task holds the frame, so the encoder reads the librealsense buffer directly. Depth rescaled to millimeters
+    // is in a buffer the next frame reuses, so it is copied.
+    cv::Mat pixels(image.data == frame.get_data() ? image : image.clone());
+    int seq(context.seq);
+    if (!_rvl_strand->post([this, frame, pixels, t, seq, &context](){ publishRvl(pixels, t, seq, context); }))
+    {
+        context.compression_diagnostics->addDropped();
+    }
+}
+
+void BaseRealSenseNode::publishRvl(const cv::Mat& image, const ros::Time& t, int seq, StreamContext& context)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    // Layout of compressed_depth_image_transport: its config header (compression format INV_DEPTH = 0 and two depth
+    // quantization floats, unused for 16 bit depth), the image size and then the RVL data.
+    const uint32_t config_header[3] = {0, 0, 0};
+    const uint32_t image_size[2] = {static_cast<uint32_t>(image.cols), static_cast<uint32_t>(image.rows)};
+    const size_t header_size(sizeof(config_header) + sizeof(image_size));
+    size_t num_pixels(image.total());
+
+    sensor_msgs::CompressedImagePtr msg(new sensor_msgs::CompressedImage());
+    msg->data.resize(header_size + rvl::maxEncodedSize(num_pixels));
+    memcpy(msg->data.data(), config_header, sizeof(config_header));
+    memcpy(msg->data.data() + sizeof(config_header), image_size, sizeof(image_size));
+    size_t encoded_size(rvl::encode(image.ptr<uint16_t>(), num_pixels, msg->data.data() + header_size));
+    msg->data.resize(header_size + encoded_size);
+    double encode_sec(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+
+    msg->header.frame_id = *context.optical_frame_id;
+    msg->header.stamp = t;
+    msg->header.seq = seq;
+    msg->format = *context.encoding + "; compressedDepth rvl";
+    countPublished(context, msg->data.size());
+    context.compressed_publisher->publish(msg);
+    context.compression_diagnostics->add(num_pixels * sizeof(uint16_t), msg->data.size(), encode_sec);
+}
+
+void BaseRealSenseNode::publishShm(const cv::Mat& image, const ros::Time& t, StreamContext& context)
+{
+    if (!image.isContinuous())
+        return;
+    size_t size(image.total() * image.elemSize());
+    if (!context.shm_ring || context.shm_ring->slotSize() != size)
+    {
+        // A new name for every frame size, so that readers map the new ring instead of keeping the old one.
+        std::string segment(context.shm_segment + "_" + std::to_string(size));
+        try
+        {
+            context.shm_ring = std::make_shared<ShmRingWriter>(segment, std::max(_shm_slots, 2), size);
+        }
+        catch(const std::runtime_error& ex)
+        {
+            ROS_ERROR_STREAM_THROTTLE(5, ex.what());
+            return;
+        }
+    }
+
+    ShmFramePtr msg(new ShmFrame());
+    context.shm_ring->write(image.data, size, msg->slot, msg->sequence);
+    msg->header.frame_id = *context.optical_frame_id;
+    msg->header.stamp = t;
+    msg->header.seq = context.seq;
+    msg->segment = context.shm_ring->name();
+    msg->size = size;
+    msg->height = image.rows;
+    msg->width = image.cols;
+    msg->encoding = *context.encoding;
+    msg->is_bigendian = false;
+    msg->step = image.cols * image.elemSize();
+    countPublished(context, size);
+    context.shm_publisher->publish(msg);
+}
+
+void BaseRealSenseNode::setupJpegEncoders()
+{
+    // Color frames are encoded in parallel, on the shared worker pool or on threads of their own, so a slow
+    // encoding never holds up the callback of the other streams. One strand per encoder keeps every encoder busy
+    // with at most one frame, and drops the older frames when the encoders fall behind.
+    size_t encoders_num(COLOR_JPEG_ENCODERS);
+    if (_worker_pool)
+    {
+        encoders_num = std::min(encoders_num, _worker_pool->size());
+    }
+    else
+    {
+        _jpeg_worker_pool = std::make_shared<WorkerPool>(encoders_num, 1);
+    }
+    WorkerPool& worker_pool(_worker_pool ? *_worker_pool : *_jpeg_worker_pool);
+    _jpeg_encoder_pool = std::make_shared<JpegEncoderPool>(encoders_num, _color_jpeg_quality, _color_jpeg_scale);
+    for (size_t i = 0; i < encoders_num; i++)
+    {
+        auto strand = std::make_shared<Strand>(worker_pool);
+        _jpeg_strands.push_back(strand);
+        _strands.push_back(strand);
+    }
+    ROS_INFO_STREAM("JPEG color compression: quality " << _jpeg_encoder_pool->quality() << ", scale " << _jpeg_encoder_pool->scale() << ", " << encoders_num << " encoders");
+}
+
+void BaseRealSenseNode::postJpeg(rs2::video_frame frame, const ros::Time& t, StreamContext& context)
+{
+    if (frame.get_bytes_per_pixel() != 3)
+    {
+        ROS_WARN_STREAM_ONCE("JPEG color compression needs RGB8 or BGR8 color frames. Got " << rs2_format_to_string(frame.get_profile().format()));
+        return;
+    }
+    // The task holds the frame, so the encoder reads the librealsense buffer directly.
+    int seq(context.seq);
+    auto ticket(std::make_shared<JpegTicket>(*this, context));
+    auto& strand = _jpeg_strands[_next_jpeg_strand++ % _jpeg_strands.size()];
+    if (!strand->post([this, frame, t, seq, ticket, &context](){ encodeJpeg(frame, t, seq, *ticket->slot, context); }))
+    {
+        context.compression_diagnostics->addDropped();
+    }
+}
+
+BaseRealSenseNode::JpegTicket::JpegTicket(BaseRealSenseNode& node, StreamContext& context) :
+    slot(std::make_shared<JpegSlot>()),
+    _node(node),
+    _context(context)
+{
+    slot->is_done = false;
+    std::lock_guard<std::mutex> lock(_node._jpeg_slots_mutex);
+    _node._jpeg_slots.push_back(slot);
+}
+
+BaseRealSenseNode::JpegTicket::~JpegTicket()
+{
+    _node.finishJpeg(slot, _context);
+}
+
+// Publishes the frames that are next in line and done.
+void BaseRealSenseNode::finishJpeg(const std::shared_ptr<JpegSlot>& slot, StreamContext& context)
+{
+    std::lock_guard<std::mutex> lock(_jpeg_slots_mutex);
+    slot->is_done = true;
+    while (!_jpeg_slots.empty() && _jpeg_slots.front()->is_done)
+    {
+        if (_jpeg_slots.front()->msg)
+        {
+            countPublished(context, _jpeg_slots.front()->msg->data.size());
+            context.compressed_publisher->publish(_jpeg_slots.front()->msg);
+        }
+        _jpeg_slots.pop_front();
+    }
+}
+
+void BaseRealSenseNode::encodeJpeg(rs2::video_frame frame, const ros::Time& t, int seq, JpegSlot& slot, StreamContext& context)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    bool is_bgr(frame.get_profile().format() == RS2_FORMAT_BGR8);
+    sensor_msgs::CompressedImagePtr msg(new sensor_msgs::CompressedImage());
+    if (!_jpeg_encoder_pool->encode(static_cast<const uint8_t*>(frame.get_data()), frame.get_width(), frame.get_height(),
+                                    frame.get_stride_in_bytes(), is_bgr, msg->data))
+    {
+        context.compression_diagnostics->addDropped();
+        ROS_WARN_STREAM_THROTTLE(5, "JPEG encoding of the color image failed.");
+        return;
+    }
+    double encode_sec(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+
+    msg->header.frame_id = *context.optical_frame_id;
+    msg->header.stamp = t;
+    msg->header.seq = seq;
+    msg->format = std::string(is_bgr ? sensor_msgs::image_encodings::BGR8 : sensor_msgs::image_encodings::RGB8) + "; jpeg compressed bgr8";
+    context.compression_diagnostics->add(frame.get_width() * frame.get_height() * 3, msg->data.size(), encode_sec);
+    slot.msg = msg;
+}
+
 bool BaseRealSenseNode::getEnabledProfile(const stream_index_pair& stream_index, rs2::stream_profile& profile)
     {
         // Assuming that all D400 SKUs have depth sensor
@@ -2430,8 +3581,44 @@ void BaseRealSenseNode::startMonitoring()
 {
     for (rs2_option option : _monitor_options)
     {
-        _temperature_nodes.push_back({option, std::make_shared<TemperatureDiagnostics>(rs2_option_to_string(option), _serial_no )});
+        _temperature_nodes.push_back({option, std::make_shared<TemperatureDiagnostics>()});
+    }
+    // One updater, so one publisher, for all the diagnostics of the node. The statuses are named after the camera's
+    // namespace rather than the process, which several cameras may share (e.g. /camera1: depth).
+    _diagnostics_updater = std::make_shared<diagnostic_updater::Updater>(_node_handle, _pnh, _node_handle.getNamespace());
+    for (auto& image_publisher : _image_publishers)
+    {
+        _diagnostics_updater->add(image_publisher.second.second->name(), image_publisher.second.second.get(), &StreamDiagnostics::diagnostics);
+    }
+    for (auto& image_publisher : _depth_aligned_image_publishers)
+    {
+        _diagnostics_updater->add(image_publisher.second.second->name(), image_publisher.second.second.get(), &StreamDiagnostics::diagnostics);
+    }
+    for (OptionTemperatureDiag& option_diag : _temperature_nodes)
+    {
+        _diagnostics_updater->add(rs2_option_to_string(option_diag.first), option_diag.second.get(), &TemperatureDiagnostics::diagnostics);
+    }
+    _diagnostics_updater->add("Hardware clock", this, &BaseRealSenseNode::clockDiagnostics);
+    _diagnostics_updater->add("Recorder", this, &BaseRealSenseNode::recorderDiagnostics);
+    if (AllocationTracker::isEnabled())
+    {
+        _diagnostics_updater->add("Allocations", &_allocation_tracker, &AllocationTracker::diagnostics);
+    }
+    if (_sync_frames)
+    {
+        _diagnostics_updater->add("Frameset syncer", &_syncer, &FramesetSyncer::diagnostics);
+    }
+    if (_perf_counters.isEnabled())
+    {
+        _diagnostics_updater->add("Performance counters", &_perf_counters, &PerfCounters::diagnostics);
     }
+    for (auto& compression_diagnostics : _compression_diagnostics)
+    {
+        std::string name(std::string(rs2_stream_to_string(compression_diagnostics.first.first)) + " compression");
+        _diagnostics_updater->add(name, compression_diagnostics.second.get(), &CompressionDiagnostics::diagnostics);
+    }
+    _diagnostics_updater->setHardwareID(_serial_no);
+    updateTopicDemand();
 
     int time_interval(1000);
     std::function<void()> func = [this, time_interval](){
@@ -2441,17 +3628,80 @@ void BaseRealSenseNode::startMonitoring()
             _cv_monitoring.wait_for(lock, std::chrono::milliseconds(time_interval), [&]{return !_is_running;});
             if (_is_running)
             {
+                TraceSpan span("monitor");
                 publish_temperature();
-                publish_frequency_update();
+                _diagnostics_updater->update();
+                if (_lazy_streaming)
+                    updateLazyStreaming();
+                else
+                    updateTopicDemand();
             }
         }
     };
     _monitoring_t = std::make_shared<std::thread>(func);
 }
 
+void BaseRealSenseNode::setupMetrics()
+{
+    // The temperature nodes and the worker pools are set for the node's lifetime by now.
+    _metrics.collector("realsense_temperature_celsius", MetricsRegistry::GAUGE, "Temperatures of the camera.", [this](MetricsRegistry::Samples& samples)
+    {
+        for (const OptionTemperatureDiag& option_diag : _temperature_nodes)
+            samples.push_back({std::string("sensor=\"") + rs2_option_to_string(option_diag.first) + "\"", option_diag.second->value()});
+    });
+    _metrics.collector("realsense_worker_pool_pending_tasks", MetricsRegistry::GAUGE, "Tasks queued on the worker pools.", [this](MetricsRegistry::Samples& samples)
+    {
+        if (_worker_pool)
+            samples.push_back({"pool=\"frames\"", static_cast<double>(_worker_pool->pendingTasks())});
+        if (_jpeg_worker_pool)
+            samples.push_back({"pool=\"jpeg\"", static_cast<double>(_jpeg_worker_pool->pendingTasks())});
+        if (_rvl_worker_pool)
+            samples.push_back({"pool=\"rvl\"", static_cast<double>(_rvl_worker_pool->pendingTasks())});
+    });
+    _metrics.collector("realsense_thread_cpu_seconds_total", MetricsRegistry::COUNTER, "CPU time of the threads of the process.", collectThreadCpu);
+
+    if (_metrics_port > 0)
+    {
+        try
+        {
+            _metrics_endpoint = std::make_shared<MetricsEndpoint>(_metrics_port, [this](){ return _metrics.exposition(); });
+            ROS_INFO_STREAM("Metrics in the Prometheus format on http://127.0.0.1:" << _metrics_port << "/metrics");
+        }
+        catch(const std::runtime_error& ex)
+        {
+            ROS_ERROR_STREAM(ex.what());
+        }
+    }
+    if (_metrics_rate > 0)
+    {
+        _metrics_publisher = _node_handle.advertise<Metrics>("metrics", 1);
+        _metrics_t = std::make_shared<std::thread>([this](){ publishMetrics(); });
+    }
+}
+
+void BaseRealSenseNode::publishMetrics()
+{
+    Metrics msg;
+    std::mutex mu;
+    std::unique_lock<std::mutex> lock(mu);
+    while (ros::ok() && _is_running)
+    {
+        _cv_metrics.wait_for(lock, std::chrono::milliseconds((int)(1000.0/_metrics_rate)), [&]{return (!(_is_running));});
+        if (!_is_running || 0 == _metrics_publisher.getNumSubscribers())
+            continue;
+        _metrics.sample(msg.names, msg.values);
+        msg.header.stamp = ros::Time::now();
+        _metrics_publisher.publish(msg);
+    }
+}
+
 void BaseRealSenseNode::publish_temperature()
 {
-    rs2::options sensor(_sensors[_base_stream]);
+    rs2::sensor sensor;
+    {
+        std::lock_guard<std::mutex> lock(_sensors_mutex);
+        sensor = _sensors[_base_stream];
+    }
     for (OptionTemperatureDiag option_diag : _temperature_nodes)
     {
         rs2_option option(option_diag.first);
@@ -2470,21 +3720,84 @@ void BaseRealSenseNode::publish_temperature()
     }
 }
 
-void BaseRealSenseNode::publish_frequency_update()
+void BaseRealSenseNode::clockDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    HardwareClockModel::Status clock_status(_clock_model.getStatus());
+    if (!clock_status.is_valid)
+    {
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Not in use");
+        return;
+    }
+    status.summary(clock_status.residual_ms < 1.0 ? diagnostic_msgs::DiagnosticStatus::OK : diagnostic_msgs::DiagnosticStatus::WARN,
+                   clock_status.residual_ms < 1.0 ? "OK" : "High residual error");
+    status.add("Offset [s]", clock_status.offset_sec);
+    status.add("Skew [ppm]", clock_status.skew_ppm);
+    status.add("Residual error [ms]", clock_status.residual_ms);
+    status.add("Last latency [ms]", clock_status.latency_ms);
+    status.add("Clock resets", clock_status.num_resets);
+}
+
+void BaseRealSenseNode::recorderDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
 {
-    std::chrono::milliseconds timespan(1);
-    for (auto &image_publisher : _image_publishers)
+    RawRecorder::Status recorder_status(_raw_recorder->getStatus());
+    if (!recorder_status.is_recording)
     {
-        image_publisher.second.second->update();
-        std::this_thread::sleep_for(timespan);
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Not recording");
+        return;
     }
+    status.summary(recorder_status.frames_dropped == 0 ? diagnostic_msgs::DiagnosticStatus::OK : diagnostic_msgs::DiagnosticStatus::WARN,
+                   recorder_status.frames_dropped == 0 ? "Recording" : "Recording, frames dropped");
+    status.add("Directory", recorder_status.directory);
+    status.add("Write speed [MB/s]", recorder_status.write_mb_per_sec);
+    status.add("Backlog frames", recorder_status.backlog_frames);
+    status.add("Backlog [MB]", recorder_status.backlog_bytes / 1e6);
+    status.add("Frames written", recorder_status.frames_written);
+    status.add("Frames dropped", recorder_status.frames_dropped);
+    status.add("Written [MB]", recorder_status.bytes_written / 1e6);
+    status.add("Segments", recorder_status.segments);
+}
+
+void CompressionDiagnostics::add(size_t raw_bytes, size_t compressed_bytes, double encode_sec)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frames++;
+    _raw_bytes += raw_bytes;
+    _compressed_bytes += compressed_bytes;
+    _encode_sec += encode_sec;
+}
+
+void CompressionDiagnostics::addDropped()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _dropped_frames++;
 }
 
-TemperatureDiagnostics::TemperatureDiagnostics(std::string name, std::string serial_no)
+void CompressionDiagnostics::diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (0 == _frames && 0 == _dropped_frames)
+    {
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Not in use");
+        return;
+    }
+    if (0 == _dropped_frames)
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Frames dropped");
+    status.add("Frames", _frames);
+    status.add("Dropped frames", _dropped_frames);
+    if (0 != _frames)
     {
-        _updater.add(name, this, &TemperatureDiagnostics::diagnostics);
-        _updater.setHardwareID(serial_no);
+        status.add("Compression ratio", static_cast<double>(_raw_bytes) / _compressed_bytes);
+        status.add("Encoding speed [MB/s]", _raw_bytes / 1e6 / _encode_sec);
+        status.add("Encoding time per frame [ms]", _encode_sec * 1000 / _frames);
     }
+    _frames = 0;
+    _dropped_frames = 0;
+    _raw_bytes = 0;
+    _compressed_bytes = 0;
+    _encode_sec = 0;
+}
 
 void TemperatureDiagnostics::diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
 {
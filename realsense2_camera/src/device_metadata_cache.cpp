@@ -0,0 +1,345 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/device_metadata_cache.h"
+#include <ros/ros.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <sys/stat.h>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    const char* CACHE_FORMAT = "realsense2_camera metadata cache v2";
+
+    std::vector<std::string> split(const std::string& line)
+    {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, '\t'))
+        {
+            fields.push_back(field);
+        }
+        return fields;
+    }
+
+    std::string sanitize(std::string str)
+    {
+        std::replace(str.begin(), str.end(), '\t', ' ');
+        std::replace(str.begin(), str.end(), '\n', ' ');
+        return str;
+    }
+
+    float toFloat(const std::string& str)
+    {
+        size_t pos(0);
+        float value = std::stof(str, &pos);
+        if (pos != str.size())
+            throw std::invalid_argument("Bad number: " + str);
+        return value;
+    }
+
+    bool makeDirs(const std::string& path)
+    {
+        for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+        {
+            std::string dir(path.substr(0, pos));
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+                return false;
+            if (pos == std::string::npos)
+                return true;
+        }
+    }
+}
+
+DeviceMetadataCache::DeviceMetadataCache(const std::string& cache_dir, rs2::device dev) :
+    _is_valid(false), _is_dirty(false)
+{
+    std::string serial_no(dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
+    std::string fw_ver(dev.supports(RS2_CAMERA_INFO_FIRMWARE_VERSION) ? dev.get_info(RS2_CAMERA_INFO_FIRMWARE_VERSION) : "none");
+    _file_path = (cache_dir.empty() ? defaultCacheDir() : cache_dir) + "/" + serial_no + ".cache";
+    _header = std::string(CACHE_FORMAT) + "\t" + serial_no + "\t" + fw_ver + "\t" + RS2_API_VERSION_STR + "\t" + calibrationFingerprint(dev);
+    load();
+}
+
+std::string DeviceMetadataCache::calibrationFingerprint(rs2::device dev)
+{
+    // A few round trips: the intrinsics of the first video profile of each sensor, and the extrinsics from the first
+    // of those profiles to the others. Calibration updates change at least one of them.
+    std::stringstream calibration;
+    calibration << std::setprecision(std::numeric_limits<float>::max_digits10);
+    rs2::stream_profile first_profile;
+    for (rs2::sensor& sensor : dev.query_sensors())
+    {
+        try
+        {
+            for (rs2::stream_profile& profile : sensor.get_stream_profiles())
+            {
+                if (!profile.is<rs2::video_stream_profile>())
+                    continue;
+                rs2_intrinsics intrinsics(profile.as<rs2::video_stream_profile>().get_intrinsics());
+                calibration << intrinsics.ppx << " " << intrinsics.ppy << " " << intrinsics.fx << " " << intrinsics.fy;
+                for (int i = 0; i < 5; i++)
+                    calibration << " " << intrinsics.coeffs[i];
+                if (!first_profile)
+                {
+                    first_profile = profile;
+                }
+                else
+                {
+                    rs2_extrinsics extrinsics(first_profile.get_extrinsics_to(profile));
+                    for (int i = 0; i < 9; i++)
+                        calibration << " " << extrinsics.rotation[i];
+                    for (int i = 0; i < 3; i++)
+                        calibration << " " << extrinsics.translation[i];
+                }
+                calibration << "\n";
+                break;
+            }
+        }
+        catch(const std::exception& ex)
+        {
+            ROS_DEBUG_STREAM("No calibration fingerprint of a sensor: " << ex.what());
+        }
+    }
+    std::stringstream fingerprint;
+    fingerprint << std::hex << std::hash<std::string>()(calibration.str());
+    return fingerprint.str();
+}
+
+std::string DeviceMetadataCache::defaultCacheDir()
+{
+    const char* ros_home = getenv("ROS_HOME");
+    if (ros_home)
+        return std::string(ros_home) + "/realsense2_camera";
+    const char* home = getenv("HOME");
+    return std::string(home ? home : "/tmp") + "/.ros/realsense2_camera";
+}
+
+std::string DeviceMetadataCache::profileKey(const rs2::stream_profile& profile)
+{
+    std::stringstream key;
+    key << rs2_stream_to_string(profile.stream_type()) << "_" << profile.stream_index() << "_" << rs2_format_to_string(profile.format());
+    if (profile.is<rs2::video_stream_profile>())
+    {
+        auto video_profile = profile.as<rs2::video_stream_profile>();
+        key << "_" << video_profile.width() << "x" << video_profile.height();
+    }
+    key << "_" << profile.fps();
+    return key.str();
+}
+
+void DeviceMetadataCache::load()
+{
+    std::ifstream in(_file_path);
+    if (!in.is_open())
+    {
+        ROS_INFO_STREAM("No metadata cache found at " << _file_path << ". It will be created.");
+        return;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != _header)
+    {
+        // The fingerprint is the last field of the header.
+        if (line.substr(0, line.rfind('\t')) == _header.substr(0, _header.rfind('\t')))
+            ROS_WARN_STREAM("The calibration of the device changed since the metadata cache " << _file_path << " was written. It will be rewritten.");
+        else
+            ROS_INFO_STREAM("Metadata cache " << _file_path << " belongs to another firmware or librealsense version. It will be rewritten.");
+        _is_dirty = true;
+        return;
+    }
+
+    try
+    {
+        std::vector<OptionMetadata>* module_options(nullptr);
+        while (std::getline(in, line))
+        {
+            auto fields = split(line);
+            if (fields.empty())
+                continue;
+            if (fields[0] == "module" && fields.size() == 2)
+            {
+                module_options = &_options[fields[1]];
+            }
+            else if (fields[0] == "option" && fields.size() >= 9 && module_options)
+            {
+                OptionMetadata meta;
+                meta.option = static_cast<rs2_option>(std::stoi(fields[1]));
+                meta.is_checkbox = (fields[2] == "1");
+                meta.range = rs2::option_range{toFloat(fields[3]), toFloat(fields[4]), toFloat(fields[5]), toFloat(fields[6])};
+                meta.description = fields[7];
+                size_t enum_size = std::stoul(fields[8]);
+                if (fields.size() != 9 + 2 * enum_size)
+                    throw std::runtime_error("Bad option line");
+                for (size_t i = 0; i < enum_size; i++)
+                {
+                    meta.enum_dict[fields[9 + 2 * i]] = std::stoi(fields[10 + 2 * i]);
+                }
+                module_options->push_back(meta);
+            }
+            else if (fields[0] == "intrinsics" && fields.size() == 15)
+            {
+                rs2_intrinsics intrinsics;
+                intrinsics.width = std::stoi(fields[2]);
+                intrinsics.height = std::stoi(fields[3]);
+                intrinsics.ppx = toFloat(fields[4]);
+                intrinsics.ppy = toFloat(fields[5]);
+                intrinsics.fx = toFloat(fields[6]);
+                intrinsics.fy = toFloat(fields[7]);
+                intrinsics.model = static_cast<rs2_distortion>(std::stoi(fields[8]));
+                for (int i = 0; i < 5; i++)
+                    intrinsics.coeffs[i] = toFloat(fields[9 + i]);
+                _intrinsics[fields[1]] = intrinsics;
+            }
+            else if (fields[0] == "extrinsics" && fields.size() == 14)
+            {
+                rs2_extrinsics extrinsics;
+                for (int i = 0; i < 9; i++)
+                    extrinsics.rotation[i] = toFloat(fields[2 + i]);
+                for (int i = 0; i < 3; i++)
+                    extrinsics.translation[i] = toFloat(fields[11 + i]);
+                _extrinsics[fields[1]] = extrinsics;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown line: " + line);
+            }
+        }
+    }
+    catch(const std::exception& ex)
+    {
+        ROS_WARN_STREAM("Metadata cache " << _file_path << " is corrupted (" << ex.what() << "). It will be rewritten.");
+        _options.clear();
+        _intrinsics.clear();
+        _extrinsics.clear();
+        _is_dirty = true;
+        return;
+    }
+    _is_valid = true;
+    ROS_INFO_STREAM("Using metadata cache " << _file_path);
+}
+
+void DeviceMetadataCache::save()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_is_dirty)
+        return;
+
+    std::string dir(_file_path.substr(0, _file_path.rfind('/')));
+    if (!makeDirs(dir))
+    {
+        ROS_WARN_STREAM("Failed to create metadata cache directory " << dir);
+        return;
+    }
+    // Write to a temporary file and rename it, so that concurrent nodes never read a partial cache.
+    std::string tmp_path(_file_path + ".tmp");
+    {
+        std::ofstream out(tmp_path);
+        out << std::setprecision(std::numeric_limits<float>::max_digits10);
+        out << _header << "\n";
+        for (auto& module : _options)
+        {
+            out << "module\t" << module.first << "\n";
+            for (auto& meta : module.second)
+            {
+                out << "option\t" << int(meta.option) << "\t" << (meta.is_checkbox ? 1 : 0) << "\t"
+                    << meta.range.min << "\t" << meta.range.max << "\t" << meta.range.def << "\t" << meta.range.step << "\t"
+                    << sanitize(meta.description) << "\t" << meta.enum_dict.size();
+                for (auto& kv : meta.enum_dict)
+                {
+                    out << "\t" << sanitize(kv.first) << "\t" << kv.second;
+                }
+                out << "\n";
+            }
+        }
+        for (auto& kv : _intrinsics)
+        {
+            const rs2_intrinsics& intrinsics(kv.second);
+            out << "intrinsics\t" << kv.first << "\t" << intrinsics.width << "\t" << intrinsics.height << "\t"
+                << intrinsics.ppx << "\t" << intrinsics.ppy << "\t" << intrinsics.fx << "\t" << intrinsics.fy << "\t" << int(intrinsics.model);
+            for (int i = 0; i < 5; i++)
+                out << "\t" << intrinsics.coeffs[i];
+            out << "\n";
+        }
+        for (auto& kv : _extrinsics)
+        {
+            out << "extrinsics\t" << kv.first;
+            for (int i = 0; i < 9; i++)
+                out << "\t" << kv.second.rotation[i];
+            for (int i = 0; i < 3; i++)
+                out << "\t" << kv.second.translation[i];
+            out << "\n";
+        }
+        if (!out.good())
+        {
+            ROS_WARN_STREAM("Failed to write metadata cache " << tmp_path);
+            return;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), _file_path.c_str()) != 0)
+    {
+        ROS_WARN_STREAM("Failed to write metadata cache " << _file_path);
+        return;
+    }
+    _is_dirty = false;
+    ROS_INFO_STREAM("Metadata cache saved to " << _file_path);
+}
+
+bool DeviceMetadataCache::getOptions(const std::string& module_name, std::vector<OptionMetadata>& options) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _options.find(module_name);
+    if (it == _options.end())
+        return false;
+    options = it->second;
+    return true;
+}
+
+void DeviceMetadataCache::setOptions(const std::string& module_name, const std::vector<OptionMetadata>& options)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _options[module_name] = options;
+    _is_dirty = true;
+}
+
+bool DeviceMetadataCache::getIntrinsics(const rs2::video_stream_profile& profile, rs2_intrinsics& intrinsics) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _intrinsics.find(profileKey(profile));
+    if (it == _intrinsics.end())
+        return false;
+    intrinsics = it->second;
+    return true;
+}
+
+void DeviceMetadataCache::setIntrinsics(const rs2::video_stream_profile& profile, const rs2_intrinsics& intrinsics)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _intrinsics[profileKey(profile)] = intrinsics;
+    _is_dirty = true;
+}
+
+bool DeviceMetadataCache::getExtrinsics(const rs2::stream_profile& from, const rs2::stream_profile& to, rs2_extrinsics& extrinsics) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _extrinsics.find(profileKey(from) + ">" + profileKey(to));
+    if (it == _extrinsics.end())
+        return false;
+    extrinsics = it->second;
+    return true;
+}
+
+void DeviceMetadataCache::setExtrinsics(const rs2::stream_profile& from, const rs2::stream_profile& to, const rs2_extrinsics& extrinsics)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _extrinsics[profileKey(from) + ">" + profileKey(to)] = extrinsics;
+    _is_dirty = true;
+}
@@ -0,0 +1,149 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/flight_recorder.h"
+#include <ros/ros.h>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace realsense2_camera;
+
+FlightRecorder::FlightRecorder(size_t size, double seconds) :
+    _size(size),
+    _duration_ns(static_cast<int64_t>(seconds * 1e9)),
+    _buffer(new uint8_t[size]),
+    // A record is at least its header, and the records held don't overlap in the ring.
+    _entries_capacity(size / sizeof(RawRecordHeader) + 1),
+    _entries(new Entry[_entries_capacity]),
+    _first_entry(0),
+    _entries_count(0),
+    _write_offset(0),
+    _frames_dropped(0),
+    _is_dumping(false),
+    _pinned_begin(0),
+    _pinned_end(0),
+    _frames_dropped_dumping(0)
+{
+}
+
+void FlightRecorder::record(const rs2::frame& frame)
+{
+    int64_t arrival_time_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    RawRecordHeader header;
+    RawRecordMetadata metadata[RS2_FRAME_METADATA_COUNT];
+    size_t record_size(describeRawRecord(frame, arrival_time_ns, header, metadata));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (record_size > _size)
+    {
+        ROS_WARN_STREAM_THROTTLE(5, "A frame of " << record_size << " bytes doesn't fit in the flight recorder. " << ++_frames_dropped << " frames were dropped so far.");
+        return;
+    }
+    if (_is_dumping && isPinned(_write_offset + record_size > _size ? 0 : _write_offset, record_size))
+    {
+        _frames_dropped_dumping++;
+        return;
+    }
+    if (_write_offset + record_size > _size)
+    {
+        // Wrap around. The frames between here and the end are the oldest.
+        while (_entries_count && entry(0).offset >= _write_offset)
+            popEntry();
+        _write_offset = 0;
+    }
+    // The oldest frame is always the next one in the ring.
+    while (_entries_count && entry(0).offset < _write_offset + record_size &&
+           _write_offset < entry(0).offset + entry(0).size)
+        popEntry();
+
+    copyRawRecord(frame, header, metadata, _buffer.get() + _write_offset);
+    entry(_entries_count++) = {_write_offset, record_size, arrival_time_ns};
+    _write_offset += record_size;
+    dropOlderThan(arrival_time_ns - _duration_ns);
+}
+
+// Called with _mutex locked.
+void FlightRecorder::popEntry()
+{
+    _first_entry = (_first_entry + 1) % _entries_capacity;
+    _entries_count--;
+}
+
+// Called with _mutex locked. Whether [offset, offset + size) overlaps the bytes being dumped.
+bool FlightRecorder::isPinned(size_t offset, size_t size) const
+{
+    if (_pinned_begin < _pinned_end)
+        return offset < _pinned_end && _pinned_begin < offset + size;
+    // Wrapped around, or empty when begin == end.
+    return _pinned_begin != _pinned_end && (offset < _pinned_end || _pinned_begin < offset + size);
+}
+
+// Called with _mutex locked.
+void FlightRecorder::dropOlderThan(int64_t time_ns)
+{
+    while (_entries_count && entry(0).arrival_time_ns < time_ns)
+        popEntry();
+}
+
+size_t FlightRecorder::dump(const std::string& directory)
+{
+    std::lock_guard<std::mutex> dump_lock(_dump_mutex);
+    createRecordingDirectory(directory);
+
+    // Only the list of the frames is copied under the lock. Their bytes stay pinned in the ring while they are
+    // written, rather than hold up the sensors for the disk.
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        dropOlderThan(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - _duration_ns);
+        entries.reserve(_entries_count);
+        for (size_t index = 0; index < _entries_count; index++)
+            entries.push_back(entry(index));
+        if (entries.empty())
+            return 0;
+        _pinned_begin = entries.front().offset;
+        _pinned_end = entries.back().offset + entries.back().size;
+        // A full ring: the newest record ends where the oldest one begins.
+        if (_pinned_end == _pinned_begin)
+        {
+            _pinned_begin = 0;
+            _pinned_end = _size;
+        }
+        _frames_dropped_dumping = 0;
+        _is_dumping = true;
+    }
+    struct Unpin
+    {
+        FlightRecorder& recorder;
+        ~Unpin()
+        {
+            std::lock_guard<std::mutex> lock(recorder._mutex);
+            recorder._is_dumping = false;
+            if (recorder._frames_dropped_dumping)
+                ROS_WARN_STREAM("The flight recorder dropped " << recorder._frames_dropped_dumping << " frames while it was dumped.");
+        }
+    } unpin{*this};
+
+    std::string segment_path(directory + "/segment_00000");
+    std::ofstream segment(segment_path + ".raw", std::ios::binary | std::ios::trunc);
+    std::ofstream index(segment_path + ".idx", std::ios::binary | std::ios::trunc);
+    if (!segment.is_open() || !index.is_open())
+        throw std::runtime_error("Failed to create " + segment_path);
+    size_t offset(0);
+    for (const Entry& entry : entries)
+    {
+        const uint8_t* record(_buffer.get() + entry.offset);
+        segment.write(reinterpret_cast<const char*>(record), entry.size);
+        RawRecordHeader header;
+        std::memcpy(&header, record, sizeof(header));
+        RawIndexEntry index_entry(makeRawIndexEntry(header, offset, entry.size));
+        index.write(reinterpret_cast<const char*>(&index_entry), sizeof(index_entry));
+        offset += entry.size;
+    }
+    if (!segment.good() || !index.good())
+        throw std::runtime_error("Failed to write " + segment_path);
+    return entries.size();
+}
@@ -0,0 +1,252 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/frameset_syncer.h"
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // Framesets pending at once. Beyond, the oldest is emitted partial, e.g. when a stream stopped.
+    const size_t MAX_PENDING_FRAMESETS = 8;
+}
+
+FramesetSyncer::FramesetSyncer(MetricsRegistry& metrics) :
+    _settings{0, 0, RS2_STREAM_ANY},
+    _composer([this](rs2::frame, rs2::frame_source& source)
+    {
+        source.frame_ready(source.allocate_composite_frame(_composed));
+    }),
+    _is_dispatching(false),
+    _last_emitted_timestamp(-std::numeric_limits<double>::infinity()),
+    _is_running(false),
+    _complete(metrics.counter("realsense_sync_framesets_total", "result=\"complete\"", "Framesets of the syncer.")),
+    _partial(metrics.counter("realsense_sync_framesets_total", "result=\"partial\"", "Framesets of the syncer.")),
+    _dropped(metrics.counter("realsense_sync_framesets_total", "result=\"dropped\"", "Framesets of the syncer.")),
+    _late_frames(metrics.counter("realsense_sync_late_frames_total", "", "Frames dropped because their frameset was already emitted.")),
+    _wait(metrics.histogram("realsense_sync_wait_seconds", "", "Wait of a frameset from its first frame to its emission.",
+                            MetricsRegistry::durationBounds())),
+    _last_complete(0), _last_partial(0), _last_dropped(0), _last_late_frames(0)
+{
+}
+
+FramesetSyncer::~FramesetSyncer()
+{
+    stop();
+}
+
+void FramesetSyncer::start(const Settings& settings, const std::vector<stream_index_pair>& streams, std::function<void(rs2::frame)> callback)
+{
+    stop();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _settings = settings;
+    _streams = streams;
+    _composer.start(callback);
+    _last_emitted_timestamp = -std::numeric_limits<double>::infinity();
+    _is_running = true;
+    _deadline_t = std::thread([this](){ expireDeadlines(); });
+}
+
+void FramesetSyncer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_is_running)
+            return;
+        _is_running = false;
+        _pending.clear();
+        _ready.clear();
+    }
+    _cv.notify_one();
+    _deadline_t.join();
+}
+
+void FramesetSyncer::operator()(rs2::frame frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_is_running)
+            return;
+        if (frame.is<rs2::frameset>())
+        {
+            for (const rs2::frame& f : frame.as<rs2::frameset>())
+                add(f);
+        }
+        else
+        {
+            add(frame);
+        }
+    }
+    dispatch();
+}
+
+// Called with _mutex locked.
+void FramesetSyncer::add(const rs2::frame& frame)
+{
+    rs2::stream_profile profile(frame.get_profile());
+    auto stream = std::find(_streams.begin(), _streams.end(), stream_index_pair(profile.stream_type(), profile.stream_index()));
+    if (stream == _streams.end())
+        return;
+    size_t slot(stream - _streams.begin());
+    double timestamp(frame.get_timestamp());
+
+    if (timestamp < _last_emitted_timestamp - _settings.tolerance_ms)
+    {
+        _late_frames.add();
+        return;
+    }
+    size_t index(0);
+    for (; index < _pending.size(); index++)
+    {
+        Frameset& frameset(_pending[index]);
+        if (!frameset.frames[slot] && std::fabs(frameset.timestamp - timestamp) <= _settings.tolerance_ms)
+            break;
+        if (frameset.timestamp > timestamp)
+        {
+            // A frameset of its own, in timestamp order.
+            _pending.insert(_pending.begin() + index, Frameset{timestamp, std::chrono::steady_clock::now(), std::vector<rs2::frame>(_streams.size()), 0});
+            if (_pending.size() == 1)
+                _cv.notify_one();
+            break;
+        }
+    }
+    if (index == _pending.size())
+    {
+        _pending.push_back(Frameset{timestamp, std::chrono::steady_clock::now(), std::vector<rs2::frame>(_streams.size()), 0});
+        if (_pending.size() == 1)
+            _cv.notify_one();
+    }
+
+    Frameset& frameset(_pending[index]);
+    frameset.frames[slot] = frame;
+    frameset.frames_num++;
+    if (frameset.frames_num == _streams.size())
+        emitUpTo(index);
+    else if (_pending.size() > MAX_PENDING_FRAMESETS)
+        emitUpTo(0);
+}
+
+// Called with _mutex locked.
+void FramesetSyncer::emitUpTo(size_t index)
+{
+    for (size_t emitted = 0; emitted <= index; emitted++)
+    {
+        emit(_pending.front());
+        _pending.pop_front();
+    }
+}
+
+// Called with _mutex locked.
+void FramesetSyncer::emit(Frameset& frameset)
+{
+    _last_emitted_timestamp = std::max(_last_emitted_timestamp, frameset.timestamp);
+    _wait.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - frameset.arrival).count());
+    if (frameset.frames_num < _streams.size())
+    {
+        if (RS2_STREAM_ANY != _settings.preferred_stream &&
+            std::none_of(frameset.frames.begin(), frameset.frames.end(), [this](const rs2::frame& f)
+                         { return f && f.get_profile().stream_type() == _settings.preferred_stream; }))
+        {
+            _dropped.add();
+            return;
+        }
+        _partial.add();
+    }
+    else
+    {
+        _complete.add();
+    }
+    _ready.push_back(std::move(frameset.frames));
+}
+
+// The thread that finds no other one dispatching hands over every frameset emitted until there are none left, the
+// ones emitted by the other threads meanwhile included. So the framesets keep their order, and the threads that
+// emit while a frameset is processed don't wait for it.
+void FramesetSyncer::dispatch()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_is_dispatching)
+        return;
+    _is_dispatching = true;
+    while (!_ready.empty())
+    {
+        std::vector<rs2::frame> frames(std::move(_ready.front()));
+        _ready.pop_front();
+        lock.unlock();
+        // _composed is only touched by the dispatching thread.
+        rs2::frame first;
+        for (rs2::frame& frame : frames)
+        {
+            if (frame)
+            {
+                if (!first)
+                    first = frame;
+                _composed.push_back(std::move(frame));
+            }
+        }
+        try
+        {
+            _composer.invoke(first);
+        }
+        catch(const std::exception& ex)
+        {
+            ROS_ERROR_STREAM("Failed to dispatch a frameset: " << ex.what());
+        }
+        _composed.clear();
+        lock.lock();
+    }
+    _is_dispatching = false;
+}
+
+void FramesetSyncer::expireDeadlines()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::chrono::duration<double, std::milli> deadline(_settings.deadline_ms);
+    while (_is_running)
+    {
+        if (_pending.empty())
+        {
+            _cv.wait(lock);
+            continue;
+        }
+        // The frameset that arrived first isn't necessarily the oldest.
+        auto first_arrival = std::min_element(_pending.begin(), _pending.end(), [](const Frameset& a, const Frameset& b)
+                                              { return a.arrival < b.arrival; });
+        auto expiry = first_arrival->arrival + std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline);
+        if (std::chrono::steady_clock::now() < expiry)
+        {
+            _cv.wait_until(lock, expiry);
+            continue;
+        }
+        emitUpTo(first_arrival - _pending.begin());
+        lock.unlock();
+        dispatch();
+        lock.lock();
+    }
+}
+
+void FramesetSyncer::diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    uint64_t complete(_complete.value()), partial(_partial.value()), dropped(_dropped.value()), late_frames(_late_frames.value());
+    uint64_t complete_in_window(complete - _last_complete), partial_in_window(partial - _last_partial);
+    uint64_t dropped_in_window(dropped - _last_dropped), late_frames_in_window(late_frames - _last_late_frames);
+    _last_complete = complete;
+    _last_partial = partial;
+    _last_dropped = dropped;
+    _last_late_frames = late_frames;
+
+    status.add("Tolerance (ms)", _settings.tolerance_ms);
+    status.add("Deadline (ms)", _settings.deadline_ms);
+    status.add("Complete framesets in window", complete_in_window);
+    status.add("Partial framesets in window", partial_in_window);
+    status.add("Dropped framesets in window", dropped_in_window);
+    status.add("Late frames in window", late_frames_in_window);
+    if (partial_in_window + dropped_in_window + late_frames_in_window > 0)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Some streams miss the deadline");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Synced");
+}
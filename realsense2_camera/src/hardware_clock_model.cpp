@@ -0,0 +1,161 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/hardware_clock_model.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // A hardware clock step larger than this, compared to the host clock step, is a wrap or a reset.
+    const double MAX_CLOCK_JUMP_SEC = 1.0;
+    // How fast the applied offset may drop, in seconds per second of hardware time: 5 ms per second. Far below the
+    // sample period, even between streams whose samples come in a frame apart.
+    const double MAX_SLEW = 0.005;
+}
+
+HardwareClockModel::HardwareClockModel(double bucket_sec, size_t window_buckets) :
+    _bucket_sec(bucket_sec),
+    _window_buckets(std::max<size_t>(window_buckets, 2)),
+    _is_started(false),
+    _num_resets(0)
+{
+}
+
+void HardwareClockModel::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _is_started = false;
+}
+
+void HardwareClockModel::restart(double hw_sec, double arrival_sec)
+{
+    _hw_origin_sec = hw_sec;
+    _last_hw_sec = 0;
+    _last_arrival_sec = arrival_sec;
+    _bucket_start_sec = 0;
+    _envelope.clear();
+    _envelope.push_back({0, arrival_sec - hw_sec});
+    _offset_sec = arrival_sec - hw_sec;
+    _skew = 0;
+    _residual_sec = 0;
+    _applied_delta_sec = arrival_sec - hw_sec;
+    _applied_hw_sec = 0;
+    _last_latency_sec = 0;
+    _is_started = true;
+}
+
+double HardwareClockModel::toHostTime(double hw_time_ms, double arrival_sec)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    double hw_sec(hw_time_ms / 1000.0);
+    if (!_is_started)
+    {
+        restart(hw_sec, arrival_sec);
+        return arrival_sec;
+    }
+
+    double rel_hw_sec(hw_sec - _hw_origin_sec);
+    double hw_step(rel_hw_sec - _last_hw_sec);
+    double host_step(arrival_sec - _last_arrival_sec);
+    if (std::abs(hw_step - host_step) > MAX_CLOCK_JUMP_SEC)
+    {
+        _num_resets++;
+        restart(hw_sec, arrival_sec);
+        return arrival_sec;
+    }
+    // Frames of different streams come in slightly out of order. Only the newest one moves the model on.
+    if (hw_step > 0)
+    {
+        _last_hw_sec = rel_hw_sec;
+        _last_arrival_sec = arrival_sec;
+    }
+
+    Point point{rel_hw_sec, arrival_sec - hw_sec};
+    if (rel_hw_sec - _bucket_start_sec >= _bucket_sec)
+    {
+        // The open bucket is complete: refit with it and start a new one.
+        fit();
+        _bucket_start_sec = rel_hw_sec;
+        _envelope.push_back(point);
+        while (_envelope.size() > _window_buckets)
+            _envelope.pop_front();
+    }
+    else if (point.delta_sec < _envelope.back().delta_sec)
+    {
+        _envelope.back() = point;
+        if (_envelope.size() == 1)
+            _offset_sec = point.delta_sec;
+    }
+
+    // A frame can't arrive before it was taken. Arriving earlier than the line means the line is late.
+    double target_delta_sec(std::min(estimate(rel_hw_sec), point.delta_sec));
+    if (rel_hw_sec > _applied_hw_sec)
+    {
+        _applied_delta_sec = std::max(target_delta_sec, _applied_delta_sec - MAX_SLEW * (rel_hw_sec - _applied_hw_sec));
+        _applied_hw_sec = rel_hw_sec;
+    }
+    double host_sec(hw_sec + _applied_delta_sec);
+    _last_latency_sec = arrival_sec - host_sec;
+    return host_sec;
+}
+
+void HardwareClockModel::fit()
+{
+    size_t n(_envelope.size());
+    if (n < 2)
+    {
+        _offset_sec = _envelope.back().delta_sec;
+        _skew = 0;
+        _residual_sec = 0;
+        return;
+    }
+    double mean_hw(0), mean_delta(0);
+    for (const Point& point : _envelope)
+    {
+        mean_hw += point.hw_sec;
+        mean_delta += point.delta_sec;
+    }
+    mean_hw /= n;
+    mean_delta /= n;
+    double cov(0), var(0);
+    for (const Point& point : _envelope)
+    {
+        cov += (point.hw_sec - mean_hw) * (point.delta_sec - mean_delta);
+        var += (point.hw_sec - mean_hw) * (point.hw_sec - mean_hw);
+    }
+    _skew = (var > 0) ? cov / var : 0;
+    _offset_sec = mean_delta - _skew * mean_hw;
+
+    // Regression goes through the middle of the envelope. Shift it down to its lowest point, so that it bounds the
+    // arrival times from below.
+    double min_residual(0), sum_sq(0);
+    for (const Point& point : _envelope)
+    {
+        double residual(point.delta_sec - estimate(point.hw_sec));
+        min_residual = std::min(min_residual, residual);
+        sum_sq += residual * residual;
+    }
+    _offset_sec += min_residual;
+    _residual_sec = std::sqrt(sum_sq / n);
+}
+
+double HardwareClockModel::estimate(double hw_sec) const
+{
+    return _offset_sec + _skew * hw_sec;
+}
+
+HardwareClockModel::Status HardwareClockModel::getStatus() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Status status;
+    status.is_valid = _is_started && _envelope.size() >= 2;
+    status.offset_sec = _is_started ? estimate(_last_hw_sec) : 0;
+    status.skew_ppm = _is_started ? _skew * 1e6 : 0;
+    status.residual_ms = _is_started ? _residual_sec * 1000 : 0;
+    status.latency_ms = _is_started ? _last_latency_sec * 1000 : 0;
+    status.num_resets = _num_resets;
+    return status;
+}
@@ -0,0 +1,69 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/jpeg_encoder_pool.h"
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace realsense2_camera;
+
+JpegEncoderPool::JpegEncoderPool(size_t contexts_num, int quality, double scale) :
+    _params{cv::IMWRITE_JPEG_QUALITY, std::min(std::max(quality, 1), 100)},
+    _scale((scale > 0 && scale < 1) ? scale : 1.0)
+{
+    for (size_t i = 0; i < std::max<size_t>(contexts_num, 1); i++)
+    {
+        _free_contexts.emplace_back(new Context());
+    }
+}
+
+std::unique_ptr<JpegEncoderPool::Context> JpegEncoderPool::acquire()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_free_contexts.empty())
+        return nullptr;
+    std::unique_ptr<Context> context(std::move(_free_contexts.back()));
+    _free_contexts.pop_back();
+    return context;
+}
+
+void JpegEncoderPool::release(std::unique_ptr<Context> context)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _free_contexts.push_back(std::move(context));
+}
+
+bool JpegEncoderPool::encode(const uint8_t* data, int width, int height, size_t stride, bool is_bgr, std::vector<uint8_t>& output)
+{
+    std::unique_ptr<Context> context(acquire());
+    if (!context)
+        return false;
+
+    bool is_encoded(false);
+    try
+    {
+        // Only a header over the frame buffer: the pixels are read once, by the first stage that runs.
+        cv::Mat image(height, width, CV_8UC3, const_cast<uint8_t*>(data), stride);
+        if (_scale < 1)
+        {
+            cv::Size size(std::max(1, static_cast<int>(std::lround(width * _scale))),
+                          std::max(1, static_cast<int>(std::lround(height * _scale))));
+            cv::resize(image, context->scaled, size, 0, 0, cv::INTER_AREA);
+            image = context->scaled;
+        }
+        if (!is_bgr)
+        {
+            cv::cvtColor(image, context->bgr, cv::COLOR_RGB2BGR);
+            image = context->bgr;
+        }
+        is_encoded = cv::imencode(".jpg", image, output, _params);
+    }
+    catch (const cv::Exception&)
+    {
+        is_encoded = false;
+    }
+    release(std::move(context));
+    return is_encoded;
+}
@@ -0,0 +1,101 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/metrics_endpoint.h"
+#include <ros/ros.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // How often the server checks whether to stop.
+    const int POLL_TIMEOUT_MS = 200;
+    // A scraper that sends its request slower than this is dropped.
+    const int REQUEST_TIMEOUT_MS = 1000;
+}
+
+MetricsEndpoint::MetricsEndpoint(int port, std::function<std::string()> body) :
+    _body(body),
+    _socket(socket(AF_INET, SOCK_STREAM, 0)),
+    _is_alive(true)
+{
+    if (_socket < 0)
+        throw std::runtime_error(std::string("Failed to create the metrics socket: ") + strerror(errno));
+    int reuse(1);
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(_socket, 4) != 0)
+    {
+        std::string error(strerror(errno));
+        close(_socket);
+        throw std::runtime_error("Failed to listen on 127.0.0.1:" + std::to_string(port) + " for the metrics: " + error);
+    }
+    _t = std::thread([this](){ serve(); });
+}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+    _is_alive = false;
+    _t.join();
+    close(_socket);
+}
+
+void MetricsEndpoint::serve()
+{
+    pollfd listener{_socket, POLLIN, 0};
+    while (_is_alive)
+    {
+        if (poll(&listener, 1, POLL_TIMEOUT_MS) <= 0)
+            continue;
+        int connection(accept(_socket, nullptr, nullptr));
+        if (connection < 0)
+            continue;
+        respond(connection);
+        close(connection);
+    }
+}
+
+void MetricsEndpoint::respond(int connection)
+{
+    // Read up to the end of the request headers. The request itself doesn't matter.
+    std::string request;
+    char buffer[1024];
+    pollfd client{connection, POLLIN, 0};
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 16 * 1024)
+    {
+        if (poll(&client, 1, REQUEST_TIMEOUT_MS) <= 0)
+            return;
+        ssize_t received(recv(connection, buffer, sizeof(buffer), 0));
+        if (received <= 0)
+            return;
+        request.append(buffer, received);
+    }
+
+    std::string body(_body());
+    std::string response("HTTP/1.0 200 OK\r\n"
+                         "Content-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                         "Connection: close\r\n\r\n" + body);
+    for (size_t sent = 0; sent < response.size(); )
+    {
+        ssize_t n(send(connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL));
+        if (n <= 0)
+        {
+            ROS_DEBUG_STREAM("Failed to send the metrics: " << strerror(errno));
+            return;
+        }
+        sent += n;
+    }
+}
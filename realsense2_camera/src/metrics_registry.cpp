@@ -0,0 +1,223 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/metrics_registry.h"
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    std::string series(const std::string& name, const std::string& labels)
+    {
+        return labels.empty() ? name : name + "{" + labels + "}";
+    }
+
+    std::string joinLabels(const std::string& labels, const std::string& label)
+    {
+        return labels.empty() ? label : labels + "," + label;
+    }
+
+    const char* typeName(MetricsRegistry::Type type)
+    {
+        switch (type)
+        {
+            case MetricsRegistry::COUNTER: return "counter";
+            case MetricsRegistry::GAUGE: return "gauge";
+            case MetricsRegistry::HISTOGRAM: return "histogram";
+        }
+        return "untyped";
+    }
+}
+
+MetricsRegistry::Histogram::Histogram(const std::vector<double>& bounds) :
+    _bounds(bounds),
+    _buckets(new std::atomic<uint64_t>[bounds.size() + 1]),
+    _sum(0)
+{
+    for (size_t bucket = 0; bucket <= _bounds.size(); bucket++)
+    {
+        _buckets[bucket] = 0;
+    }
+}
+
+void MetricsRegistry::Histogram::observe(double value)
+{
+    size_t bucket(std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin());
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    double sum(_sum.load(std::memory_order_relaxed));
+    while (!_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed));
+}
+
+uint64_t MetricsRegistry::Histogram::count() const
+{
+    uint64_t count(0);
+    for (size_t bucket = 0; bucket <= _bounds.size(); bucket++)
+    {
+        count += bucketCount(bucket);
+    }
+    return count;
+}
+
+std::vector<double> MetricsRegistry::durationBounds()
+{
+    std::vector<double> bounds;
+    for (double bound = 0.001; bound < 2.5; bound *= 2)
+    {
+        bounds.push_back(bound);
+    }
+    return bounds;
+}
+
+// Called with _mutex locked.
+MetricsRegistry::Entry* MetricsRegistry::find(const std::string& name, const std::string& labels)
+{
+    auto entry = std::find_if(_entries.begin(), _entries.end(), [&](const std::unique_ptr<Entry>& e){ return e->name == name && e->labels == labels; });
+    return entry == _entries.end() ? nullptr : entry->get();
+}
+
+// Called with _mutex locked.
+MetricsRegistry::Entry& MetricsRegistry::add(const std::string& name, const std::string& labels, const std::string& help, Type type)
+{
+    _entries.emplace_back(new Entry());
+    Entry& entry(*_entries.back());
+    entry.name = name;
+    entry.labels = labels;
+    entry.help = help;
+    entry.type = type;
+    return entry;
+}
+
+MetricsRegistry::Counter& MetricsRegistry::counter(const std::string& name, const std::string& labels, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry* entry(find(name, labels));
+    if (entry && entry->counter)
+        return *entry->counter;
+    Entry& new_entry(add(name, labels, help, COUNTER));
+    new_entry.counter.reset(new Counter());
+    return *new_entry.counter;
+}
+
+MetricsRegistry::Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& labels, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry* entry(find(name, labels));
+    if (entry && entry->gauge)
+        return *entry->gauge;
+    Entry& new_entry(add(name, labels, help, GAUGE));
+    new_entry.gauge.reset(new Gauge());
+    return *new_entry.gauge;
+}
+
+MetricsRegistry::Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& labels, const std::string& help,
+                                                       const std::vector<double>& bounds)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry* entry(find(name, labels));
+    if (entry && entry->histogram)
+        return *entry->histogram;
+    Entry& new_entry(add(name, labels, help, HISTOGRAM));
+    new_entry.histogram.reset(new Histogram(bounds));
+    return *new_entry.histogram;
+}
+
+void MetricsRegistry::collector(const std::string& name, Type type, const std::string& help, std::function<void(Samples&)> collect)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    add(name, "", help, type).collect = collect;
+}
+
+void MetricsRegistry::sample(std::vector<std::string>& names, std::vector<double>& values)
+{
+    names.clear();
+    values.clear();
+    Samples samples;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const std::unique_ptr<Entry>& entry : _entries)
+    {
+        if (entry->collect)
+        {
+            samples.clear();
+            entry->collect(samples);
+            for (const auto& sample : samples)
+            {
+                names.push_back(series(entry->name, sample.first));
+                values.push_back(sample.second);
+            }
+        }
+        else if (entry->counter)
+        {
+            names.push_back(series(entry->name, entry->labels));
+            values.push_back(entry->counter->value());
+        }
+        else if (entry->gauge)
+        {
+            names.push_back(series(entry->name, entry->labels));
+            values.push_back(entry->gauge->value());
+        }
+        else if (entry->histogram)
+        {
+            names.push_back(series(entry->name + "_count", entry->labels));
+            values.push_back(entry->histogram->count());
+            names.push_back(series(entry->name + "_sum", entry->labels));
+            values.push_back(entry->histogram->sum());
+        }
+    }
+}
+
+std::string MetricsRegistry::exposition()
+{
+    std::ostringstream out;
+    out.precision(15);
+    std::set<std::string> names_written;
+    Samples samples;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const std::unique_ptr<Entry>& first : _entries)
+    {
+        // All the series of a name go together, under one HELP and TYPE.
+        if (!names_written.insert(first->name).second)
+            continue;
+        out << "# HELP " << first->name << " " << first->help << "\n";
+        out << "# TYPE " << first->name << " " << typeName(first->type) << "\n";
+        for (const std::unique_ptr<Entry>& entry : _entries)
+        {
+            if (entry->name != first->name)
+                continue;
+            if (entry->collect)
+            {
+                samples.clear();
+                entry->collect(samples);
+                for (const auto& sample : samples)
+                    out << series(entry->name, sample.first) << " " << sample.second << "\n";
+            }
+            else if (entry->counter)
+            {
+                out << series(entry->name, entry->labels) << " " << entry->counter->value() << "\n";
+            }
+            else if (entry->gauge)
+            {
+                out << series(entry->name, entry->labels) << " " << entry->gauge->value() << "\n";
+            }
+            else if (entry->histogram)
+            {
+                const Histogram& histogram(*entry->histogram);
+                uint64_t cumulative(0);
+                for (size_t bucket = 0; bucket < histogram.bounds().size(); bucket++)
+                {
+                    cumulative += histogram.bucketCount(bucket);
+                    std::ostringstream bound;
+                    bound << histogram.bounds()[bucket];
+                    out << series(entry->name + "_bucket", joinLabels(entry->labels, "le=\"" + bound.str() + "\"")) << " " << cumulative << "\n";
+                }
+                cumulative += histogram.bucketCount(histogram.bounds().size());
+                out << series(entry->name + "_bucket", joinLabels(entry->labels, "le=\"+Inf\"")) << " " << cumulative << "\n";
+                out << series(entry->name + "_sum", entry->labels) << " " << histogram.sum() << "\n";
+                out << series(entry->name + "_count", entry->labels) << " " << cumulative << "\n";
+            }
+        }
+    }
+    return out.str();
+}
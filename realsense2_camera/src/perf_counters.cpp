@@ -0,0 +1,192 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/perf_counters.h"
+#include <ros/ros.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    const uint64_t EVENT_CONFIGS[PerfCounters::EVENTS_NUM] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                              PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    const char* EVENT_NAMES[PerfCounters::EVENTS_NUM] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+    std::atomic<int> threads_counted(0);
+    std::atomic<int> threads_unavailable(0);
+
+    // The counters of a thread, one group read at once. Closed when the thread exits.
+    class ThreadCounters
+    {
+    public:
+        ThreadCounters() : _is_opened(false)
+        {
+            for (int event = 0; event < PerfCounters::EVENTS_NUM; event++)
+                _fds[event] = -1;
+        }
+
+        ~ThreadCounters()
+        {
+            close();
+        }
+
+        // False if the counters aren't available to the thread. The times the group was enabled and running are totals
+        // since it was opened.
+        bool read(uint64_t (&counts)[PerfCounters::EVENTS_NUM], uint64_t& time_enabled, uint64_t& time_running)
+        {
+            if (!_is_opened)
+            {
+                _is_opened = true;
+                open();
+            }
+            if (_fds[0] < 0)
+                return false;
+            // PERF_FORMAT_GROUP: the number of events, the time enabled and running, then a value per event.
+            uint64_t values[3 + PerfCounters::EVENTS_NUM];
+            if (::read(_fds[0], values, sizeof(values)) != sizeof(values))
+                return false;
+            time_enabled = values[1];
+            time_running = values[2];
+            for (int event = 0; event < PerfCounters::EVENTS_NUM; event++)
+                counts[event] = values[3 + event];
+            return true;
+        }
+
+    private:
+        void open()
+        {
+            for (int event = 0; event < PerfCounters::EVENTS_NUM; event++)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = EVENT_CONFIGS[event];
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                // This thread, on any CPU, in the group of the cycles counter.
+                _fds[event] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, _fds[0], PERF_FLAG_FD_CLOEXEC));
+                if (_fds[event] < 0)
+                {
+                    ROS_DEBUG_STREAM("Failed to open the " << EVENT_NAMES[event] << " performance counter: " << strerror(errno));
+                    close();
+                    threads_unavailable++;
+                    return;
+                }
+            }
+            threads_counted++;
+        }
+
+        void close()
+        {
+            for (int event = 0; event < PerfCounters::EVENTS_NUM; event++)
+            {
+                if (_fds[event] >= 0)
+                    ::close(_fds[event]);
+                _fds[event] = -1;
+            }
+        }
+
+        bool _is_opened;
+        int _fds[PerfCounters::EVENTS_NUM];
+    };
+
+    thread_local ThreadCounters thread_counters;
+}
+
+PerfCounters::Stage::Stage(MetricsRegistry& metrics, const std::string& name) :
+    _name(name),
+    _runs(metrics.counter("realsense_perf_runs_total", "stage=\"" + name + "\"", "Runs of a stage counted by the performance counters.")),
+    _last_runs(0)
+{
+    for (int event = 0; event < EVENTS_NUM; event++)
+    {
+        _events[event] = &metrics.counter(std::string("realsense_perf_") + EVENT_NAMES[event] + "_total", "stage=\"" + name + "\"",
+                                          std::string("Hardware ") + EVENT_NAMES[event] + " of a stage.");
+        _last_events[event] = 0;
+    }
+}
+
+void PerfCounters::Stage::add(const uint64_t (&counts)[EVENTS_NUM])
+{
+    for (int event = 0; event < EVENTS_NUM; event++)
+        _events[event]->add(counts[event]);
+    _runs.add();
+}
+
+void PerfCounters::Stage::diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    uint64_t runs(_runs.value());
+    uint64_t events[EVENTS_NUM];
+    for (int event = 0; event < EVENTS_NUM; event++)
+    {
+        uint64_t value(_events[event]->value());
+        events[event] = value - _last_events[event];
+        _last_events[event] = value;
+    }
+    status.add(_name + " runs in window", runs - _last_runs);
+    _last_runs = runs;
+    if (0 == events[CYCLES] || 0 == events[INSTRUCTIONS])
+        return;
+    status.addf(_name + " IPC", "%.2f", static_cast<double>(events[INSTRUCTIONS]) / events[CYCLES]);
+    status.addf(_name + " cache misses per 1k instructions", "%.2f", 1000.0 * events[CACHE_MISSES] / events[INSTRUCTIONS]);
+    status.addf(_name + " branch misses per 1k instructions", "%.2f", 1000.0 * events[BRANCH_MISSES] / events[INSTRUCTIONS]);
+}
+
+PerfCounters::Scope::Scope(Stage* stage) :
+    _stage(stage)
+{
+    if (_stage && !thread_counters.read(_start, _start_time_enabled, _start_time_running))
+        _stage = nullptr;
+}
+
+PerfCounters::Scope::~Scope()
+{
+    if (!_stage)
+        return;
+    uint64_t end[EVENTS_NUM];
+    uint64_t time_enabled, time_running;
+    if (!thread_counters.read(end, time_enabled, time_running))
+        return;
+    // The kernel multiplexes the groups when it runs out of counters. The counts of a stage during which the group
+    // wasn't running all the time are partial, and the stages are too short to scale them.
+    if (time_enabled - _start_time_enabled != time_running - _start_time_running)
+        return;
+    for (int event = 0; event < EVENTS_NUM; event++)
+        end[event] -= _start[event];
+    _stage->add(end);
+}
+
+PerfCounters::PerfCounters(MetricsRegistry& metrics) :
+    _metrics(metrics),
+    _is_enabled(false)
+{
+}
+
+PerfCounters::Stage* PerfCounters::stage(const std::string& name)
+{
+    if (!_is_enabled)
+        return nullptr;
+    _stages.emplace_back(new Stage(_metrics, name));
+    return _stages.back().get();
+}
+
+void PerfCounters::diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    int counted(threads_counted), unavailable(threads_unavailable);
+    status.add("Threads counted", counted);
+    status.add("Threads without counters", unavailable);
+    for (std::unique_ptr<Stage>& stage : _stages)
+        stage->diagnostics(status);
+    if (0 == counted && 0 != unavailable)
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "The performance counters are unavailable");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Counting");
+}
@@ -0,0 +1,198 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/playback_controller.h"
+#include <ros/ros.h>
+#include <stdexcept>
+
+using namespace realsense2_camera;
+
+PlaybackController::PlaybackController(rs2::device device, bool real_time, std::function<void()> restart) :
+    _playback(device),
+    _duration_ns(_playback.get_duration().count()),
+    _restart(restart),
+    _is_paused(false),
+    _steps(0),
+    _is_discarding(false),
+    _is_finished(false),
+    _frames(0),
+    _loop_start_ns(0),
+    _loop_end_ns(0),
+    _is_seek_pending(false),
+    _seek_position_ns(0),
+    _is_alive(true)
+{
+    _playback.set_real_time(real_time);
+    _playback.set_status_changed_callback([this](rs2_playback_status status){ onStatusChanged(status); });
+    _seek_t = std::thread([this](){ seekLoop(); });
+}
+
+PlaybackController::~PlaybackController()
+{
+    shutdown();
+}
+
+void PlaybackController::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_is_alive)
+            return;
+        _is_alive = false;
+        // Let go of the frames held back, or stopping the sensors would wait for them forever.
+        _is_discarding = true;
+    }
+    _cv.notify_all();
+    _seek_cv.notify_one();
+    _seek_t.join();
+}
+
+bool PlaybackController::admit(const rs2::frame& frame)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto waiting = _waiting.insert(frame.get_timestamp());
+    _cv.wait(lock, [&]{ return _is_discarding || !_is_paused || (_steps > 0 && waiting == _waiting.begin()); });
+    _waiting.erase(waiting);
+    if (_is_discarding)
+        return false;
+    bool is_step(_is_paused);
+    if (is_step)
+    {
+        _steps--;
+        // The next step goes to the earliest frame still held back.
+        _cv.notify_all();
+    }
+
+    if (_loop_end_ns > 0 && _playback.get_position() >= _loop_end_ns)
+    {
+        requestSeek(_loop_start_ns);
+        // The step goes to the first frame of the loop instead.
+        if (is_step)
+            _steps++;
+        return false;
+    }
+    _frames++;
+    return true;
+}
+
+void PlaybackController::onStatusChanged(rs2_playback_status status)
+{
+    if (RS2_PLAYBACK_STATUS_STOPPED != status)
+        return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_is_alive || _is_seek_pending)
+        return;
+    _is_finished = true;
+    if (_loop_end_ns > 0)
+    {
+        requestSeek(_loop_start_ns);
+        return;
+    }
+    ROS_INFO_STREAM("Playback finished, " << _frames << " frames. Seek to play again.");
+}
+
+void PlaybackController::setPaused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _is_paused = paused;
+        _steps = 0;
+    }
+    _cv.notify_all();
+}
+
+bool PlaybackController::step()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_is_paused)
+            return false;
+        _steps++;
+    }
+    _cv.notify_all();
+    return true;
+}
+
+void PlaybackController::seek(double position_sec)
+{
+    if (position_sec < 0 || (_duration_ns > 0 && position_sec * 1e9 > _duration_ns))
+        throw std::out_of_range("Position " + std::to_string(position_sec) + " s is beyond the file, of " + std::to_string(_duration_ns / 1e9) + " s");
+    std::unique_lock<std::mutex> lock(_mutex);
+    requestSeek(static_cast<uint64_t>(position_sec * 1e9));
+    _cv.wait(lock, [this]{ return !_is_seek_pending || !_is_alive; });
+}
+
+void PlaybackController::setLoop(double start_sec, double end_sec)
+{
+    if (0 != end_sec && (start_sec < 0 || end_sec <= start_sec || (_duration_ns > 0 && start_sec * 1e9 >= _duration_ns)))
+        throw std::out_of_range("Invalid loop range [" + std::to_string(start_sec) + ", " + std::to_string(end_sec) + ") s");
+    uint64_t position_ns(_playback.get_position());
+    std::lock_guard<std::mutex> lock(_mutex);
+    _loop_start_ns = (0 == end_sec) ? 0 : static_cast<uint64_t>(start_sec * 1e9);
+    _loop_end_ns = (0 == end_sec) ? 0 : static_cast<uint64_t>(end_sec * 1e9);
+    if (_loop_end_ns > 0 && (position_ns < _loop_start_ns || position_ns >= _loop_end_ns || _is_finished))
+    {
+        requestSeek(_loop_start_ns);
+    }
+}
+
+PlaybackController::Status PlaybackController::getStatus()
+{
+    Status status;
+    status.position_sec = _playback.get_position() / 1e9;
+    status.duration_sec = _duration_ns / 1e9;
+    std::lock_guard<std::mutex> lock(_mutex);
+    status.is_paused = _is_paused;
+    status.is_finished = _is_finished;
+    status.frames = _frames;
+    status.loop_start_sec = _loop_start_ns / 1e9;
+    status.loop_end_sec = _loop_end_ns / 1e9;
+    return status;
+}
+
+// Called with _mutex locked.
+void PlaybackController::requestSeek(uint64_t position_ns)
+{
+    _seek_position_ns = position_ns;
+    _is_seek_pending = true;
+    _seek_cv.notify_one();
+}
+
+void PlaybackController::seekLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _seek_cv.wait(lock, [this]{ return _is_seek_pending || !_is_alive; });
+        if (!_is_alive)
+            break;
+        // librealsense pauses the reader on the reader thread, which may be blocked on a full callback queue: the frames
+        // held back must be let go first. Whatever was read meanwhile belongs to the old position and is dropped.
+        _is_discarding = true;
+        _cv.notify_all();
+        uint64_t position_ns(_seek_position_ns);
+        bool is_finished(_is_finished);
+        lock.unlock();
+        try
+        {
+            if (is_finished)
+            {
+                _restart();
+            }
+            _playback.pause();
+            _playback.seek(std::chrono::nanoseconds(position_ns));
+        }
+        catch(const std::exception& ex)
+        {
+            ROS_ERROR_STREAM("Failed to seek to " << position_ns / 1e9 << " s: " << ex.what());
+        }
+        lock.lock();
+        _is_finished = false;
+        _is_seek_pending = false;
+        _is_discarding = !_is_alive;
+        lock.unlock();
+        _cv.notify_all();
+        _playback.resume();
+        lock.lock();
+    }
+}
@@ -0,0 +1,315 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/raw_recorder.h"
+#include <ros/ros.h>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // Dirty pages are handed to the writeback in chunks of this size, instead of piling up for the kernel to flush
+    // in bursts.
+    const size_t SYNC_CHUNK_SIZE = 64 * 1024 * 1024;
+
+    size_t align(size_t size)
+    {
+        return (size + RAW_RECORD_ALIGNMENT - 1) / RAW_RECORD_ALIGNMENT * RAW_RECORD_ALIGNMENT;
+    }
+
+}
+
+void realsense2_camera::createRecordingDirectory(const std::string& directory)
+{
+    for (size_t pos = directory.find('/', 1); ; pos = directory.find('/', pos + 1))
+    {
+        std::string dir(directory.substr(0, pos));
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+            throw std::runtime_error("Failed to create " + dir + ": " + strerror(errno));
+        if (pos == std::string::npos)
+            return;
+    }
+}
+
+size_t realsense2_camera::describeRawRecord(const rs2::frame& frame, int64_t arrival_time_ns, RawRecordHeader& header, RawRecordMetadata* metadata)
+{
+    uint32_t metadata_count(0);
+    for (int key = 0; key < RS2_FRAME_METADATA_COUNT; key++)
+    {
+        rs2_frame_metadata_value metadata_key(static_cast<rs2_frame_metadata_value>(key));
+        if (frame.supports_frame_metadata(metadata_key))
+        {
+            metadata[metadata_count++] = {static_cast<uint32_t>(key), static_cast<int64_t>(frame.get_frame_metadata(metadata_key))};
+        }
+    }
+
+    std::memset(&header, 0, sizeof(header));
+    header.magic = RAW_RECORD_MAGIC;
+    header.stream = frame.get_profile().stream_type();
+    header.stream_index = frame.get_profile().stream_index();
+    header.format = frame.get_profile().format();
+    if (frame.is<rs2::video_frame>())
+    {
+        auto video_frame = frame.as<rs2::video_frame>();
+        header.width = video_frame.get_width();
+        header.height = video_frame.get_height();
+        header.stride = video_frame.get_stride_in_bytes();
+    }
+    header.data_size = frame.get_data_size();
+    header.metadata_count = metadata_count;
+    header.timestamp_domain = frame.get_frame_timestamp_domain();
+    header.frame_number = frame.get_frame_number();
+    header.timestamp_ms = frame.get_timestamp();
+    header.arrival_time_ns = arrival_time_ns;
+    return align(sizeof(header) + metadata_count * sizeof(RawRecordMetadata) + header.data_size);
+}
+
+void realsense2_camera::copyRawRecord(const rs2::frame& frame, const RawRecordHeader& header, const RawRecordMetadata* metadata, uint8_t* destination)
+{
+    size_t metadata_size(header.metadata_count * sizeof(RawRecordMetadata));
+    std::memcpy(destination, &header, sizeof(header));
+    std::memcpy(destination + sizeof(header), metadata, metadata_size);
+    std::memcpy(destination + sizeof(header) + metadata_size, frame.get_data(), header.data_size);
+}
+
+RawIndexEntry realsense2_camera::makeRawIndexEntry(const RawRecordHeader& header, uint64_t offset, uint32_t record_size)
+{
+    RawIndexEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.offset = offset;
+    entry.record_size = record_size;
+    entry.stream = header.stream;
+    entry.stream_index = header.stream_index;
+    entry.frame_number = header.frame_number;
+    entry.timestamp_ms = header.timestamp_ms;
+    entry.arrival_time_ns = header.arrival_time_ns;
+    return entry;
+}
+
+RawRecorder::RawRecorder(size_t segment_size, size_t max_backlog_frames) :
+    _segment_size(align(segment_size)),
+    _max_backlog_frames(std::max<size_t>(max_backlog_frames, 1)),
+    _is_recording(false),
+    _backlog_bytes(0),
+    _stop_writer(false),
+    _segment_number(0),
+    _segment_fd(-1),
+    _segment(nullptr),
+    _segment_used(0),
+    _segment_synced(0),
+    _frames_written(0),
+    _frames_dropped(0),
+    _bytes_written(0),
+    _segments(0),
+    _last_status_bytes(0),
+    _last_status_time(std::chrono::steady_clock::now())
+{
+}
+
+RawRecorder::~RawRecorder()
+{
+    stop();
+}
+
+void RawRecorder::start(const std::string& directory)
+{
+    std::lock_guard<std::mutex> control_lock(_control_mutex);
+    if (_is_recording)
+        throw std::runtime_error("Already recording into " + _directory);
+    createRecordingDirectory(directory);
+
+    _directory = directory;
+    _segment_number = 0;
+    _frames_written = 0;
+    _frames_dropped = 0;
+    _bytes_written = 0;
+    _segments = 0;
+    _last_status_bytes = 0;
+    _last_status_time = std::chrono::steady_clock::now();
+    openSegment();
+
+    _stop_writer = false;
+    _writer_t = std::thread(&RawRecorder::writerLoop, this);
+    _is_recording = true;
+    ROS_INFO_STREAM("Recording into " << _directory);
+}
+
+void RawRecorder::stop()
+{
+    std::lock_guard<std::mutex> control_lock(_control_mutex);
+    if (!_is_recording)
+        return;
+    _is_recording = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop_writer = true;
+    }
+    _cv.notify_one();
+    _writer_t.join();
+    closeSegment();
+    ROS_INFO_STREAM("Recorded " << _frames_written << " frames, " << _bytes_written / 1000000 << " MB into " << _directory
+                    << ". " << _frames_dropped << " frames were dropped.");
+}
+
+void RawRecorder::record(const rs2::frame& frame)
+{
+    if (!_is_recording)
+        return;
+    int64_t arrival_time_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // The queue holds the frames themselves: librealsense can't reuse their buffers meanwhile, so it must stay short.
+        if (_queue.size() >= _max_backlog_frames)
+        {
+            _frames_dropped++;
+            return;
+        }
+        _queue.push_back({frame, arrival_time_ns});
+        _backlog_bytes += frame.get_data_size();
+    }
+    _cv.notify_one();
+}
+
+void RawRecorder::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [this]{ return !_queue.empty() || _stop_writer; });
+        if (_queue.empty())
+            break;
+        QueuedFrame queued(std::move(_queue.front()));
+        _queue.pop_front();
+        lock.unlock();
+        try
+        {
+            write(queued);
+        }
+        catch(const std::exception& ex)
+        {
+            ROS_ERROR_STREAM_THROTTLE(5, "Recording failed: " << ex.what());
+            _frames_dropped++;
+        }
+        lock.lock();
+        _backlog_bytes -= queued.frame.get_data_size();
+    }
+}
+
+void RawRecorder::write(const QueuedFrame& queued)
+{
+    RawRecordHeader header;
+    RawRecordMetadata metadata[RS2_FRAME_METADATA_COUNT];
+    size_t record_size(describeRawRecord(queued.frame, queued.arrival_time_ns, header, metadata));
+    if (record_size > _segment_size)
+        throw std::runtime_error("A frame of " + std::to_string(record_size) + " bytes doesn't fit in a segment");
+    if (_segment && _segment_used + record_size > _segment_size)
+    {
+        closeSegment();
+    }
+    if (!_segment)
+    {
+        openSegment();
+    }
+
+    copyRawRecord(queued.frame, header, metadata, _segment + _segment_used);
+    RawIndexEntry entry(makeRawIndexEntry(header, _segment_used, record_size));
+    _index.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+    _segment_used += record_size;
+    if (_segment_used - _segment_synced >= SYNC_CHUNK_SIZE)
+    {
+        size_t page_size(sysconf(_SC_PAGESIZE));
+        size_t sync_end(_segment_used / page_size * page_size);
+        msync(_segment + _segment_synced, sync_end - _segment_synced, MS_ASYNC);
+        _segment_synced = sync_end;
+    }
+    _frames_written++;
+    _bytes_written += record_size;
+}
+
+void RawRecorder::openSegment()
+{
+    std::stringstream name;
+    name << _directory << "/segment_" << std::setw(5) << std::setfill('0') << _segment_number++;
+    std::string segment_path(name.str() + ".raw");
+
+    _segment_fd = open(segment_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_segment_fd < 0)
+        throw std::runtime_error("Failed to create " + segment_path + ": " + strerror(errno));
+    // Allocating the blocks up front keeps the file system from extending the file on every page written.
+    if (posix_fallocate(_segment_fd, 0, _segment_size) != 0 && ftruncate(_segment_fd, _segment_size) != 0)
+    {
+        std::string error("Failed to allocate " + segment_path + ": " + strerror(errno));
+        close(_segment_fd);
+        _segment_fd = -1;
+        throw std::runtime_error(error);
+    }
+    void* segment = mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, _segment_fd, 0);
+    if (MAP_FAILED == segment)
+    {
+        std::string error("Failed to map " + segment_path + ": " + strerror(errno));
+        close(_segment_fd);
+        _segment_fd = -1;
+        throw std::runtime_error(error);
+    }
+    _segment = static_cast<uint8_t*>(segment);
+    madvise(_segment, _segment_size, MADV_SEQUENTIAL);
+    _segment_used = 0;
+    _segment_synced = 0;
+
+    _index.open(name.str() + ".idx", std::ios::binary | std::ios::trunc);
+    if (!_index.is_open())
+        throw std::runtime_error("Failed to create " + name.str() + ".idx");
+    _segments++;
+}
+
+void RawRecorder::closeSegment()
+{
+    if (_segment)
+    {
+        munmap(_segment, _segment_size);
+        _segment = nullptr;
+    }
+    if (_segment_fd >= 0)
+    {
+        if (ftruncate(_segment_fd, _segment_used) != 0)
+            ROS_WARN_STREAM("Failed to truncate the last segment in " << _directory << ": " << strerror(errno));
+        close(_segment_fd);
+        _segment_fd = -1;
+    }
+    if (_index.is_open())
+        _index.close();
+}
+
+RawRecorder::Status RawRecorder::getStatus()
+{
+    Status status;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        status.backlog_frames = _queue.size();
+        status.backlog_bytes = _backlog_bytes;
+    }
+    status.is_recording = _is_recording;
+    status.directory = _directory;
+    status.frames_written = _frames_written;
+    status.frames_dropped = _frames_dropped;
+    status.bytes_written = _bytes_written;
+    status.segments = _segments;
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed_sec(std::chrono::duration<double>(now - _last_status_time).count());
+    status.write_mb_per_sec = (elapsed_sec > 0 && status.bytes_written >= _last_status_bytes) ?
+                              (status.bytes_written - _last_status_bytes) / 1e6 / elapsed_sec : 0;
+    _last_status_bytes = status.bytes_written;
+    _last_status_time = now;
+    return status;
+}
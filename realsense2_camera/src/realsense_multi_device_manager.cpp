@@ -0,0 +1,446 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/realsense_multi_device_manager.h"
+#include "../include/base_realsense_node.h"
+#include "../include/t265_realsense_node.h"
+#include "../include/synthetic_device.h"
+#include <algorithm>
+#include <regex>
+
+using namespace realsense2_camera;
+
+PLUGINLIB_EXPORT_CLASS(realsense2_camera::RealSenseMultiDeviceManager, nodelet::Nodelet)
+
+RealSenseMultiDeviceManager::RealSenseMultiDeviceManager() :
+    _rescan(true), _is_alive(true)
+{
+    ROS_INFO("RealSense ROS v%s", REALSENSE_ROS_VERSION_STR);
+    ROS_INFO("Built with LibRealSense v%s", RS2_API_VERSION_STR);
+
+    auto severity = rs2_log_severity::RS2_LOG_SEVERITY_WARN;
+    RealSenseNodeFactory::tryGetLogSeverity(severity);
+    if (rs2_log_severity::RS2_LOG_SEVERITY_DEBUG == severity)
+        ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Debug);
+
+    rs2::log_to_console(severity);
+}
+
+RealSenseMultiDeviceManager::~RealSenseMultiDeviceManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(_cameras_mutex);
+        _is_alive = false;
+    }
+    _cv.notify_all();
+    if (_discovery_thread.joinable())
+    {
+        _discovery_thread.join();
+    }
+
+    // Camera nodes post to the worker pool, so they must be gone before it is.
+    for (auto& camera : _cameras)
+    {
+        stopCamera(*camera);
+    }
+    _cameras.clear();
+    _worker_pool.reset();
+}
+
+void RealSenseMultiDeviceManager::onInit()
+{
+    ros::NodeHandle privateNh = getPrivateNodeHandle();
+
+    std::vector<std::string> camera_names;
+    privateNh.param("cameras", camera_names, std::vector<std::string>());
+    if (camera_names.empty())
+    {
+        ROS_ERROR("No cameras were configured. Set the \"cameras\" parameter to the list of camera names.");
+        return;
+    }
+
+    int worker_threads, max_queued_frames;
+    privateNh.param("worker_threads", worker_threads, 0);
+    privateNh.param("max_queued_frames", max_queued_frames, 2);
+    if (worker_threads <= 0)
+        worker_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    _worker_pool = std::make_shared<WorkerPool>(worker_threads, std::max(max_queued_frames, 1));
+
+    for (auto& name : camera_names)
+    {
+        auto camera = std::make_shared<Camera>();
+        camera->name = name;
+        camera->nh = ros::NodeHandle(getNodeHandle(), name);
+        camera->pnh = ros::NodeHandle(privateNh, name);
+        camera->pnh.param("serial_no", camera->serial_no, std::string(""));
+        camera->pnh.param("usb_port_id", camera->usb_port_id, std::string(""));
+        camera->pnh.param("device_type", camera->device_type, std::string(""));
+        camera->pnh.param("synthetic_device", camera->synthetic_device, std::string(""));
+        camera->pnh.param("initial_reset", camera->initial_reset, false);
+        camera->is_starting = false;
+        camera->is_resetting = false;
+        camera->generation = 0;
+        setDefaultFrameIds(*camera);
+
+        Camera* camera_ptr(camera.get());
+        boost::function<bool(std_srvs::SetBool::Request&, std_srvs::SetBool::Response&)> toggle_sensor_callback_function =
+            [this, camera_ptr](std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res){ return toggle_sensor_callback(camera_ptr, req, res); };
+        boost::function<bool(std_srvs::SetBool::Request&, std_srvs::SetBool::Response&)> pause_sensor_callback_function =
+            [this, camera_ptr](std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res){ return pause_sensor_callback(camera_ptr, req, res); };
+        boost::function<bool(std_srvs::SetBool::Request&, std_srvs::SetBool::Response&)> record_callback_function =
+            [this, camera_ptr](std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res){ return record_callback(camera_ptr, req, res); };
+        boost::function<bool(std_srvs::Empty::Request&, std_srvs::Empty::Response&)> reset_callback_function =
+            [this, camera_ptr](std_srvs::Empty::Request& req, std_srvs::Empty::Response& res){ return handleReset(camera_ptr, req, res); };
+        camera->toggle_sensor_srv = camera->nh.advertiseService("enable", toggle_sensor_callback_function);
+        camera->pause_sensor_srv = camera->nh.advertiseService("pause", pause_sensor_callback_function);
+        camera->record_srv = camera->nh.advertiseService("record", record_callback_function);
+        camera->reset_srv = camera->pnh.advertiseService("reset", reset_callback_function);
+
+        ROS_INFO_STREAM("Camera " << name << ": serial number \"" << camera->serial_no << "\", usb port id \"" << camera->usb_port_id
+                        << "\", device type \"" << camera->device_type << "\"");
+        _cameras.push_back(camera);
+    }
+
+    std::function<void(rs2::event_information&)> change_device_callback_function = [this](rs2::event_information& info){change_device_callback(info);};
+    _ctx.set_devices_changed_callback(change_device_callback_function);
+    _discovery_thread = std::thread([this](){ discoveryLoop(); });
+}
+
+void RealSenseMultiDeviceManager::setDefaultFrameIds(Camera& camera)
+{
+    // Same naming as nodelet.launch.xml derives from tf_prefix. Otherwise all cameras would publish the default camera_* frames.
+    std::string tf_prefix;
+    camera.pnh.param("tf_prefix", tf_prefix, camera.name);
+
+    auto set_default = [&camera](const std::string& param_name, const std::string& value)
+    {
+        if (!camera.pnh.hasParam(param_name))
+            camera.pnh.setParam(param_name, value);
+    };
+
+    set_default("base_frame_id", tf_prefix + "_link");
+    set_default("odom_frame_id", tf_prefix + "_odom_frame");
+    set_default("imu_optical_frame_id", tf_prefix + "_imu_optical_frame");
+    const std::vector<std::string> stream_names = {"depth", "infra", "infra1", "infra2", "color", "fisheye", "fisheye1", "fisheye2",
+                                                   "gyro", "accel", "pose", "confidence"};
+    for (auto& stream_name : stream_names)
+    {
+        set_default(stream_name + "_frame_id", tf_prefix + "_" + stream_name + "_frame");
+        set_default(stream_name + "_optical_frame_id", tf_prefix + "_" + stream_name + "_optical_frame");
+        set_default("aligned_depth_to_" + stream_name + "_frame_id", tf_prefix + "_aligned_depth_to_" + stream_name + "_frame");
+    }
+}
+
+void RealSenseMultiDeviceManager::discoveryLoop()
+{
+    std::unique_lock<std::mutex> lock(_cameras_mutex);
+    while (_is_alive)
+    {
+        if (_rescan)
+        {
+            _rescan = false;
+            // Starting a camera takes seconds, during which the services and the device events of all the cameras
+            // would wait for the lock. The devices are claimed under the lock and the nodes built without it.
+            for (const CameraStart& start : attachDevices())
+            {
+                if (!_is_alive)
+                    break;
+                lock.unlock();
+                std::shared_ptr<InterfaceRealSenseNode> node(startCamera(start));
+                lock.lock();
+                Camera& camera(*start.camera);
+                if (camera.generation == start.generation)
+                {
+                    camera.is_starting = false;
+                    camera.node = node;
+                    if (!node)
+                    {
+                        StoppedCamera stopped(stopCamera(camera));
+                        lock.unlock();
+                        stopped = StoppedCamera();
+                        lock.lock();
+                    }
+                }
+                else if (node)
+                {
+                    ROS_WARN_STREAM("Camera " << camera.name << ": the device was disconnected or reset while starting.");
+                    lock.unlock();
+                    node.reset();
+                    lock.lock();
+                }
+            }
+        }
+        // Devices are normally attached on the devices changed event. The timeout covers devices that were busy.
+        _cv.wait_for(lock, std::chrono::seconds(6), [this]{ return _rescan || !_is_alive; });
+        if (std::any_of(_cameras.begin(), _cameras.end(), [](const std::shared_ptr<Camera>& camera){ return !camera->node; }))
+            _rescan = true;
+    }
+}
+
+bool RealSenseMultiDeviceManager::isDeviceTaken(const std::string& serial_no) const
+{
+    return std::any_of(_cameras.begin(), _cameras.end(), [&serial_no](const std::shared_ptr<Camera>& camera)
+                                                         { return (camera->node || camera->is_starting || camera->is_resetting) && camera->device_serial_no == serial_no; });
+}
+
+bool RealSenseMultiDeviceManager::matchDevice(const Camera& camera, rs2::device dev) const
+{
+    std::string sn = dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+    if (!camera.serial_no.empty() && sn != camera.serial_no)
+        return false;
+    if (!camera.usb_port_id.empty())
+    {
+        std::string port_id = RealSenseNodeFactory::parse_usb_port(dev.get_info(RS2_CAMERA_INFO_PHYSICAL_PORT));
+        if (port_id != camera.usb_port_id)
+            return false;
+    }
+    if (!camera.device_type.empty())
+    {
+        std::string name = dev.get_info(RS2_CAMERA_INFO_NAME);
+        std::smatch match_results;
+        std::regex device_type_regex(camera.device_type.c_str(), std::regex::icase);
+        if (!std::regex_search(name, match_results, device_type_regex))
+            return false;
+    }
+    return true;
+}
+
+// Called with _cameras_mutex locked.
+std::vector<RealSenseMultiDeviceManager::CameraStart> RealSenseMultiDeviceManager::attachDevices()
+{
+    std::vector<CameraStart> starts;
+    bool has_pending_hardware(false);
+    for (auto& camera : _cameras)
+    {
+        if (camera->node || camera->is_starting || camera->is_resetting)
+            continue;
+        if (!camera->synthetic_device.empty())
+        {
+            try
+            {
+                camera->synthetic = std::make_shared<SyntheticDevice>(camera->synthetic_device, camera->serial_no, camera->pnh);
+                starts.push_back(claimDevice(camera, camera->synthetic->getDevice()));
+            }
+            catch(const std::exception& ex)
+            {
+                ROS_ERROR_STREAM("Camera " << camera->name << ": failed to create synthetic device: " << ex.what());
+                camera->synthetic.reset();
+            }
+            continue;
+        }
+        has_pending_hardware = true;
+    }
+    if (!has_pending_hardware)
+        return starts;
+
+    // Enumerate once for all the cameras that are still waiting for their device.
+    rs2::device_list list = _ctx.query_devices();
+    for (auto& camera : _cameras)
+    {
+        if (camera->node || camera->is_starting || camera->is_resetting || !camera->synthetic_device.empty())
+            continue;
+        bool found(false);
+        for (size_t count = 0; count < list.size() && !found; count++)
+        {
+            rs2::device dev;
+            try
+            {
+                dev = list[count];
+                std::string sn = dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+                if (isDeviceTaken(sn) || !matchDevice(*camera, dev))
+                    continue;
+            }
+            catch(const std::exception& ex)
+            {
+                ROS_WARN_STREAM("Device " << count+1 << "/" << list.size() << " failed with exception: " << ex.what());
+                continue;
+            }
+            found = true;
+            if (camera->initial_reset)
+            {
+                camera->initial_reset = false;
+                try
+                {
+                    ROS_INFO_STREAM("Camera " << camera->name << ": resetting device...");
+                    dev.hardware_reset();
+                }
+                catch(const std::exception& ex)
+                {
+                    ROS_WARN_STREAM("An exception has been thrown: " << ex.what());
+                }
+                continue;
+            }
+            try
+            {
+                starts.push_back(claimDevice(camera, dev));
+            }
+            catch(const std::exception& ex)
+            {
+                ROS_ERROR_STREAM("Camera " << camera->name << ": failed to start: " << ex.what());
+                stopCamera(*camera);
+            }
+        }
+        if (!found)
+        {
+            ROS_WARN_STREAM("Camera " << camera->name << ": the requested device is NOT found. Will Try again.");
+        }
+    }
+    return starts;
+}
+
+// Called with _cameras_mutex locked.
+RealSenseMultiDeviceManager::CameraStart RealSenseMultiDeviceManager::claimDevice(const std::shared_ptr<Camera>& camera, rs2::device dev)
+{
+    camera->device = dev;
+    camera->device_serial_no = dev.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+    camera->is_starting = true;
+    return {camera, dev, camera->device_serial_no, camera->synthetic, camera->generation};
+}
+
+// Called without _cameras_mutex. Returns nullptr on failure.
+std::shared_ptr<InterfaceRealSenseNode> RealSenseMultiDeviceManager::startCamera(const CameraStart& start)
+{
+    const Camera& camera(*start.camera);
+    std::shared_ptr<InterfaceRealSenseNode> node;
+    try
+    {
+        ROS_INFO_STREAM("Camera " << camera.name << ": starting device with serial number " << start.serial_no);
+        uint16_t pid = std::stoi(start.device.get_info(RS2_CAMERA_INFO_PRODUCT_ID), 0, 16);
+        if (!start.synthetic && RS_T265_PID == pid)
+        {
+            // T265 frames are published from its own callbacks and don't use the worker pool.
+            node = std::make_shared<T265RealsenseNode>(start.camera->nh, start.camera->pnh, start.device, start.serial_no);
+        }
+        else
+        {
+            node = std::make_shared<BaseRealSenseNode>(start.camera->nh, start.camera->pnh, start.device, start.serial_no, _worker_pool);
+        }
+        node->publishTopics();
+    }
+    catch(const std::exception& ex)
+    {
+        ROS_ERROR_STREAM("Camera " << camera.name << ": failed to start: " << ex.what());
+        node.reset();
+    }
+    return node;
+}
+
+// Called with _cameras_mutex locked.
+RealSenseMultiDeviceManager::StoppedCamera RealSenseMultiDeviceManager::stopCamera(Camera& camera)
+{
+    StoppedCamera stopped{camera.synthetic, camera.node};
+    camera.node.reset();
+    camera.device = rs2::device();
+    camera.device_serial_no.clear();
+    camera.synthetic.reset();
+    camera.is_starting = false;
+    camera.is_resetting = false;
+    camera.generation++;
+    return stopped;
+}
+
+// The services call into the node without _cameras_mutex, through a reference that keeps it alive meanwhile.
+std::shared_ptr<InterfaceRealSenseNode> RealSenseMultiDeviceManager::getNode(Camera* camera)
+{
+    std::lock_guard<std::mutex> lock(_cameras_mutex);
+    return camera->node;
+}
+
+void RealSenseMultiDeviceManager::change_device_callback(rs2::event_information& info)
+{
+    std::vector<StoppedCamera> stopped;
+    {
+        std::lock_guard<std::mutex> lock(_cameras_mutex);
+        for (auto& camera : _cameras)
+        {
+            if ((camera->node || camera->is_starting) && !camera->synthetic && info.was_removed(camera->device))
+            {
+                ROS_ERROR_STREAM("Camera " << camera->name << ": the device has been disconnected!");
+                stopped.push_back(stopCamera(*camera));
+            }
+        }
+        _rescan = true;
+    }
+    _cv.notify_all();
+}
+
+bool RealSenseMultiDeviceManager::toggle_sensor_callback(Camera* camera, std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res)
+{
+    std::shared_ptr<InterfaceRealSenseNode> node(getNode(camera));
+    if (!node)
+    {
+        res.success = false;
+        res.message = "Camera " + camera->name + " is not connected";
+        return true;
+    }
+    ROS_INFO_STREAM("Camera " << camera->name << ": toggling sensor : " << (req.data ? "ON" : "OFF"));
+    node->toggleSensors(req.data);
+    res.success = true;
+    return true;
+}
+
+bool RealSenseMultiDeviceManager::pause_sensor_callback(Camera* camera, std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res)
+{
+    std::shared_ptr<InterfaceRealSenseNode> node(getNode(camera));
+    if (!node)
+    {
+        res.success = false;
+        res.message = "Camera " + camera->name + " is not connected";
+        return true;
+    }
+    ROS_INFO_STREAM("Camera " << camera->name << ": " << (req.data ? "pausing" : "resuming") << " sensor");
+    node->pauseSensors(req.data);
+    res.success = true;
+    return true;
+}
+
+bool RealSenseMultiDeviceManager::record_callback(Camera* camera, std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res)
+{
+    std::shared_ptr<InterfaceRealSenseNode> node(getNode(camera));
+    if (!node)
+    {
+        res.success = false;
+        res.message = "Camera " + camera->name + " is not connected";
+        return true;
+    }
+    res.success = node->setRecording(req.data, res.message);
+    return true;
+}
+
+bool RealSenseMultiDeviceManager::handleReset(Camera* camera, std_srvs::Empty::Request& request, std_srvs::Empty::Response& response)
+{
+    rs2::device dev;
+    StoppedCamera stopped;
+    {
+        std::lock_guard<std::mutex> lock(_cameras_mutex);
+        if (!camera->synthetic)
+            dev = camera->device;
+        std::string serial_no(camera->device_serial_no);
+        stopped = stopCamera(*camera);
+        // Keeps the device from being attached again until it was reset.
+        if (dev)
+        {
+            camera->device = dev;
+            camera->device_serial_no = serial_no;
+            camera->is_resetting = true;
+        }
+    }
+    stopped = StoppedCamera();
+    try
+    {
+        if (dev)
+            dev.hardware_reset();
+    }
+    catch (const rs2::error& e)
+    {
+        ROS_ERROR_STREAM("Exception: " << e.what());
+    }
+    {
+        std::lock_guard<std::mutex> lock(_cameras_mutex);
+        if (camera->is_resetting)
+            stopCamera(*camera);
+        _rescan = true;
+    }
+    _cv.notify_all();
+    return true;
+}
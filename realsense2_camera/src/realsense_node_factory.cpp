@@ -4,6 +4,9 @@
 #include "../include/realsense_node_factory.h"
 #include "../include/base_realsense_node.h"
 #include "../include/t265_realsense_node.h"
+#include "../include/synthetic_device.h"
+#include "../include/playback_controller.h"
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <mutex>
@@ -29,8 +32,20 @@ std::string api_version_to_string(int version)
 	return ss.str();
 }
 
+std::string playback_status_to_string(const PlaybackController::Status& status)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3) << "position " << status.position_sec << " of " << status.duration_sec << " s, "
+	   << status.frames << " frames" << (status.is_paused ? ", paused" : "") << (status.is_finished ? ", finished" : "");
+	if (status.loop_end_sec > 0)
+		ss << ", looping over [" << status.loop_start_sec << ", " << status.loop_end_sec << ") s";
+	return ss.str();
+}
+
 RealSenseNodeFactory::RealSenseNodeFactory():
-	_is_alive(true)
+	_warm_restart(false),
+	_is_alive(true),
+	_devices_changed(false)
 {
 	rs2_error* e = nullptr;
 	std::string running_librealsense_version(api_version_to_string(rs2_get_api_version(&e)));
@@ -55,7 +70,18 @@ RealSenseNodeFactory::RealSenseNodeFactory():
 
 RealSenseNodeFactory::~RealSenseNodeFactory()
 {
-	_is_alive = false;
+	stopQueryThread();
+	if (_playback_controller)
+		_playback_controller->shutdown();
+}
+
+void RealSenseNodeFactory::stopQueryThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(_query_mutex);
+		_is_alive = false;
+	}
+	_query_cv.notify_all();
 	if (_query_thread.joinable())
 	{
 		_query_thread.join();
@@ -84,6 +110,12 @@ std::string RealSenseNodeFactory::parse_usb_port(std::string line)
     return port_id;
 }
 
+void RealSenseNodeFactory::setDevice(const rs2::device& dev)
+{
+	std::lock_guard<std::mutex> lock(_query_mutex);
+	_device = dev;
+}
+
 void RealSenseNodeFactory::getDevice(rs2::device_list list)
 {
 	if (!_device)
@@ -144,7 +176,7 @@ void RealSenseNodeFactory::getDevice(rs2::device_list list)
 
 				if ((_serial_no.empty() || sn == _serial_no) && (_usb_port_id.empty() || port_id == _usb_port_id) && found_device_type)
 				{
-					_device = dev;
+					setDevice(dev);
 					_serial_no = sn;
 					found = true;
 					break;
@@ -207,23 +239,97 @@ void RealSenseNodeFactory::getDevice(rs2::device_list list)
 		try
 		{
 			ROS_INFO("Resetting device...");
-			_device.hardware_reset();
-			_device = rs2::device();
+			rs2::device dev(_device);
+			{
+				std::lock_guard<std::mutex> lock(_query_mutex);
+				_reset_device = dev;
+				_device = rs2::device();
+			}
+			dev.hardware_reset();
 		}
 		catch(const std::exception& ex)
 		{
 			ROS_WARN_STREAM("An exception has been thrown: " << ex.what());
+			std::lock_guard<std::mutex> lock(_query_mutex);
+			_reset_device = rs2::device();
 		}
 	}
 }
 
 void RealSenseNodeFactory::change_device_callback(rs2::event_information& info)
 {
-	if (info.was_removed(_device))
+	rs2::device device;
+	{
+		std::lock_guard<std::mutex> lock(_query_mutex);
+		device = _device;
+	}
+	if (device && info.was_removed(device))
 	{
 		ROS_ERROR("The device has been disconnected!");
 		reset();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_query_mutex);
+		if (_reset_device && info.was_removed(_reset_device))
+		{
+			_reset_device = rs2::device();
+		}
+		if (!_device && info.get_new_devices().size() > 0)
+		{
+			_attach_start_time = std::chrono::steady_clock::now();
+		}
+		_devices_changed = true;
 	}
+	_query_cv.notify_all();
+}
+
+void RealSenseNodeFactory::queryDevicesLoop()
+{
+	// Devices are looked for whenever the context reports a change. The timeout only covers devices that were busy.
+	std::chrono::milliseconds timespan(6000);
+	std::unique_lock<std::mutex> lock(_query_mutex);
+	while (_is_alive && !_device)
+	{
+		_devices_changed = false;
+		// A device that was just reset is still listed until it leaves the bus. Don't attach to it before that.
+		if (!_reset_device)
+		{
+			lock.unlock();
+			getDevice(_ctx.query_devices());
+			lock.lock();
+		}
+		if (_device)
+		{
+			auto attach_start_time = _attach_start_time;
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - attach_start_time).count();
+			lock.unlock();
+			ROS_INFO_STREAM("Device " << _serial_no << " attached " << elapsed << " ms after it was connected.");
+			if (_realSenseNode && _realSenseNode->warmRestart(_device))
+			{
+				elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - attach_start_time).count();
+				ROS_INFO_STREAM("Device " << _serial_no << " recovered with a warm restart " << elapsed << " ms after it was connected.");
+				return;
+			}
+			StartDevice();
+			return;
+		}
+		if (!_query_cv.wait_for(lock, timespan, [this]{ return _devices_changed || !_is_alive; }))
+		{
+			_reset_device = rs2::device();
+		}
+	}
+}
+
+void RealSenseNodeFactory::onFirstFrame()
+{
+	std::chrono::steady_clock::time_point attach_start_time;
+	{
+		std::lock_guard<std::mutex> lock(_query_mutex);
+		attach_start_time = _attach_start_time;
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - attach_start_time).count();
+	ROS_INFO_STREAM("Device " << _serial_no << " published its first frame " << elapsed << " ms after it was connected.");
 }
 
 bool RealSenseNodeFactory::toggle_sensor_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res)
@@ -237,6 +343,96 @@ bool RealSenseNodeFactory::toggle_sensor_callback(std_srvs::SetBool::Request &re
   return true;
 }
 
+bool RealSenseNodeFactory::pause_sensor_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res)
+{
+  if (!_realSenseNode)
+  {
+    res.success=false;
+    res.message="No device is attached";
+    return true;
+  }
+  if (req.data)
+    ROS_INFO_STREAM("pausing sensor");
+  else
+    ROS_INFO_STREAM("resuming sensor");
+  _realSenseNode->pauseSensors(req.data);
+  res.success=true;
+  return true;
+}
+
+bool RealSenseNodeFactory::record_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res)
+{
+  if (!_realSenseNode)
+  {
+    res.success=false;
+    res.message="No device is attached";
+    return true;
+  }
+  res.success=_realSenseNode->setRecording(req.data, res.message);
+  return true;
+}
+
+void RealSenseNodeFactory::advertisePlaybackServices(ros::NodeHandle& nh)
+{
+	if (!playback_pause_srv)
+	{
+		playback_pause_srv = nh.advertiseService("playback/pause", &RealSenseNodeFactory::playback_pause_callback, this);
+		playback_step_srv = nh.advertiseService("playback/step", &RealSenseNodeFactory::playback_step_callback, this);
+		playback_seek_srv = nh.advertiseService("playback/seek", &RealSenseNodeFactory::playback_seek_callback, this);
+		playback_loop_srv = nh.advertiseService("playback/loop", &RealSenseNodeFactory::playback_loop_callback, this);
+	}
+}
+
+bool RealSenseNodeFactory::playback_pause_callback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res)
+{
+  _playback_controller->setPaused(req.data);
+  res.success=true;
+  res.message=playback_status_to_string(_playback_controller->getStatus());
+  return true;
+}
+
+bool RealSenseNodeFactory::playback_step_callback(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
+{
+  res.success=_playback_controller->step();
+  res.message=res.success ? playback_status_to_string(_playback_controller->getStatus()) : "Playback is not paused";
+  return true;
+}
+
+bool RealSenseNodeFactory::playback_seek_callback(PlaybackSeek::Request &req, PlaybackSeek::Response &res)
+{
+  try
+  {
+    _playback_controller->seek(req.position);
+  }
+  catch(const std::out_of_range& ex)
+  {
+    res.success=false;
+    res.message=ex.what();
+    return true;
+  }
+  ROS_INFO_STREAM("playback seeked to " << req.position << " s");
+  res.success=true;
+  res.message=playback_status_to_string(_playback_controller->getStatus());
+  return true;
+}
+
+bool RealSenseNodeFactory::playback_loop_callback(PlaybackLoop::Request &req, PlaybackLoop::Response &res)
+{
+  try
+  {
+    _playback_controller->setLoop(req.start, req.end);
+  }
+  catch(const std::out_of_range& ex)
+  {
+    res.success=false;
+    res.message=ex.what();
+    return true;
+  }
+  res.success=true;
+  res.message=playback_status_to_string(_playback_controller->getStatus());
+  return true;
+}
+
 void RealSenseNodeFactory::onInit()
 {
 	auto nh = getNodeHandle();
@@ -245,7 +441,11 @@ void RealSenseNodeFactory::onInit()
 
 void RealSenseNodeFactory::initialize(const ros::WallTimerEvent &ignored)
 {
-	_device = rs2::device();
+	{
+		std::lock_guard<std::mutex> lock(_query_mutex);
+		_device = rs2::device();
+		_attach_start_time = std::chrono::steady_clock::now();
+	}
 	try
 	{
 #ifdef BPDEBUG
@@ -263,49 +463,72 @@ void RealSenseNodeFactory::initialize(const ros::WallTimerEvent &ignored)
 		{
 			toggle_sensor_srv = nh.advertiseService("enable", &RealSenseNodeFactory::toggle_sensor_callback, this);
 		}
+		if (!pause_sensor_srv)
+		{
+			pause_sensor_srv = nh.advertiseService("pause", &RealSenseNodeFactory::pause_sensor_callback, this);
+		}
+		if (!record_srv)
+		{
+			record_srv = nh.advertiseService("record", &RealSenseNodeFactory::record_callback, this);
+		}
 		std::string rosbag_filename("");
 		privateNh.param("rosbag_filename", rosbag_filename, std::string(""));
+		std::string synthetic_device("");
+		privateNh.param("synthetic_device", synthetic_device, std::string(""));
 
 		if (!rosbag_filename.empty())
 		{
+			bool playback_real_time;
+			privateNh.param("playback_real_time", playback_real_time, PLAYBACK_REAL_TIME);
 			{
-				ROS_INFO_STREAM("publish topics from rosbag file: " << rosbag_filename.c_str());
+				ROS_INFO_STREAM("publish topics from rosbag file: " << rosbag_filename.c_str() << (playback_real_time ? "" : ", as fast as they are processed"));
 				auto pipe = std::make_shared<rs2::pipeline>();
 				rs2::config cfg;
 				cfg.enable_device_from_file(rosbag_filename.c_str(), false);
 				cfg.enable_all_streams();
 				pipe->start(cfg); //File will be opened in read mode at this point
-				_device = pipe->get_active_profile().get_device();
+				setDevice(pipe->get_active_profile().get_device());
 				_serial_no = _device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
 			}
 			if (_device)
 			{
+				// At the end of the file librealsense stops the sensors. Playing on starts them again. There is no node
+				// to restart if it failed to start.
+				_playback_controller = std::make_shared<PlaybackController>(_device, playback_real_time,
+					[this]()
+					{
+						std::shared_ptr<InterfaceRealSenseNode> node(_realSenseNode);
+						if (!node)
+							return;
+						node->toggleSensors(false);
+						node->toggleSensors(true);
+					});
 				StartDevice();
+				advertisePlaybackServices(nh);
+			}
+		}
+		else if (!synthetic_device.empty())
+		{
+			ROS_INFO_STREAM("publish topics from synthetic device: " << synthetic_device);
+			_synthetic_device = std::make_shared<SyntheticDevice>(synthetic_device, _serial_no, privateNh);
+			setDevice(_synthetic_device->getDevice());
+			_serial_no = _synthetic_device->getSerialNumber();
+			StartDevice();
+			if (!_reset_srv)
+			{
+				_reset_srv = privateNh.advertiseService("reset", &RealSenseNodeFactory::handleReset, this);
 			}
 		}
 		else
 		{
 			privateNh.param("initial_reset", _initial_reset, false);
+			privateNh.param("warm_restart", _warm_restart, WARM_RESTART);
+
+			std::function<void(rs2::event_information&)> change_device_callback_function = [this](rs2::event_information& info){change_device_callback(info);};
+			_ctx.set_devices_changed_callback(change_device_callback_function);
 
 			_is_alive = true;
-			_query_thread = std::thread([=]()
-						{
-							std::chrono::milliseconds timespan(6000);
-							while (_is_alive && !_device)
-							{
-								getDevice(_ctx.query_devices());
-								if (_device)
-								{
-									std::function<void(rs2::event_information&)> change_device_callback_function = [this](rs2::event_information& info){change_device_callback(info);};
-									_ctx.set_devices_changed_callback(change_device_callback_function);
-									StartDevice();
-								}
-								else
-								{
-									std::this_thread::sleep_for(timespan);
-								}
-							}
-						});
+			_query_thread = std::thread([this](){ queryDevicesLoop(); });
 			if (!_reset_srv)
 			{
 				_reset_srv = privateNh.advertiseService("reset", &RealSenseNodeFactory::handleReset, this);
@@ -334,39 +557,55 @@ void RealSenseNodeFactory::StartDevice()
 		// TODO
 		std::string pid_str(_device.get_info(RS2_CAMERA_INFO_PRODUCT_ID));
 		uint16_t pid = std::stoi(pid_str, 0, 16);
-		switch(pid)
+		std::shared_ptr<BaseRealSenseNode> realSenseNode;
+		if (_synthetic_device)
 		{
-		case SR300_PID:
-		case SR300v2_PID:
-		case RS400_PID:
-		case RS405_PID:
-		case RS410_PID:
-		case RS460_PID:
-		case RS415_PID:
-		case RS420_PID:
-		case RS420_MM_PID:
-		case RS430_PID:
-		case RS430_MM_PID:
-		case RS430_MM_RGB_PID:
-		case RS435_RGB_PID:
-		case RS435i_RGB_PID:
-		case RS455_PID:
-		case RS465_PID:
-		case RS_USB2_PID:
-		case RS_L515_PID_PRE_PRQ:
-		case RS_L515_PID:
-		case RS_L535_PID:
-			_realSenseNode = std::shared_ptr<BaseRealSenseNode>(new BaseRealSenseNode(nh, privateNh, _device, _serial_no));
-			break;
-		case RS_T265_PID:
-			_realSenseNode = std::shared_ptr<T265RealsenseNode>(new T265RealsenseNode(nh, privateNh, _device, _serial_no));
-			break;
-		default:
-			ROS_FATAL_STREAM("Unsupported device!" << " Product ID: 0x" << pid_str);
-			ros::shutdown();
-			exit(1);
+			// Synthetic devices, the T265 layout included, have no vendor extensions. The base node handles all their streams.
+			realSenseNode = std::shared_ptr<BaseRealSenseNode>(new BaseRealSenseNode(nh, privateNh, _device, _serial_no));
 		}
-		assert(_realSenseNode);
+		else
+		{
+			switch(pid)
+			{
+			case SR300_PID:
+			case SR300v2_PID:
+			case RS400_PID:
+			case RS405_PID:
+			case RS410_PID:
+			case RS460_PID:
+			case RS415_PID:
+			case RS420_PID:
+			case RS420_MM_PID:
+			case RS430_PID:
+			case RS430_MM_PID:
+			case RS430_MM_RGB_PID:
+			case RS435_RGB_PID:
+			case RS435i_RGB_PID:
+			case RS455_PID:
+			case RS465_PID:
+			case RS_USB2_PID:
+			case RS_L515_PID_PRE_PRQ:
+			case RS_L515_PID:
+			case RS_L535_PID:
+				realSenseNode = std::shared_ptr<BaseRealSenseNode>(new BaseRealSenseNode(nh, privateNh, _device, _serial_no));
+				break;
+			case RS_T265_PID:
+				realSenseNode = std::shared_ptr<T265RealsenseNode>(new T265RealsenseNode(nh, privateNh, _device, _serial_no));
+				break;
+			default:
+				ROS_FATAL_STREAM("Unsupported device!" << " Product ID: 0x" << pid_str);
+				ros::shutdown();
+				exit(1);
+			}
+		}
+		assert(realSenseNode);
+		realSenseNode->setFirstFrameCallback([this](){ onFirstFrame(); });
+		if (_playback_controller)
+		{
+			std::shared_ptr<PlaybackController> playback_controller(_playback_controller);
+			realSenseNode->setFrameFilter([playback_controller](const rs2::frame& frame){ return playback_controller->admit(frame); });
+		}
+		_realSenseNode = realSenseNode;
 		_realSenseNode->publishTopics();
 	}
 	catch (const rs2::error& e)
@@ -377,27 +616,39 @@ void RealSenseNodeFactory::StartDevice()
 
 void RealSenseNodeFactory::reset()
 {
-	_is_alive = false;
-	if (_query_thread.joinable())
-	{
-		_query_thread.join();
-	}
+	stopQueryThread();
 
 	try
 	{
-		_realSenseNode.reset();
-		if (_device)
+		// With a warm restart the node keeps its publishers and waits for the device to come back.
+		if (!_warm_restart || _synthetic_device)
+			_realSenseNode.reset();
+		if (_synthetic_device)
+		{
+			_synthetic_device.reset();
+			setDevice(rs2::device());
+		}
+		else if (_device)
 		{
-			_device.hardware_reset();
-			_device = rs2::device();
+			rs2::device dev(_device);
+			// Set before the reset, so its removal event can't be missed.
+			{
+				std::lock_guard<std::mutex> lock(_query_mutex);
+				_device = rs2::device();
+				_reset_device = dev;
+			}
+			dev.hardware_reset();
 		}
 	}
 	catch (const rs2::error& e)
 	{
 		ROS_ERROR_STREAM("Exception: " << e.what());
+		std::lock_guard<std::mutex> lock(_query_mutex);
+		_reset_device = rs2::device();
 	}
 
-	_init_timer = getNodeHandle().createWallTimer(ros::WallDuration(1.0), &RealSenseNodeFactory::initialize, this, true);
+	// No need to wait here: the query thread holds off until the reset device has left.
+	_init_timer = getNodeHandle().createWallTimer(ros::WallDuration(0.01), &RealSenseNodeFactory::initialize, this, true);
 }
 
 bool RealSenseNodeFactory::handleReset(std_srvs::Empty::Request& request, std_srvs::Empty::Response& response)
@@ -406,7 +657,7 @@ bool RealSenseNodeFactory::handleReset(std_srvs::Empty::Request& request, std_sr
 	return true;
 }
 
-void RealSenseNodeFactory::tryGetLogSeverity(rs2_log_severity& severity) const
+void RealSenseNodeFactory::tryGetLogSeverity(rs2_log_severity& severity)
 {
 	static const char* severity_var_name = "LRS_LOG_LEVEL";
 	auto content = getenv(severity_var_name);
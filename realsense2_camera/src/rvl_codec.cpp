@@ -0,0 +1,152 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/rvl_codec.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    class NibbleWriter
+    {
+    public:
+        explicit NibbleWriter(uint8_t* output) : _output(output), _word(0), _nibbles(0) {}
+
+        void write(uint32_t value)
+        {
+            do
+            {
+                uint32_t nibble = value & 0x7;
+                value >>= 3;
+                if (value)
+                    nibble |= 0x8;
+                _word = (_word << 4) | nibble;
+                if (++_nibbles == 8)
+                    flush();
+            } while (value);
+        }
+
+        size_t finish(uint8_t* start)
+        {
+            if (_nibbles)
+            {
+                _word <<= 4 * (8 - _nibbles);
+                flush();
+            }
+            return _output - start;
+        }
+
+    private:
+        void flush()
+        {
+            std::memcpy(_output, &_word, sizeof(_word));
+            _output += sizeof(_word);
+            _word = 0;
+            _nibbles = 0;
+        }
+
+        uint8_t* _output;
+        uint32_t _word;
+        int _nibbles;
+    };
+
+    class NibbleReader
+    {
+    public:
+        NibbleReader(const uint8_t* input, size_t input_size) : _input(input), _end(input + input_size), _word(0), _nibbles(0) {}
+
+        uint32_t read()
+        {
+            uint32_t value(0);
+            int shift(0);
+            uint32_t nibble;
+            do
+            {
+                if (!_nibbles)
+                {
+                    if (_end - _input < static_cast<ptrdiff_t>(sizeof(_word)))
+                        throw std::runtime_error("RVL data is truncated");
+                    std::memcpy(&_word, _input, sizeof(_word));
+                    _input += sizeof(_word);
+                    _nibbles = 8;
+                }
+                nibble = _word >> 28;
+                _word <<= 4;
+                _nibbles--;
+                if (shift > 29)
+                    throw std::runtime_error("RVL data is corrupted");
+                value |= (nibble & 0x7) << shift;
+                shift += 3;
+            } while (nibble & 0x8);
+            return value;
+        }
+
+    private:
+        const uint8_t* _input;
+        const uint8_t* _end;
+        uint32_t _word;
+        int _nibbles;
+    };
+}
+
+size_t rvl::maxEncodedSize(size_t num_pixels)
+{
+    // A valid pixel takes at most 6 nibbles and every pixel adds at most one run length nibble. Long runs take
+    // fewer nibbles per pixel. Leave room for the two run lengths around the last pixel and the partial last word.
+    return (num_pixels * 7 + 1) / 2 + 32;
+}
+
+size_t rvl::encode(const uint16_t* input, size_t num_pixels, uint8_t* output)
+{
+    NibbleWriter writer(output);
+    const uint16_t* end(input + num_pixels);
+    int previous(0);
+    while (input != end)
+    {
+        const uint16_t* run_start(input);
+        while (input != end && !*input)
+            input++;
+        writer.write(static_cast<uint32_t>(input - run_start));
+
+        run_start = input;
+        while (input != end && *input)
+            input++;
+        writer.write(static_cast<uint32_t>(input - run_start));
+
+        for (const uint16_t* pixel = run_start; pixel != input; pixel++)
+        {
+            int delta(*pixel - previous);
+            writer.write(static_cast<uint32_t>((delta << 1) ^ (delta >> 31)));
+            previous = *pixel;
+        }
+    }
+    return writer.finish(output);
+}
+
+void rvl::decode(const uint8_t* input, size_t input_size, uint16_t* output, size_t num_pixels)
+{
+    NibbleReader reader(input, input_size);
+    uint16_t* end(output + num_pixels);
+    int previous(0);
+    while (output != end)
+    {
+        uint32_t zeros(reader.read());
+        if (zeros > static_cast<size_t>(end - output))
+            throw std::runtime_error("RVL data holds more pixels than the image");
+        std::memset(output, 0, zeros * sizeof(uint16_t));
+        output += zeros;
+
+        uint32_t nonzeros(reader.read());
+        if (nonzeros > static_cast<size_t>(end - output))
+            throw std::runtime_error("RVL data holds more pixels than the image");
+        for (; nonzeros; nonzeros--)
+        {
+            uint32_t positive(reader.read());
+            int delta(static_cast<int>(positive >> 1) ^ -static_cast<int>(positive & 1));
+            previous = static_cast<uint16_t>(previous + delta);
+            *output++ = static_cast<uint16_t>(previous);
+        }
+    }
+}
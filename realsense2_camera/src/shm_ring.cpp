@@ -0,0 +1,201 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/shm_ring.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    size_t align(size_t size)
+    {
+        return (size + SHM_RING_ALIGNMENT - 1) / SHM_RING_ALIGNMENT * SHM_RING_ALIGNMENT;
+    }
+
+    size_t slotOffset(uint32_t slot, size_t slot_size)
+    {
+        return align(sizeof(ShmRingHeader)) + slot * (align(sizeof(ShmSlotHeader)) + align(slot_size));
+    }
+
+    std::string errorString(const std::string& what, const std::string& name)
+    {
+        return what + " shared memory " + name + ": " + strerror(errno);
+    }
+}
+
+ShmRingWriter::ShmRingWriter(const std::string& name, uint32_t slot_count, size_t slot_size) :
+    _name(name),
+    _slot_count(slot_count),
+    _slot_size(slot_size),
+    _segment_size(slotOffset(slot_count, slot_size)),
+    _segment(nullptr),
+    _write_count(0)
+{
+    if (0 == slot_count || 0 == slot_size || slot_size > UINT32_MAX)
+        throw std::runtime_error("Invalid shared memory ring size for " + name);
+
+    shm_unlink(_name.c_str());
+    int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        throw std::runtime_error(errorString("Failed to create", _name));
+    if (ftruncate(fd, _segment_size) != 0)
+    {
+        std::string error(errorString("Failed to size", _name));
+        close(fd);
+        shm_unlink(_name.c_str());
+        throw std::runtime_error(error);
+    }
+    void* segment = mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == segment)
+    {
+        std::string error(errorString("Failed to map", _name));
+        shm_unlink(_name.c_str());
+        throw std::runtime_error(error);
+    }
+    _segment = static_cast<uint8_t*>(segment);
+
+    // The new object is zero filled: every slot starts at sequence 0, which no frame ever gets.
+    ShmRingHeader* header = new (_segment) ShmRingHeader();
+    header->slot_count = _slot_count;
+    header->slot_size = static_cast<uint32_t>(_slot_size);
+    header->version = SHM_RING_VERSION;
+    header->write_count.store(0);
+    for (uint32_t slot = 0; slot < _slot_count; slot++)
+    {
+        ShmSlotHeader* slot_header = new (_segment + slotOffset(slot, _slot_size)) ShmSlotHeader();
+        slot_header->sequence.store(0);
+        slot_header->size = 0;
+    }
+    // Readers check the magic last written.
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+}
+
+ShmRingWriter::~ShmRingWriter()
+{
+    munmap(_segment, _segment_size);
+    shm_unlink(_name.c_str());
+}
+
+bool ShmRingWriter::write(const void* data, size_t size, uint32_t& slot, uint64_t& sequence)
+{
+    if (size > _slot_size)
+        return false;
+
+    slot = static_cast<uint32_t>(_write_count % _slot_count);
+    uint8_t* slot_start(_segment + slotOffset(slot, _slot_size));
+    ShmSlotHeader* slot_header = reinterpret_cast<ShmSlotHeader*>(slot_start);
+
+    // Odd while writing: readers of the previous contents see the change when they check again.
+    slot_header->sequence.store(2 * _write_count + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(slot_start + align(sizeof(ShmSlotHeader)), data, size);
+    slot_header->size = static_cast<uint32_t>(size);
+    sequence = 2 * _write_count + 2;
+    slot_header->sequence.store(sequence, std::memory_order_release);
+
+    _write_count++;
+    reinterpret_cast<ShmRingHeader*>(_segment)->write_count.store(_write_count, std::memory_order_relaxed);
+    return true;
+}
+
+size_t ShmRingWriter::unlinkStale(const std::string& prefix)
+{
+    // POSIX shared memory objects are the files of /dev/shm on Linux, named without their leading slash.
+    std::string file_prefix(prefix.substr(prefix.find_first_not_of('/')));
+    DIR* dir(opendir("/dev/shm"));
+    if (!dir)
+        return 0;
+    size_t count(0);
+    while (dirent* entry = readdir(dir))
+    {
+        std::string file_name(entry->d_name);
+        if (file_name.compare(0, file_prefix.size(), file_prefix) != 0)
+            continue;
+        char* pid_end(nullptr);
+        long pid(std::strtol(file_name.c_str() + file_prefix.size(), &pid_end, 10));
+        if (pid <= 0 || pid_end == file_name.c_str() + file_prefix.size() || '_' != *pid_end)
+            continue;
+        if (0 == kill(static_cast<pid_t>(pid), 0) || ESRCH != errno)
+            continue;
+        if (0 == shm_unlink(("/" + file_name).c_str()))
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+ShmRingReader::ShmRingReader(const std::string& name) :
+    _name(name),
+    _segment(nullptr)
+{
+    int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::runtime_error(errorString("Failed to open", _name));
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) != 0 || static_cast<size_t>(stat_buf.st_size) < sizeof(ShmRingHeader))
+    {
+        close(fd);
+        throw std::runtime_error("Shared memory " + _name + " is not a frame ring");
+    }
+    _segment_size = stat_buf.st_size;
+    void* segment = mmap(nullptr, _segment_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == segment)
+        throw std::runtime_error(errorString("Failed to map", _name));
+    _segment = static_cast<uint8_t*>(segment);
+
+    const ShmRingHeader* header = reinterpret_cast<const ShmRingHeader*>(_segment);
+    bool is_valid(header->magic == SHM_RING_MAGIC);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    is_valid = is_valid && header->version == SHM_RING_VERSION &&
+               slotOffset(header->slot_count, header->slot_size) <= _segment_size;
+    if (!is_valid)
+    {
+        munmap(_segment, _segment_size);
+        throw std::runtime_error("Shared memory " + _name + " is not a frame ring of version " + std::to_string(SHM_RING_VERSION));
+    }
+    _slot_count = header->slot_count;
+    _slot_size = header->slot_size;
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    munmap(_segment, _segment_size);
+}
+
+const ShmSlotHeader* ShmRingReader::slotHeader(uint32_t slot) const
+{
+    return reinterpret_cast<const ShmSlotHeader*>(_segment + slotOffset(slot, _slot_size));
+}
+
+const uint8_t* ShmRingReader::data(uint32_t slot, uint64_t sequence, uint32_t& size) const
+{
+    if (slot >= _slot_count || !isValid(slot, sequence))
+        return nullptr;
+    size = slotHeader(slot)->size;
+    if (size > _slot_size || !isValid(slot, sequence))
+        return nullptr;
+    return reinterpret_cast<const uint8_t*>(slotHeader(slot)) + align(sizeof(ShmSlotHeader));
+}
+
+bool ShmRingReader::isValid(uint32_t slot, uint64_t sequence) const
+{
+    if (slot >= _slot_count)
+        return false;
+    // Orders the caller's reads of the payload before the check.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slotHeader(slot)->sequence.load(std::memory_order_acquire) == sequence;
+}
@@ -0,0 +1,36 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/shm_subscriber_plugin.h"
+#include <pluginlib/class_list_macros.h>
+#include <cstring>
+
+using namespace realsense2_camera;
+
+void ShmSubscriberPlugin::internalCallback(const ShmFrameConstPtr& message, const Callback& user_cb)
+{
+    const uint8_t* data(_reader.data(*message));
+    if (!data)
+    {
+        ROS_DEBUG_STREAM("Frame " << message->header.seq << " of " << getTopic() << " was overwritten before it was read");
+        return;
+    }
+
+    sensor_msgs::ImagePtr image(new sensor_msgs::Image());
+    image->header = message->header;
+    image->height = message->height;
+    image->width = message->width;
+    image->encoding = message->encoding;
+    image->is_bigendian = message->is_bigendian;
+    image->step = message->step;
+    image->data.resize(message->size);
+    std::memcpy(image->data.data(), data, message->size);
+    if (!_reader.isValid(*message))
+    {
+        ROS_DEBUG_STREAM("Frame " << message->header.seq << " of " << getTopic() << " was overwritten while it was read");
+        return;
+    }
+    user_cb(image);
+}
+
+PLUGINLIB_EXPORT_CLASS(realsense2_camera::ShmSubscriberPlugin, image_transport::SubscriberPlugin)
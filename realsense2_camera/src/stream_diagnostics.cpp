@@ -0,0 +1,124 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/stream_diagnostics.h"
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // Bucket 0 holds the latencies below it, bucket i up to LATENCY_BASE_US * 2^(i/4).
+    const double LATENCY_BASE_US = 100;
+    const double FREQUENCY_TOLERANCE = 0.1;
+}
+
+StreamDiagnostics::StreamDiagnostics(const std::string& name, double expected_frequency) :
+    _name(name),
+    _expected_frequency(expected_frequency),
+    _frames(0),
+    _last_tick_ns(0),
+    _intervals(0),
+    _interval_sum_us(0),
+    _interval_square_sum_us(0),
+    _max_latency_us(0),
+    _last_report_time(std::chrono::steady_clock::now())
+{
+    for (auto& bucket : _latency_histogram)
+    {
+        bucket = 0;
+    }
+    ROS_INFO("Expected frequency for %s = %.5f", name.c_str(), expected_frequency);
+}
+
+int StreamDiagnostics::latencyBucket(int64_t latency_us)
+{
+    if (latency_us < LATENCY_BASE_US)
+        return 0;
+    return std::min(LATENCY_BUCKETS - 1, 1 + static_cast<int>(4 * std::log2(latency_us / LATENCY_BASE_US)));
+}
+
+double StreamDiagnostics::latencyBucketLimitMs(int bucket)
+{
+    return LATENCY_BASE_US * std::exp2(bucket / 4.0) / 1000;
+}
+
+void StreamDiagnostics::tick(double latency_sec)
+{
+    int64_t now_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    _frames++;
+    int64_t last_tick_ns(_last_tick_ns.exchange(now_ns));
+    if (0 != last_tick_ns)
+    {
+        uint64_t interval_us((now_ns - last_tick_ns) / 1000);
+        _intervals++;
+        _interval_sum_us += interval_us;
+        _interval_square_sum_us += interval_us * interval_us;
+    }
+
+    int64_t latency_us(std::max<int64_t>(0, static_cast<int64_t>(latency_sec * 1e6)));
+    _latency_histogram[latencyBucket(latency_us)]++;
+    int64_t max_latency_us(_max_latency_us);
+    while (latency_us > max_latency_us && !_max_latency_us.compare_exchange_weak(max_latency_us, latency_us));
+}
+
+void StreamDiagnostics::diagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed_sec(std::chrono::duration<double>(now - _last_report_time).count());
+    _last_report_time = now;
+
+    uint32_t frames(_frames.exchange(0));
+    uint32_t intervals(_intervals.exchange(0));
+    double interval_sum_us(_interval_sum_us.exchange(0));
+    double interval_square_sum_us(_interval_square_sum_us.exchange(0));
+    double max_latency_ms(_max_latency_us.exchange(0) / 1000.0);
+    uint32_t latency_histogram[LATENCY_BUCKETS];
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+    {
+        latency_histogram[bucket] = _latency_histogram[bucket].exchange(0);
+    }
+
+    double frequency(elapsed_sec > 0 ? frames / elapsed_sec : 0);
+    if (0 == frames)
+        status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "No events recorded.");
+    else if (frequency < _expected_frequency * (1 - FREQUENCY_TOLERANCE))
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Frequency too low.");
+    else if (frequency > _expected_frequency * (1 + FREQUENCY_TOLERANCE))
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Frequency too high.");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Desired frequency met");
+
+    status.add("Events in window", frames);
+    status.add("Duration of window (s)", elapsed_sec);
+    status.add("Actual frequency (Hz)", frequency);
+    status.add("Target frequency (Hz)", _expected_frequency);
+    if (0 != intervals)
+    {
+        double mean_us(interval_sum_us / intervals);
+        double variance_us(std::max(0.0, interval_square_sum_us / intervals - mean_us * mean_us));
+        status.add("Jitter [ms]", std::sqrt(variance_us) / 1000);
+    }
+    if (0 != frames)
+    {
+        // The upper limit of the bucket the percentile falls in.
+        auto percentile = [&](double fraction)
+        {
+            uint32_t rank(std::max<uint32_t>(1, static_cast<uint32_t>(std::ceil(fraction * frames))));
+            uint32_t count(0);
+            for (int bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++)
+            {
+                count += latency_histogram[bucket];
+                if (count >= rank)
+                    return std::min(latencyBucketLimitMs(bucket), max_latency_ms);
+            }
+            return max_latency_ms;
+        };
+        status.add("Latency p50 [ms]", percentile(0.5));
+        status.add("Latency p90 [ms]", percentile(0.9));
+        status.add("Latency p99 [ms]", percentile(0.99));
+        status.add("Latency max [ms]", max_latency_ms);
+    }
+}
@@ -0,0 +1,655 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/synthetic_device.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    const float DEPTH_UNITS   = 0.001f;
+    const float FLOOR_Y       = 0.8f;     // Camera height above the floor [m].
+    const float BACK_WALL_Z   = 4.0f;
+    const float LEFT_WALL_X   = -2.0f;
+    const float BOX_HALF_SIZE = 0.25f;
+    const float HOLE_RATIO    = 0.01f;    // Random invalid depth pixels.
+    const float GRAVITY       = 9.81f;
+
+    enum Surface {BACK_WALL, FLOOR, LEFT_WALL, BOX};
+
+    // Per frame state of the moving parts of the scene.
+    struct SceneState
+    {
+        SceneState(double time_ms)
+        {
+            double t = time_ms / 1000.0;
+            box_z = 1.5 + 0.3 * std::sin(0.7 * t);
+            box_cx = 0.6 * std::sin(0.4 * t);
+        }
+        float box_z;
+        float box_cx;
+    };
+
+    uint32_t hash3(uint32_t a, uint32_t b, uint32_t c)
+    {
+        uint32_t h = (a * 0x8da6b343u) ^ (b * 0xd8163841u) ^ (c * 0xcb1ab31fu);
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        h *= 0x297a2d39u;
+        h ^= h >> 15;
+        return h;
+    }
+
+    float unit(uint32_t h)
+    {
+        return (h >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Approximately normal distributed, zero mean, unit variance.
+    float gaussian(uint32_t h)
+    {
+        uint32_t h2 = hash3(h, 0x9e3779b9u, 1);
+        uint32_t h3 = hash3(h2, 0x7f4a7c15u, 2);
+        return (unit(h) + unit(h2) + unit(h3) - 1.5f) * 2.0f;
+    }
+
+    // Depth along the optical axis of the ray (x, y, 1) leaving an imager located at (origin_x, 0, 0).
+    float sceneDepth(const SceneState& scene, float origin_x, float x, float y, Surface& surface)
+    {
+        float z = BACK_WALL_Z;
+        surface = BACK_WALL;
+        if (y > 0)
+        {
+            float floor_z = FLOOR_Y / y;
+            if (floor_z < z)
+            {
+                z = floor_z;
+                surface = FLOOR;
+            }
+        }
+        if (x < 0)
+        {
+            float wall_z = (LEFT_WALL_X - origin_x) / x;
+            if (wall_z > 0 && wall_z < z)
+            {
+                z = wall_z;
+                surface = LEFT_WALL;
+            }
+        }
+        if (scene.box_z < z)
+        {
+            float bx = origin_x + x * scene.box_z;
+            float by = y * scene.box_z;
+            if (std::abs(bx - scene.box_cx) < BOX_HALF_SIZE && std::abs(by) < BOX_HALF_SIZE)
+            {
+                z = scene.box_z;
+                surface = BOX;
+            }
+        }
+        return z;
+    }
+
+    // Checkerboard texture on the world surface hit by the ray, in [0, 1].
+    float sceneTexture(const SceneState& scene, float origin_x, float x, float y, float z, Surface surface)
+    {
+        float wx = origin_x + x * z;
+        float wy = y * z;
+        float a(0), b(0);
+        switch (surface)
+        {
+            case FLOOR:     a = wx; b = z; break;
+            case LEFT_WALL: a = z;  b = wy; break;
+            case BOX:       a = (wx - scene.box_cx) * 4; b = wy * 4; break;
+            default:        a = wx; b = wy; break;
+        }
+        bool odd = ((static_cast<int>(std::floor(a * 2)) + static_cast<int>(std::floor(b * 2))) & 1);
+        return odd ? 0.35f : 0.85f;
+    }
+
+    void pixelToRay(const rs2_intrinsics& intrin, int u, int v, float& x, float& y)
+    {
+        x = (u - intrin.ppx) / intrin.fx;
+        y = (v - intrin.ppy) / intrin.fy;
+    }
+
+    std::string syntheticStreamName(rs2_stream stream_type)
+    {
+        switch (stream_type)
+        {
+            case RS2_STREAM_DEPTH:      return "depth";
+            case RS2_STREAM_COLOR:      return "color";
+            case RS2_STREAM_INFRARED:   return "infra";
+            case RS2_STREAM_FISHEYE:    return "fisheye";
+            case RS2_STREAM_GYRO:       return "gyro";
+            case RS2_STREAM_ACCEL:      return "accel";
+            case RS2_STREAM_POSE:       return "pose";
+            case RS2_STREAM_CONFIDENCE: return "confidence";
+            default:                    return rs2_stream_to_string(stream_type);
+        }
+    }
+
+    int bytesPerPixel(rs2_format format)
+    {
+        switch (format)
+        {
+            case RS2_FORMAT_Z16:  return 2;
+            case RS2_FORMAT_RGB8: return 3;
+            default:              return 1;
+        }
+    }
+}
+
+bool SyntheticDevice::isSupportedLayout(const std::string& layout)
+{
+    return (layout == "d435i" || layout == "l515" || layout == "t265");
+}
+
+SyntheticDevice::SyntheticDevice(const std::string& layout, const std::string& serial_no, ros::NodeHandle& privateNodeHandle) :
+    _pnh(privateNodeHandle), _layout(layout), _serial_no(serial_no),
+    _is_alive(true), _start_time(std::chrono::steady_clock::now()), _next_uid(1)
+{
+    if (!isSupportedLayout(_layout))
+    {
+        throw std::runtime_error("Unsupported synthetic device layout \"" + _layout + "\". Supported layouts are: d435i, l515, t265");
+    }
+
+    if (_serial_no.empty())
+    {
+        static std::atomic<int> device_counter(0);
+        std::stringstream ss;
+        ss << "SYN" << std::setw(9) << std::setfill('0') << ++device_counter;
+        _serial_no = ss.str();
+    }
+
+    std::string name, pid, product_line;
+    if (_layout == "d435i")
+    {
+        name = "Intel RealSense D435I (synthetic)";
+        pid = "0B3A";
+        product_line = "D400";
+
+        auto& stereo = addSensor("Stereo Module");
+        stereo.sensor.add_read_only_option(RS2_OPTION_DEPTH_UNITS, DEPTH_UNITS);
+        stereo.sensor.add_read_only_option(RS2_OPTION_STEREO_BASELINE, 50.0f);
+        stereo.sensor.add_read_only_option(RS2_OPTION_ASIC_TEMPERATURE, 35.0f);
+        stereo.sensor.add_read_only_option(RS2_OPTION_PROJECTOR_TEMPERATURE, 33.0f);
+        stereo.sensor.add_option(RS2_OPTION_EXPOSURE, {1, 165000, 8500, 1});
+        stereo.sensor.add_option(RS2_OPTION_GAIN, {16, 248, 16, 1});
+        addVideoStream(stereo, {RS2_STREAM_DEPTH, 0}, RS2_FORMAT_Z16, 848, 480, 30, 87, RS2_DISTORTION_BROWN_CONRADY, 0);
+        addVideoStream(stereo, {RS2_STREAM_INFRARED, 1}, RS2_FORMAT_Y8, 848, 480, 30, 87, RS2_DISTORTION_BROWN_CONRADY, 0);
+        addVideoStream(stereo, {RS2_STREAM_INFRARED, 2}, RS2_FORMAT_Y8, 848, 480, 30, 87, RS2_DISTORTION_BROWN_CONRADY, 0.05f);
+
+        auto& rgb = addSensor("RGB Camera");
+        rgb.sensor.add_option(RS2_OPTION_EXPOSURE, {1, 10000, 156, 1});
+        rgb.sensor.add_option(RS2_OPTION_GAIN, {0, 128, 64, 1});
+        addVideoStream(rgb, {RS2_STREAM_COLOR, 0}, RS2_FORMAT_RGB8, 640, 480, 30, 69, RS2_DISTORTION_INVERSE_BROWN_CONRADY, 0.015f);
+
+        auto& motion = addSensor("Motion Module");
+        addMotionStream(motion, {RS2_STREAM_GYRO, 0}, 200);
+        addMotionStream(motion, {RS2_STREAM_ACCEL, 0}, 63);
+    }
+    else if (_layout == "l515")
+    {
+        name = "Intel RealSense L515 (synthetic)";
+        pid = "0B64";
+        product_line = "L500";
+
+        auto& depth = addSensor("L500 Depth Sensor");
+        depth.sensor.add_read_only_option(RS2_OPTION_DEPTH_UNITS, DEPTH_UNITS / 4);
+        depth.sensor.add_option(RS2_OPTION_GAIN, {0, 2, 1, 1});
+        addVideoStream(depth, {RS2_STREAM_DEPTH, 0}, RS2_FORMAT_Z16, 640, 480, 30, 70, RS2_DISTORTION_NONE, 0);
+        addVideoStream(depth, {RS2_STREAM_INFRARED, 0}, RS2_FORMAT_Y8, 640, 480, 30, 70, RS2_DISTORTION_NONE, 0);
+        addVideoStream(depth, {RS2_STREAM_CONFIDENCE, 0}, RS2_FORMAT_RAW8, 640, 480, 30, 70, RS2_DISTORTION_NONE, 0);
+
+        auto& rgb = addSensor("RGB Camera");
+        rgb.sensor.add_option(RS2_OPTION_EXPOSURE, {1, 10000, 156, 1});
+        rgb.sensor.add_option(RS2_OPTION_GAIN, {0, 128, 64, 1});
+        addVideoStream(rgb, {RS2_STREAM_COLOR, 0}, RS2_FORMAT_RGB8, 960, 540, 30, 70, RS2_DISTORTION_INVERSE_BROWN_CONRADY, 0.015f);
+
+        auto& motion = addSensor("Motion Module");
+        addMotionStream(motion, {RS2_STREAM_GYRO, 0}, 200);
+        addMotionStream(motion, {RS2_STREAM_ACCEL, 0}, 100);
+    }
+    else
+    {
+        name = "Intel RealSense T265 (synthetic)";
+        pid = "0B37";
+        product_line = "T200";
+
+        auto& tracking = addSensor("Tracking Module");
+        addVideoStream(tracking, {RS2_STREAM_FISHEYE, 1}, RS2_FORMAT_Y8, 848, 800, 30, 163, RS2_DISTORTION_KANNALA_BRANDT4, -0.032f);
+        addVideoStream(tracking, {RS2_STREAM_FISHEYE, 2}, RS2_FORMAT_Y8, 848, 800, 30, 163, RS2_DISTORTION_KANNALA_BRANDT4, 0.032f);
+        addMotionStream(tracking, {RS2_STREAM_GYRO, 0}, 200);
+        addMotionStream(tracking, {RS2_STREAM_ACCEL, 0}, 62);
+        addPoseStream(tracking, 200);
+    }
+
+    _dev.register_info(RS2_CAMERA_INFO_NAME, name);
+    _dev.register_info(RS2_CAMERA_INFO_SERIAL_NUMBER, _serial_no);
+    _dev.register_info(RS2_CAMERA_INFO_PRODUCT_ID, pid);
+    _dev.register_info(RS2_CAMERA_INFO_PRODUCT_LINE, product_line);
+    _dev.register_info(RS2_CAMERA_INFO_FIRMWARE_VERSION, "0.0.0.0");
+    _dev.register_info(RS2_CAMERA_INFO_PHYSICAL_PORT, "synthetic/" + _serial_no);
+    if (_layout == "d435i")
+        _dev.create_matcher(RS2_MATCHER_DLR_C);
+    else if (_layout == "l515")
+        _dev.create_matcher(RS2_MATCHER_DIC_C);
+
+    registerExtrinsics();
+
+    for (auto& sensor : _sensors)
+    {
+        SyntheticSensor* sensor_ptr(sensor.get());
+        _generator_threads.emplace_back([this, sensor_ptr](){ generatorLoop(*sensor_ptr); });
+    }
+    ROS_INFO_STREAM("Synthetic " << _layout << " device " << _serial_no << " was created.");
+}
+
+SyntheticDevice::~SyntheticDevice()
+{
+    _is_alive = false;
+    for (auto& t : _generator_threads)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+SyntheticDevice::SyntheticSensor& SyntheticDevice::addSensor(const std::string& name)
+{
+    auto sensor = std::make_shared<SyntheticSensor>(_dev.add_sensor(name));
+    _sensors.push_back(sensor);
+    return *sensor;
+}
+
+void SyntheticDevice::readStreamParams(const stream_index_pair& sip, int& width, int& height, int& fps) const
+{
+    // The same parameters select the profile in BaseRealSenseNode. Values <= 0 keep the layout's default.
+    std::string stream_name(syntheticStreamName(sip.first));
+    int value;
+    _pnh.param(stream_name + "_width", value, -1);
+    if (value > 0) width = value;
+    _pnh.param(stream_name + "_height", value, -1);
+    if (value > 0) height = value;
+    _pnh.param(stream_name + "_fps", value, -1);
+    if (value > 0) fps = value;
+}
+
+void SyntheticDevice::addVideoStream(SyntheticSensor& sensor, const stream_index_pair& sip, rs2_format format,
+                                     int width, int height, int fps, float hfov_deg, rs2_distortion model, float position_x)
+{
+    readStreamParams(sip, width, height, fps);
+
+    rs2_intrinsics intrinsics;
+    intrinsics.width = width;
+    intrinsics.height = height;
+    intrinsics.ppx = (width - 1) / 2.0f;
+    intrinsics.ppy = (height - 1) / 2.0f;
+    float half_fov(hfov_deg * M_PI / 360.0);
+    if (model == RS2_DISTORTION_KANNALA_BRANDT4)
+        intrinsics.fx = (width / 2.0f) / half_fov;      // Equidistant projection.
+    else
+        intrinsics.fx = (width / 2.0f) / std::tan(half_fov);
+    intrinsics.fy = intrinsics.fx;
+    intrinsics.model = model;
+    std::fill(std::begin(intrinsics.coeffs), std::end(intrinsics.coeffs), 0.0f);
+
+    rs2_video_stream video_stream;
+    video_stream.type = sip.first;
+    video_stream.index = sip.second;
+    video_stream.uid = _next_uid++;
+    video_stream.width = width;
+    video_stream.height = height;
+    video_stream.fps = fps;
+    video_stream.bpp = bytesPerPixel(format);
+    video_stream.fmt = format;
+    video_stream.intrinsics = intrinsics;
+
+    SyntheticStream stream;
+    stream.profile = sensor.sensor.add_video_stream(video_stream, true);
+    stream.sip = sip;
+    stream.format = format;
+    stream.bpp = video_stream.bpp;
+    stream.fps = fps;
+    stream.intrinsics = intrinsics;
+    stream.position_x = position_x;
+    stream.next_time_ms = -1;
+    sensor.streams.push_back(stream);
+}
+
+void SyntheticDevice::addMotionStream(SyntheticSensor& sensor, const stream_index_pair& sip, int fps)
+{
+    int width(0), height(0);
+    readStreamParams(sip, width, height, fps);
+
+    rs2_motion_device_intrinsic intrinsics;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 4; j++)
+            intrinsics.data[i][j] = (i == j) ? 1.0f : 0.0f;
+        intrinsics.noise_variances[i] = (sip.first == RS2_STREAM_GYRO) ? 4e-6f : 4e-4f;
+        intrinsics.bias_variances[i] = (sip.first == RS2_STREAM_GYRO) ? 1e-8f : 1e-6f;
+    }
+
+    rs2_motion_stream motion_stream;
+    motion_stream.type = sip.first;
+    motion_stream.index = sip.second;
+    motion_stream.uid = _next_uid++;
+    motion_stream.fps = fps;
+    motion_stream.fmt = RS2_FORMAT_MOTION_XYZ32F;
+    motion_stream.intrinsics = intrinsics;
+
+    SyntheticStream stream;
+    stream.profile = sensor.sensor.add_motion_stream(motion_stream, true);
+    stream.sip = sip;
+    stream.format = RS2_FORMAT_MOTION_XYZ32F;
+    stream.bpp = 0;
+    stream.fps = fps;
+    stream.position_x = 0;
+    stream.next_time_ms = -1;
+    sensor.streams.push_back(stream);
+}
+
+void SyntheticDevice::addPoseStream(SyntheticSensor& sensor, int fps)
+{
+    int width(0), height(0);
+    readStreamParams({RS2_STREAM_POSE, 0}, width, height, fps);
+
+    rs2_pose_stream pose_stream;
+    pose_stream.type = RS2_STREAM_POSE;
+    pose_stream.index = 0;
+    pose_stream.uid = _next_uid++;
+    pose_stream.fps = fps;
+    pose_stream.fmt = RS2_FORMAT_6DOF;
+
+    SyntheticStream stream;
+    stream.profile = sensor.sensor.add_pose_stream(pose_stream, true);
+    stream.sip = {RS2_STREAM_POSE, 0};
+    stream.format = RS2_FORMAT_6DOF;
+    stream.bpp = 0;
+    stream.fps = fps;
+    stream.position_x = 0;
+    stream.next_time_ms = -1;
+    sensor.streams.push_back(stream);
+}
+
+void SyntheticDevice::registerExtrinsics()
+{
+    // All imagers are parallel; they only differ by their horizontal offset from the base stream.
+    rs2_stream base_stream_type = (_layout == "t265") ? RS2_STREAM_POSE : RS2_STREAM_DEPTH;
+    SyntheticStream* base(nullptr);
+    for (auto& sensor : _sensors)
+        for (auto& stream : sensor->streams)
+            if (stream.sip.first == base_stream_type)
+                base = &stream;
+
+    for (auto& sensor : _sensors)
+    {
+        for (auto& stream : sensor->streams)
+        {
+            if (&stream == base)
+                continue;
+            rs2_extrinsics extrinsics = {{1, 0, 0, 0, 1, 0, 0, 0, 1}, {-stream.position_x, 0, 0}};
+            base->profile.register_extrinsics_to(stream.profile, extrinsics);
+        }
+    }
+}
+
+void SyntheticDevice::generatorLoop(SyntheticSensor& sensor)
+{
+    const double IDLE_PERIOD_MS(50);
+    double next_temperature_update_ms(0);
+    while (_is_alive)
+    {
+        double now_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start_time).count();
+        double next_wakeup_ms(now_ms + IDLE_PERIOD_MS);
+        try
+        {
+            std::vector<rs2::stream_profile> active_profiles(sensor.sensor.get_active_streams());
+            for (auto& stream : sensor.streams)
+            {
+                int uid(stream.profile.unique_id());
+                bool is_active = std::any_of(active_profiles.begin(), active_profiles.end(),
+                                             [uid](const rs2::stream_profile& profile){ return profile.unique_id() == uid; });
+                if (!is_active)
+                {
+                    stream.next_time_ms = -1;
+                    continue;
+                }
+
+                // Frames of all streams share one time grid, so equal rate streams get identical timestamps.
+                // A generator that falls behind skips frames, the same way a device drops them.
+                double period_ms(1000.0 / stream.fps);
+                if (stream.next_time_ms < 0 || now_ms - stream.next_time_ms > period_ms)
+                    stream.next_time_ms = std::ceil(now_ms / period_ms) * period_ms;
+                if (stream.next_time_ms <= now_ms)
+                {
+                    generateFrame(sensor, stream, stream.next_time_ms);
+                    stream.next_time_ms += period_ms;
+                }
+                next_wakeup_ms = std::min(next_wakeup_ms, stream.next_time_ms);
+            }
+
+            if (now_ms >= next_temperature_update_ms && sensor.sensor.supports(RS2_OPTION_ASIC_TEMPERATURE))
+            {
+                // Slowly warming up, as a real device does after it starts streaming.
+                float warmup(1.0f - std::exp(-now_ms / 300000.0f));
+                sensor.sensor.set_read_only_option(RS2_OPTION_ASIC_TEMPERATURE, 35.0f + 8.0f * warmup);
+                sensor.sensor.set_read_only_option(RS2_OPTION_PROJECTOR_TEMPERATURE, 33.0f + 6.0f * warmup);
+                next_temperature_update_ms = now_ms + 1000;
+            }
+        }
+        catch (const std::exception& ex)
+        {
+            ROS_WARN_STREAM_THROTTLE(1, "Synthetic device " << _serial_no << " failed to generate a frame: " << ex.what());
+        }
+        std::this_thread::sleep_until(_start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                        std::chrono::duration<double, std::milli>(next_wakeup_ms)));
+    }
+}
+
+void SyntheticDevice::generateFrame(SyntheticSensor& sensor, const SyntheticStream& stream, double time_ms)
+{
+    const int frame_number = static_cast<int>(std::llround(time_ms * stream.fps / 1000.0));
+    const double t = time_ms / 1000.0;
+    const SceneState scene(time_ms);
+
+    if (stream.format == RS2_FORMAT_MOTION_XYZ32F)
+    {
+        // The device sways slowly around its optical axis.
+        float angle = 0.05f * std::sin(0.5 * t);
+        float angular_velocity = 0.025f * std::cos(0.5 * t);
+        float* data = new float[3];
+        uint32_t h = hash3(frame_number, stream.sip.first, 0);
+        if (stream.sip.first == RS2_STREAM_ACCEL)
+        {
+            data[0] = GRAVITY * std::sin(angle) + 0.02f * gaussian(h);
+            data[1] = -GRAVITY * std::cos(angle) + 0.02f * gaussian(h + 1);
+            data[2] = 0.02f * gaussian(h + 2);
+        }
+        else
+        {
+            data[0] = 0.002f * gaussian(h);
+            data[1] = 0.002f * gaussian(h + 1);
+            data[2] = angular_velocity + 0.002f * gaussian(h + 2);
+        }
+
+        rs2_software_motion_frame frame;
+        frame.data = data;
+        frame.deleter = [](void* p){ delete[] static_cast<float*>(p); };
+        frame.timestamp = time_ms;
+        frame.domain = RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+        frame.frame_number = frame_number;
+        frame.profile = stream.profile.get();
+        sensor.sensor.on_motion_frame(frame);
+        return;
+    }
+
+    if (stream.format == RS2_FORMAT_6DOF)
+    {
+        // Walking a 1m radius circle at 0.2 rad/sec, heading along the path. T265 axes: Y up, -Z forward.
+        const float radius(1.0f), rate(0.2f);
+        float a = rate * t;
+        auto info = new rs2_software_pose_frame::pose_frame_info();
+        info->translation[0] = radius * std::sin(a);
+        info->translation[1] = 0;
+        info->translation[2] = radius * (1 - std::cos(a));
+        info->velocity[0] = radius * rate * std::cos(a);
+        info->velocity[1] = 0;
+        info->velocity[2] = radius * rate * std::sin(a);
+        info->acceleration[0] = -radius * rate * rate * std::sin(a);
+        info->acceleration[1] = 0;
+        info->acceleration[2] = radius * rate * rate * std::cos(a);
+        float yaw = -a;
+        info->rotation[0] = 0;
+        info->rotation[1] = std::sin(yaw / 2);
+        info->rotation[2] = 0;
+        info->rotation[3] = std::cos(yaw / 2);
+        info->angular_velocity[0] = 0;
+        info->angular_velocity[1] = -rate;
+        info->angular_velocity[2] = 0;
+        std::fill(std::begin(info->angular_acceleration), std::end(info->angular_acceleration), 0.0f);
+        info->tracker_confidence = 3;
+        info->mapper_confidence = 3;
+
+        rs2_software_pose_frame frame;
+        frame.data = info;
+        frame.deleter = [](void* p){ delete static_cast<rs2_software_pose_frame::pose_frame_info*>(p); };
+        frame.timestamp = time_ms;
+        frame.domain = RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+        frame.frame_number = frame_number;
+        frame.profile = stream.profile.get();
+        sensor.sensor.on_pose_frame(frame);
+        return;
+    }
+
+    const rs2_intrinsics& intrin(stream.intrinsics);
+    const int width(intrin.width), height(intrin.height);
+    const bool is_stereo(_layout == "d435i");
+    uint8_t* pixels = new uint8_t[width * height * stream.bpp];
+
+    // Exposure and gain changes made through dynamic reconfigure show up as brightness changes.
+    float brightness(1.0f);
+    if (sensor.sensor.supports(RS2_OPTION_EXPOSURE))
+    {
+        brightness *= sensor.sensor.get_option(RS2_OPTION_EXPOSURE) / sensor.sensor.get_option_range(RS2_OPTION_EXPOSURE).def;
+    }
+    if (sensor.sensor.supports(RS2_OPTION_GAIN))
+    {
+        float gain_default(sensor.sensor.get_option_range(RS2_OPTION_GAIN).def);
+        if (gain_default > 0)
+            brightness *= sensor.sensor.get_option(RS2_OPTION_GAIN) / gain_default;
+    }
+    brightness = std::max(0.05f, std::min(brightness, 4.0f));
+
+    float depth_units(DEPTH_UNITS);
+    if (sensor.sensor.supports(RS2_OPTION_DEPTH_UNITS))
+        depth_units = sensor.sensor.get_option(RS2_OPTION_DEPTH_UNITS);
+
+    // Stereo depth is missing a band on the left side, where only one imager sees the scene.
+    const int invalid_band(is_stereo ? width / 20 : 0);
+
+    for (int v = 0; v < height; v++)
+    {
+        for (int u = 0; u < width; u++)
+        {
+            const int idx = v * width + u;
+            const uint32_t h = hash3(u, v, frame_number);
+            float x, y, fisheye_angle(0);
+            pixelToRay(intrin, u, v, x, y);
+            if (stream.sip.first == RS2_STREAM_FISHEYE)
+            {
+                // Equidistant model: the distance from the principal point is proportional to the angle.
+                fisheye_angle = std::sqrt(x * x + y * y);
+                if (fisheye_angle > 1.45f)
+                {
+                    pixels[idx] = 0;
+                    continue;
+                }
+                float scale = (fisheye_angle > 1e-6f) ? std::tan(fisheye_angle) / fisheye_angle : 1.0f;
+                x *= scale;
+                y *= scale;
+            }
+            Surface surface;
+            float z = sceneDepth(scene, stream.position_x, x, y, surface);
+            bool is_hole = (u < invalid_band || unit(h) < HOLE_RATIO);
+
+            switch (stream.sip.first)
+            {
+                case RS2_STREAM_DEPTH:
+                {
+                    uint16_t* depth = reinterpret_cast<uint16_t*>(pixels);
+                    if (is_hole)
+                    {
+                        depth[idx] = 0;
+                        break;
+                    }
+                    // Stereo depth error grows quadratically with the distance, time of flight only linearly.
+                    float sigma = is_stereo ? 0.002f * z * z : 0.001f + 0.002f * z;
+                    float noisy_z = z + sigma * gaussian(h);
+                    depth[idx] = static_cast<uint16_t>(std::min(65535.0f, std::max(0.0f, noisy_z / depth_units + 0.5f)));
+                    break;
+                }
+                case RS2_STREAM_CONFIDENCE:
+                {
+                    int grade = is_hole ? 0 : std::max(1, 15 - static_cast<int>(z * 2));
+                    pixels[idx] = static_cast<uint8_t>(grade << 4);
+                    break;
+                }
+                case RS2_STREAM_INFRARED:
+                case RS2_STREAM_FISHEYE:
+                {
+                    float value = 150.0f * brightness * sceneTexture(scene, stream.position_x, x, y, z, surface) / (1.0f + 0.25f * z);
+                    if (is_stereo)
+                    {
+                        // Projected dot pattern, shifted by the disparity as seen from the second imager.
+                        int projector_u = u + static_cast<int>(std::lround(intrin.fx * stream.position_x / z));
+                        if ((hash3(projector_u, v, 0) & 0x1F) == 0)
+                            value += 80.0f * brightness;
+                    }
+                    if (stream.sip.first == RS2_STREAM_FISHEYE)
+                        value *= std::cos(fisheye_angle / 2);
+                    value += 4.0f * gaussian(h);
+                    pixels[idx] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value)));
+                    break;
+                }
+                case RS2_STREAM_COLOR:
+                {
+                    float texture = sceneTexture(scene, stream.position_x, x, y, z, surface);
+                    float shade = 255.0f * brightness * texture / (1.0f + 0.15f * z);
+                    float rgb[3];
+                    switch (surface)
+                    {
+                        case FLOOR:     rgb[0] = 0.55f; rgb[1] = 0.45f; rgb[2] = 0.35f; break;
+                        case LEFT_WALL: rgb[0] = 0.45f; rgb[1] = 0.55f; rgb[2] = 0.80f; break;
+                        case BOX:       rgb[0] = 0.90f; rgb[1] = 0.20f; rgb[2] = 0.15f; break;
+                        default:        rgb[0] = 0.85f; rgb[1] = 0.80f; rgb[2] = 0.70f; break;
+                    }
+                    float noise = 3.0f * gaussian(h);
+                    for (int c = 0; c < 3; c++)
+                        pixels[3 * idx + c] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, shade * rgb[c] + noise)));
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    rs2_software_video_frame frame;
+    frame.pixels = pixels;
+    frame.deleter = [](void* p){ delete[] static_cast<uint8_t*>(p); };
+    frame.stride = width * stream.bpp;
+    frame.bpp = stream.bpp;
+    frame.timestamp = time_ms;
+    frame.domain = RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+    frame.frame_number = frame_number;
+    frame.profile = stream.profile.get();
+    frame.depth_units = depth_units;
+    sensor.sensor.on_video_frame(frame);
+}
@@ -42,9 +42,11 @@ void T265RealsenseNode::initializeOdometryInput()
     _use_odom_in = true;
 }
 
-void T265RealsenseNode::toggleSensors(bool enabled)
+bool T265RealsenseNode::warmRestart(rs2::device dev)
 {
-  ROS_WARN_STREAM("toggleSensors method not implemented for T265");
+  // The wheel odometer and the tracking module state belong to the old device handle.
+  ROS_INFO_STREAM("warmRestart method not implemented for T265");
+  return false;
 }
 
 void T265RealsenseNode::publishTopics()
@@ -103,7 +105,7 @@ void T265RealsenseNode::calcAndPublishStaticTransform(const stream_index_pair& s
     rs2_extrinsics ex;
     try
     {
-        ex = getAProfile(stream).get_extrinsics_to(base_profile);
+        ex = getExtrinsics(getAProfile(stream), base_profile);
     }
     catch (std::exception& e)
     {
@@ -0,0 +1,177 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/tracer.h"
+#include "../include/allocation_tracker.h"
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace realsense2_camera;
+
+std::atomic<bool> Tracer::_is_enabled(false);
+
+namespace
+{
+    const size_t THREAD_BUFFER_SPANS = 16384;   // 1 MB per thread.
+    // The buffers of the threads that exited are kept for their spans, up to this number of buffers in all.
+    const size_t MAX_THREAD_BUFFERS = 64;
+
+    struct Span
+    {
+        char name[32];
+        const char* stream;
+        unsigned long long frame_number;
+        int64_t start_ns;
+        int64_t end_ns;
+    };
+
+    struct ThreadBuffer
+    {
+        ThreadBuffer() : thread_id(0), spans(new Span[THREAD_BUFFER_SPANS]), written(0), is_alive(true) {}
+
+        int thread_id;
+        char thread_name[16];
+        std::unique_ptr<Span[]> spans;
+        std::atomic<uint64_t> written;      // Spans ever written. Only the last THREAD_BUFFER_SPANS are held.
+        std::atomic<bool> is_alive;
+    };
+
+    std::mutex buffers_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+    // Hands the buffer over for reuse when its thread exits.
+    struct ThreadBufferOwner
+    {
+        ThreadBuffer* buffer = nullptr;
+
+        ~ThreadBufferOwner()
+        {
+            if (buffer)
+                buffer->is_alive = false;
+        }
+    };
+    thread_local ThreadBufferOwner thread_buffer_owner;
+
+    ThreadBuffer& threadBuffer()
+    {
+        if (!thread_buffer_owner.buffer)
+        {
+            // Once per thread, not per span.
+            AllocationTracker::Untracked untracked;
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            std::shared_ptr<ThreadBuffer> buffer;
+            if (buffers.size() >= MAX_THREAD_BUFFERS)
+            {
+                // The longest held of the buffers whose threads exited.
+                auto released = std::find_if(buffers.begin(), buffers.end(), [](const std::shared_ptr<ThreadBuffer>& b){ return !b->is_alive; });
+                if (released != buffers.end())
+                {
+                    buffer = *released;
+                    buffers.erase(released);
+                    buffer->written = 0;
+                    buffer->is_alive = true;
+                }
+            }
+            if (!buffer)
+                buffer = std::make_shared<ThreadBuffer>();
+            buffer->thread_id = static_cast<int>(syscall(SYS_gettid));
+            if (0 != pthread_getname_np(pthread_self(), buffer->thread_name, sizeof(buffer->thread_name)))
+                buffer->thread_name[0] = '\0';
+            buffers.push_back(buffer);
+            thread_buffer_owner.buffer = buffer.get();
+        }
+        return *thread_buffer_owner.buffer;
+    }
+
+    void writeJsonString(std::ostream& out, const char* s)
+    {
+        out << '"';
+        for (; *s; s++)
+        {
+            if ('"' == *s || '\\' == *s)
+                out << '\\';
+            out << *s;
+        }
+        out << '"';
+    }
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    _is_enabled = enabled;
+}
+
+void Tracer::record(const char* name, const char* stream, unsigned long long frame_number, int64_t start_ns, int64_t end_ns)
+{
+    ThreadBuffer& buffer(threadBuffer());
+    uint64_t index(buffer.written.load(std::memory_order_relaxed));
+    Span& span(buffer.spans[index % THREAD_BUFFER_SPANS]);
+    std::strncpy(span.name, name, sizeof(span.name) - 1);
+    span.name[sizeof(span.name) - 1] = '\0';
+    span.stream = stream;
+    span.frame_number = frame_number;
+    span.start_ns = start_ns;
+    span.end_ns = end_ns;
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+size_t Tracer::dump(const std::string& path)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+        throw std::runtime_error("Failed to create " + path);
+
+    size_t spans_num(0);
+    std::vector<Span> spans(THREAD_BUFFER_SPANS);
+    pid_t pid(getpid());
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool is_first(true);
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (const std::shared_ptr<ThreadBuffer>& buffer : buffers)
+    {
+        // The thread goes on writing meanwhile. The spans it overwrote while they were copied are left out.
+        uint64_t end(buffer->written.load(std::memory_order_acquire));
+        uint64_t begin(end > THREAD_BUFFER_SPANS ? end - THREAD_BUFFER_SPANS : 0);
+        for (uint64_t index = begin; index < end; index++)
+        {
+            spans[index - begin] = buffer->spans[index % THREAD_BUFFER_SPANS];
+        }
+        uint64_t end_after(buffer->written.load(std::memory_order_acquire));
+        uint64_t valid_begin(end_after + 1 > THREAD_BUFFER_SPANS ? end_after + 1 - THREAD_BUFFER_SPANS : 0);
+
+        out << (is_first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->thread_id << ",\"args\":{\"name\":";
+        writeJsonString(out, buffer->thread_name[0] ? buffer->thread_name : "thread");
+        out << "}}";
+        is_first = false;
+        for (uint64_t index = std::max(begin, valid_begin); index < end; index++)
+        {
+            const Span& span(spans[index - begin]);
+            out << ",{\"name\":";
+            writeJsonString(out, span.name);
+            out << ",\"cat\":\"realsense2_camera\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << buffer->thread_id
+                << ",\"ts\":" << span.start_ns / 1000.0 << ",\"dur\":" << (span.end_ns - span.start_ns) / 1000.0 << ",\"args\":{";
+            if (span.stream)
+            {
+                out << "\"stream\":";
+                writeJsonString(out, span.stream);
+                out << ",\"frame\":" << span.frame_number;
+            }
+            out << "}}";
+            spans_num++;
+        }
+    }
+    out << "]}\n";
+    if (!out.good())
+        throw std::runtime_error("Failed to write " + path);
+    return spans_num;
+}
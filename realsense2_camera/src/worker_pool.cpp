@@ -0,0 +1,189 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/worker_pool.h"
+#include <ros/ros.h>
+#include <algorithm>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // Lets a worker post follow-up tasks to its own queue, where they are picked up without contention.
+    thread_local const WorkerPool* current_pool(nullptr);
+    thread_local size_t current_worker(0);
+}
+
+WorkerPool::WorkerPool(size_t threads_num, size_t strand_queue_size) :
+    _strand_queue_size(std::max<size_t>(strand_queue_size, 1)),
+    _pending_tasks(0), _next_worker(0), _is_alive(true)
+{
+    threads_num = std::max<size_t>(threads_num, 1);
+    for (size_t i = 0; i < threads_num; i++)
+    {
+        _workers.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < threads_num; i++)
+    {
+        _threads.emplace_back([this, i](){ run(i); });
+    }
+    ROS_INFO_STREAM("Worker pool started with " << threads_num << " threads.");
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _is_alive = false;
+    }
+    _cv.notify_all();
+    for (auto& t : _threads)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+void WorkerPool::post(std::function<void()> task)
+{
+    size_t index = (current_pool == this) ? current_worker : (_next_worker++ % _workers.size());
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending_tasks++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_workers[index]->mutex);
+        _workers[index]->tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+}
+
+bool WorkerPool::popTask(size_t index, std::function<void()>& task)
+{
+    {
+        Worker& own(*_workers[index]);
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < _workers.size(); i++)
+    {
+        Worker& victim(*_workers[(index + i) % _workers.size()]);
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::run(size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+    while (true)
+    {
+        std::function<void()> task;
+        if (popTask(index, task))
+        {
+            _pending_tasks--;
+            try
+            {
+                task();
+            }
+            catch(const std::exception& ex)
+            {
+                ROS_ERROR_STREAM("An exception has been thrown in a worker thread: " << ex.what());
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]{ return _pending_tasks > 0 || !_is_alive; });
+        if (!_is_alive)
+            break;
+    }
+}
+
+Strand::Strand(WorkerPool& pool) :
+    _pool(pool), _max_pending(pool.strandQueueSize()),
+    _is_scheduled(false), _is_running(false), _is_shutdown(false), _dropped(0)
+{
+}
+
+bool Strand::post(std::function<void()> task)
+{
+    bool is_dropped(false);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_is_shutdown)
+            return false;
+        if (_pending.size() >= _max_pending)
+        {
+            _pending.pop_front();
+            _dropped++;
+            is_dropped = true;
+        }
+        _pending.push_back(std::move(task));
+        if (_is_scheduled)
+            return !is_dropped;
+        _is_scheduled = true;
+    }
+    auto self(shared_from_this());
+    _pool.post([self](){ self->runNext(); });
+    return !is_dropped;
+}
+
+void Strand::runNext()
+{
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_is_shutdown || _pending.empty())
+        {
+            _is_scheduled = false;
+            _cv_idle.notify_all();
+            return;
+        }
+        task = std::move(_pending.front());
+        _pending.pop_front();
+        _is_running = true;
+    }
+
+    try
+    {
+        task();
+    }
+    catch(const std::exception& ex)
+    {
+        ROS_ERROR_STREAM("An exception has been thrown while processing a frame: " << ex.what());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _is_running = false;
+        if (_is_shutdown || _pending.empty())
+        {
+            _is_scheduled = false;
+            _cv_idle.notify_all();
+            return;
+        }
+    }
+    // Re-post instead of looping, so the strands of other cameras get their share of the pool.
+    auto self(shared_from_this());
+    _pool.post([self](){ self->runNext(); });
+}
+
+void Strand::shutdown()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _is_shutdown = true;
+    _pending.clear();
+    _cv_idle.wait(lock, [this]{ return !_is_running; });
+}
@@ -0,0 +1,74 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/Imu.h>
+#include <map>
+#include <string>
+
+namespace
+{
+    // Well past the 100 warm-up calls of each callback.
+    const uint64_t MIN_CALLS = 300;
+    const double TIMEOUT_SEC = 90.0;
+    const std::string STATUS_NAME_SUFFIX = "Allocations";
+
+    // The values of the last Allocations status, e.g. "Frame steady state allocations" -> "0".
+    std::map<std::string, std::string> allocations;
+
+    void diagnosticsCallback(const diagnostic_msgs::DiagnosticArray::ConstPtr& msg)
+    {
+        for (const diagnostic_msgs::DiagnosticStatus& status : msg->status)
+        {
+            if (status.name.size() < STATUS_NAME_SUFFIX.size() ||
+                0 != status.name.compare(status.name.size() - STATUS_NAME_SUFFIX.size(), STATUS_NAME_SUFFIX.size(), STATUS_NAME_SUFFIX))
+                continue;
+            for (const diagnostic_msgs::KeyValue& value : status.values)
+                allocations[value.key] = value.value;
+        }
+    }
+
+    // Subscribed to, so that the frames go all the way through their publishers.
+    void imageCallback(const sensor_msgs::Image::ConstPtr&) {}
+    void imuCallback(const sensor_msgs::Imu::ConstPtr&) {}
+
+    uint64_t calls(const std::string& callback)
+    {
+        auto value = allocations.find(callback + " calls");
+        return value == allocations.end() ? 0 : std::stoull(value->second);
+    }
+}
+
+TEST(Allocations, NoSteadyStateAllocations)
+{
+    ros::NodeHandle nh;
+    ros::Subscriber diagnostics_sub = nh.subscribe("/diagnostics", 10, diagnosticsCallback);
+    ros::Subscriber depth_sub = nh.subscribe("camera/depth/image_rect_raw", 1, imageCallback);
+    ros::Subscriber color_sub = nh.subscribe("camera/color/image_raw", 1, imageCallback);
+    ros::Subscriber infra_sub = nh.subscribe("camera/infra1/image_rect_raw", 1, imageCallback);
+    ros::Subscriber gyro_sub = nh.subscribe("camera/gyro/sample", 1, imuCallback);
+    ros::Subscriber accel_sub = nh.subscribe("camera/accel/sample", 1, imuCallback);
+
+    ros::WallTime deadline(ros::WallTime::now() + ros::WallDuration(TIMEOUT_SEC));
+    while (ros::ok() && ros::WallTime::now() < deadline && (calls("Frame") < MIN_CALLS || calls("IMU") < MIN_CALLS))
+    {
+        ros::spinOnce();
+        ros::WallDuration(0.1).sleep();
+    }
+    ASSERT_FALSE(allocations.empty()) << "No Allocations status on /diagnostics. Is the node built with TRACK_ALLOCATIONS?";
+    ASSERT_GE(calls("Frame"), MIN_CALLS);
+    ASSERT_GE(calls("IMU"), MIN_CALLS);
+    EXPECT_EQ("0", allocations["Frame steady state allocations"]);
+    EXPECT_EQ("0", allocations["IMU steady state allocations"]);
+    EXPECT_EQ("0", allocations["Pose steady state allocations"]);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "allocations_test");
+    return RUN_ALL_TESTS();
+}
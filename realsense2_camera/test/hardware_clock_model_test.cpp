@@ -0,0 +1,89 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/hardware_clock_model.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    // A device whose clock starts at HW_START_MS and runs SKEW slower than the host clock, sampled at rate_hz with
+    // exponentially distributed USB and scheduling latency.
+    const double HW_START_MS = 123456.0;
+    const double HOST_START_SEC = 1600000000.0;
+    const double SKEW = 50e-6;
+    const double MEAN_LATENCY_SEC = 0.002;
+
+    struct Stream
+    {
+        double period_sec;
+        double next_sec;        // True host time of the next sample.
+        double next_arrival_sec;
+        double last_stamp_sec;
+    };
+
+    double hwTimeMs(double host_sec)
+    {
+        return HW_START_MS + (host_sec - HOST_START_SEC) * (1 - SKEW) * 1000.0;
+    }
+}
+
+TEST(HardwareClockModel, MonotonicSingleStream)
+{
+    HardwareClockModel model;
+    std::mt19937 random(1);
+    std::exponential_distribution<double> latency(1 / MEAN_LATENCY_SEC);
+    double last_stamp_sec(0);
+    double max_error_sec(0);
+    for (int i = 0; i < 120 * 400; i++)
+    {
+        double host_sec(HOST_START_SEC + i / 400.0);
+        double stamp_sec(model.toHostTime(hwTimeMs(host_sec), host_sec + latency(random)));
+        ASSERT_GT(stamp_sec, last_stamp_sec) << "at sample " << i;
+        last_stamp_sec = stamp_sec;
+        // Settled after the first seconds.
+        if (i > 10 * 400)
+            max_error_sec = std::max(max_error_sec, std::abs(stamp_sec - host_sec));
+    }
+    EXPECT_LT(max_error_sec, 0.001);
+}
+
+TEST(HardwareClockModel, MonotonicInterleavedStreams)
+{
+    // IMU and frames share the model. Each stream arrives in order, but the streams come in out of hardware time
+    // order with respect to each other.
+    HardwareClockModel model;
+    std::mt19937 random(2);
+    std::exponential_distribution<double> latency(1 / MEAN_LATENCY_SEC);
+    Stream streams[] = {{1 / 400.0, HOST_START_SEC, HOST_START_SEC, 0}, {1 / 200.0, HOST_START_SEC, HOST_START_SEC, 0},
+                        {1 / 30.0, HOST_START_SEC, HOST_START_SEC, 0}};
+    for (Stream& stream : streams)
+        stream.next_arrival_sec = stream.next_sec + latency(random);
+    for (int i = 0; i < 120 * 630; i++)
+    {
+        Stream* stream(&streams[0]);
+        for (Stream& other : streams)
+            if (other.next_arrival_sec < stream->next_arrival_sec)
+                stream = &other;
+        double stamp_sec(model.toHostTime(hwTimeMs(stream->next_sec), stream->next_arrival_sec));
+        ASSERT_GT(stamp_sec, stream->last_stamp_sec) << "at sample " << i;
+        stream->last_stamp_sec = stamp_sec;
+        stream->next_sec += stream->period_sec;
+        stream->next_arrival_sec = std::max(stream->next_sec + latency(random), stream->next_arrival_sec);
+    }
+    EXPECT_TRUE(model.getStatus().is_valid);
+    EXPECT_NEAR(model.getStatus().skew_ppm, SKEW * 1e6, 5);
+}
+
+TEST(HardwareClockModel, RestartsOnClockReset)
+{
+    HardwareClockModel model;
+    model.toHostTime(1000.0, HOST_START_SEC);
+    model.toHostTime(1010.0, HOST_START_SEC + 0.010);
+    double stamp_sec(model.toHostTime(5.0, HOST_START_SEC + 0.020));
+    EXPECT_EQ(1u, model.getStatus().num_resets);
+    EXPECT_DOUBLE_EQ(HOST_START_SEC + 0.020, stamp_sec);
+}
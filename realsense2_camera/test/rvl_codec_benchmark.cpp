@@ -0,0 +1,180 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+// Measures the compression ratio and the single core speed of the RVL codec, on a synthetic scene, on a synthetic
+// stereo depth frame and on the depth frames of the raw recordings given on the command line:
+//   rosrun realsense2_camera realsense2_camera_rvl_codec_benchmark [segment_NNNNN.raw ...]
+// The speeds are in MB of depth image per second.
+
+#include "../include/raw_recorder.h"
+#include "../include/rvl_codec.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    const double MIN_DURATION_SEC = 1.0;
+
+    typedef std::vector<uint16_t> Image;
+
+    // Depth of a slanted plane with holes, as in rvl_codec_test.
+    Image sceneImage()
+    {
+        const size_t width(640), height(480);
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> noise(-3, 3);
+        Image pixels(width * height);
+        for (size_t y = 0; y < height; y++)
+        {
+            for (size_t x = 0; x < width; x++)
+            {
+                bool is_hole((x / 40 + y / 30) % 7 == 0);
+                pixels[y * width + x] = is_hole ? 0 : static_cast<uint16_t>(1000 + x + 2 * y + noise(random));
+            }
+        }
+        return pixels;
+    }
+
+    // Depth of a D400 looking at a room 0.5 to 4 m deep, in mm: the band on the left side that only one imager sees,
+    // scattered invalid pixels, and noise growing quadratically with the distance.
+    Image stereoImage()
+    {
+        const int width(848), height(480);
+        std::mt19937 random(2);
+        std::normal_distribution<float> noise;
+        std::bernoulli_distribution is_hole(0.01);
+        Image pixels(width * height);
+        for (int v = 0; v < height; v++)
+        {
+            for (int u = 0; u < width; u++)
+            {
+                // A floor in the lower half, a back wall and a box in front of it.
+                float z(4.0f);
+                if (v > height / 2)
+                    z = std::min(z, 0.5f + 3.5f * (height / 2) / static_cast<float>(v));
+                if (u > width / 3 && u < width / 2 && v > height / 3 && v < 2 * height / 3)
+                    z = 1.5f;
+                float sigma(0.002f * z * z);
+                bool is_invalid(u < width / 20 || is_hole(random));
+                pixels[v * width + u] = is_invalid ? 0 : static_cast<uint16_t>((z + sigma * noise(random)) * 1000 + 0.5f);
+            }
+        }
+        return pixels;
+    }
+
+    // The Z16 frames of a segment of the record service.
+    std::vector<Image> recordedImages(const std::string& segment_path)
+    {
+        std::string index_path(segment_path.substr(0, segment_path.rfind('.')) + ".idx");
+        std::ifstream segment(segment_path, std::ios::binary);
+        std::ifstream index(index_path, std::ios::binary);
+        if (!segment || !index)
+            throw std::runtime_error("Failed to open " + segment_path + " or " + index_path);
+
+        std::vector<Image> images;
+        RawIndexEntry entry;
+        while (index.read(reinterpret_cast<char*>(&entry), sizeof(entry)))
+        {
+            RawRecordHeader header;
+            segment.seekg(entry.offset);
+            if (!segment.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != RAW_RECORD_MAGIC)
+                throw std::runtime_error("Bad record in " + segment_path);
+            if (header.format != RS2_FORMAT_Z16 || header.width == 0)
+                continue;
+            std::vector<uint8_t> data(header.data_size);
+            segment.seekg(entry.offset + sizeof(header) + header.metadata_count * sizeof(RawRecordMetadata));
+            if (!segment.read(reinterpret_cast<char*>(data.data()), data.size()) ||
+                data.size() < static_cast<size_t>(header.stride) * header.height)
+                throw std::runtime_error("Truncated record in " + segment_path);
+            Image pixels(header.width * header.height);
+            for (size_t y = 0; y < header.height; y++)
+                memcpy(&pixels[y * header.width], &data[y * header.stride], header.width * sizeof(uint16_t));
+            images.push_back(std::move(pixels));
+        }
+        return images;
+    }
+
+    double secondsSince(const std::chrono::steady_clock::time_point& start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void benchmark(const std::string& name, const std::vector<Image>& images)
+    {
+        if (images.empty())
+        {
+            printf("%-24s no depth frames\n", name.c_str());
+            return;
+        }
+
+        size_t raw_size(0), encoded_size(0);
+        std::vector<std::vector<uint8_t>> encoded(images.size());
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            encoded[i].resize(rvl::maxEncodedSize(images[i].size()));
+            encoded[i].resize(rvl::encode(images[i].data(), images[i].size(), encoded[i].data()));
+            raw_size += images[i].size() * sizeof(uint16_t);
+            encoded_size += encoded[i].size();
+        }
+
+        std::vector<uint8_t> output;
+        size_t passes(0);
+        auto start(std::chrono::steady_clock::now());
+        do
+        {
+            for (const Image& image : images)
+            {
+                output.resize(rvl::maxEncodedSize(image.size()));
+                rvl::encode(image.data(), image.size(), output.data());
+            }
+            passes++;
+        } while (secondsSince(start) < MIN_DURATION_SEC);
+        double encode_mb_per_sec(raw_size * passes / secondsSince(start) / 1e6);
+
+        Image decoded;
+        passes = 0;
+        start = std::chrono::steady_clock::now();
+        do
+        {
+            for (size_t i = 0; i < images.size(); i++)
+            {
+                decoded.resize(images[i].size());
+                rvl::decode(encoded[i].data(), encoded[i].size(), decoded.data(), decoded.size());
+                if (passes == 0 && decoded != images[i])
+                    throw std::runtime_error(name + ": frame " + std::to_string(i) + " doesn't round trip");
+            }
+            passes++;
+        } while (secondsSince(start) < MIN_DURATION_SEC);
+        double decode_mb_per_sec(raw_size * passes / secondsSince(start) / 1e6);
+
+        printf("%-24s %6zu frames  ratio %5.2f  encode %7.0f MB/s  decode %7.0f MB/s\n", name.c_str(), images.size(),
+               static_cast<double>(raw_size) / encoded_size, encode_mb_per_sec, decode_mb_per_sec);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        benchmark("scene 640x480", {sceneImage()});
+        benchmark("stereo 848x480", {stereoImage()});
+        for (int i = 1; i < argc; i++)
+            benchmark(argv[i], recordedImages(argv[i]));
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2021 Intel Corporation. All Rights Reserved
+
+#include "../include/rvl_codec.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace realsense2_camera;
+
+namespace
+{
+    const size_t WIDTH = 640;
+    const size_t HEIGHT = 480;
+
+    std::vector<uint8_t> encode(const std::vector<uint16_t>& pixels)
+    {
+        std::vector<uint8_t> encoded(rvl::maxEncodedSize(pixels.size()));
+        size_t encoded_size(rvl::encode(pixels.data(), pixels.size(), encoded.data()));
+        EXPECT_LE(encoded_size, encoded.size());
+        encoded.resize(encoded_size);
+        return encoded;
+    }
+
+    void expectRoundTrip(const std::vector<uint16_t>& pixels)
+    {
+        std::vector<uint8_t> encoded(encode(pixels));
+        // Filled with what the decoder must overwrite.
+        std::vector<uint16_t> decoded(pixels.size(), 0xABCD);
+        rvl::decode(encoded.data(), encoded.size(), decoded.data(), decoded.size());
+        EXPECT_EQ(pixels, decoded);
+    }
+
+    // Depth of a scene: a slanted plane with holes, like the invalid pixels of a real depth image.
+    std::vector<uint16_t> sceneImage()
+    {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> noise(-3, 3);
+        std::vector<uint16_t> pixels(WIDTH * HEIGHT);
+        for (size_t y = 0; y < HEIGHT; y++)
+        {
+            for (size_t x = 0; x < WIDTH; x++)
+            {
+                bool is_hole((x / 40 + y / 30) % 7 == 0);
+                pixels[y * WIDTH + x] = is_hole ? 0 : static_cast<uint16_t>(1000 + x + 2 * y + noise(random));
+            }
+        }
+        return pixels;
+    }
+}
+
+TEST(RvlCodec, AllZero)
+{
+    expectRoundTrip(std::vector<uint16_t>(WIDTH * HEIGHT, 0));
+}
+
+TEST(RvlCodec, NoZero)
+{
+    expectRoundTrip(std::vector<uint16_t>(WIDTH * HEIGHT, 1234));
+}
+
+TEST(RvlCodec, Scene)
+{
+    std::vector<uint16_t> pixels(sceneImage());
+    expectRoundTrip(pixels);
+    // Smooth depth is what the codec is for.
+    EXPECT_LT(encode(pixels).size(), pixels.size() * sizeof(uint16_t) / 2);
+}
+
+TEST(RvlCodec, Noise)
+{
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int> value(0, 0xFFFF);
+    std::vector<uint16_t> pixels(WIDTH * HEIGHT);
+    for (uint16_t& pixel : pixels)
+        pixel = static_cast<uint16_t>(value(random));
+    expectRoundTrip(pixels);
+}
+
+TEST(RvlCodec, NoisyHoles)
+{
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> value(0, 0xFFFF);
+    std::bernoulli_distribution is_hole(0.5);
+    std::vector<uint16_t> pixels(WIDTH * HEIGHT);
+    for (uint16_t& pixel : pixels)
+        pixel = is_hole(random) ? 0 : static_cast<uint16_t>(value(random));
+    expectRoundTrip(pixels);
+}
+
+TEST(RvlCodec, LargestDeltas)
+{
+    // Every pixel takes the longest code, and the runs alternate at every pixel.
+    std::vector<uint16_t> pixels(WIDTH * HEIGHT);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (i % 4 == 1) ? 0xFFFF : (i % 4 == 3) ? 1 : 0;
+    expectRoundTrip(pixels);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (i % 2) ? 0xFFFF : 1;
+    expectRoundTrip(pixels);
+}
+
+TEST(RvlCodec, OddSizes)
+{
+    for (size_t num_pixels : {0, 1, 2, 3, 7, 8, 9, 17})
+    {
+        std::vector<uint16_t> pixels(num_pixels);
+        for (size_t i = 0; i < num_pixels; i++)
+            pixels[i] = (i % 3) ? static_cast<uint16_t>(i * 4099) : 0;
+        expectRoundTrip(pixels);
+    }
+}
+
+TEST(RvlCodec, Truncated)
+{
+    std::vector<uint16_t> pixels(sceneImage());
+    std::vector<uint8_t> encoded(encode(pixels));
+    std::vector<uint16_t> decoded(pixels.size());
+    EXPECT_THROW(rvl::decode(encoded.data(), encoded.size() / 2, decoded.data(), decoded.size()), std::runtime_error);
+}
+
+TEST(RvlCodec, TooManyPixels)
+{
+    std::vector<uint16_t> pixels(sceneImage());
+    std::vector<uint8_t> encoded(encode(pixels));
+    std::vector<uint16_t> decoded(pixels.size() / 2);
+    EXPECT_THROW(rvl::decode(encoded.data(), encoded.size(), decoded.data(), decoded.size()), std::runtime_error);
+}